@@ -0,0 +1,66 @@
+/*
+ * Batch encoding scaling: documents/s and MiB/s of encode_batch() as the
+ * thread count doubles, up to the number of cores (or the given maximum).
+ *
+ *   bench_batch [corpus] [model] [max_threads] [chunk_size]
+ *
+ * Every line of the corpus is one document. The word cache is left off so
+ * each thread does the full merge work.
+ */
+#include "../include/bpe.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    std::string corpus = argc > 1 ? argv[1] : "wikitext2.txt";
+    std::string model = argc > 2 ? argv[2] : "bpe_model.txt";
+    size_t max_threads = argc > 3 ? std::stoul(argv[3]) : std::thread::hardware_concurrency();
+    size_t chunk_size = argc > 4 ? std::stoul(argv[4]) : 16;
+
+    const Tokenizer tokenizer = Tokenizer::load(model);
+
+    std::ifstream in(corpus);
+    if (!in.is_open()) {
+        std::cerr << "Failed to open corpus: " << corpus << "\n";
+        return 1;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    size_t bytes = 0;
+    while (std::getline(in, line)) {
+        bytes += line.size() + 1;
+        lines.push_back(std::move(line));
+    }
+    std::vector<std::string_view> docs(lines.begin(), lines.end());
+    double mb = bytes / (1024.0 * 1024.0);
+
+    std::cout << "=== Batch encode scaling ===\n";
+    std::cout << "corpus: " << corpus << " (" << std::fixed << std::setprecision(1) << mb
+              << " MiB, " << docs.size() << " docs), chunk size " << chunk_size << "\n";
+    std::cout << "threads      seconds      MiB/s     docs/s   speedup\n";
+
+    double base = 0;
+    for (size_t threads = 1; threads <= std::max<size_t>(1, max_threads); threads *= 2) {
+        ThreadPool pool(threads);
+        tokenizer.encode_batch(std::span(docs).first(std::min<size_t>(docs.size(), 1000)), pool, chunk_size);
+
+        auto start = std::chrono::steady_clock::now();
+        auto results = tokenizer.encode_batch(docs, pool, chunk_size);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double s = elapsed.count();
+        if (threads == 1) base = s;
+        std::cout << std::setw(7) << threads << std::setw(13) << std::setprecision(3) << s
+                  << std::setw(11) << std::setprecision(1) << mb / s
+                  << std::setw(11) << std::setprecision(0) << docs.size() / s
+                  << std::setw(9) << std::setprecision(2) << base / s << "x\n";
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Encode throughput: rank-driven tokenize(), encode() to ids, and the word
+ * cache, vs the original per-merge scan. Also times decode() of the ids.
+ *
+ *   bench_encode [corpus] [model] [max_bytes]
+ *
+ * Defaults to wikitext2.txt / bpe_model.txt and the first 1 MiB of the corpus
+ * (the reference encoder is too slow for the whole file). Trains a 5000 token
+ * model on the corpus first if the model file does not exist.
+ */
+#include "../include/bpe.hpp"
+#include "reference_bpe.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::vector<std::string> read_lines(const std::string& path, size_t max_bytes) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open corpus: " + path);
+        }
+        std::vector<std::string> lines;
+        std::string line;
+        size_t total = 0;
+        while (total < max_bytes && std::getline(in, line)) {
+            total += line.size() + 1;
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    template <typename Encode>
+    double time_encode(const std::vector<std::string>& lines, Encode&& encode, size_t& n_tokens) {
+        n_tokens = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& line : lines) {
+            n_tokens += encode(line).size();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string corpus = argc > 1 ? argv[1] : "wikitext2.txt";
+    std::string model = argc > 2 ? argv[2] : "bpe_model.txt";
+    size_t max_bytes = argc > 3 ? std::stoull(argv[3]) : (1u << 20);
+
+    if (!std::filesystem::exists(model)) {
+        train(corpus, 5000);
+        model = "bpe_model.txt";
+    }
+    load_model(model);
+    ReferenceBpe reference(model);
+
+    std::vector<std::string> lines = read_lines(corpus, max_bytes);
+    size_t bytes = 0;
+    for (const auto& line : lines) bytes += line.size() + 1;
+
+    size_t mismatches = 0;
+    for (const auto& line : lines) {
+        if (tokenize(line) != reference.tokenize(line)) mismatches++;
+    }
+
+    size_t ref_tokens = 0, new_tokens = 0, id_tokens = 0, cached_tokens = 0;
+    double ref_s = time_encode(lines, [&](const std::string& l) { return reference.tokenize(l); }, ref_tokens);
+    set_encode_cache_budget(0);
+    double new_s = time_encode(lines, [](const std::string& l) { return tokenize(l); }, new_tokens);
+    double ids_s = time_encode(lines, [](const std::string& l) { return encode(l); }, id_tokens);
+    set_encode_cache_budget(WordCache::kDefaultBudget);
+    double cached_s = time_encode(lines, [](const std::string& l) { return tokenize(l); }, cached_tokens);
+    WordCacheStats cache = encode_cache_stats();
+
+    std::vector<std::vector<uint32_t>> encoded;
+    for (const auto& line : lines) encoded.push_back(encode(line));
+    auto tokenizer = default_tokenizer();
+    auto decode_start = std::chrono::steady_clock::now();
+    size_t decoded_bytes = 0;
+    for (const auto& ids : encoded) decoded_bytes += tokenizer->decode(ids).size();
+    std::chrono::duration<double> decode_s = std::chrono::steady_clock::now() - decode_start;
+
+    double mb = bytes / (1024.0 * 1024.0);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "=== Encode benchmark ===\n";
+    std::cout << "corpus:      " << corpus << " (" << mb << " MiB, " << lines.size() << " lines)\n";
+    std::cout << "mismatching lines: " << mismatches << "\n";
+    std::cout << "reference:   " << ref_s << "s  " << mb / ref_s << " MiB/s  "
+              << ref_tokens / ref_s << " tokens/s\n";
+    std::cout << "rank-driven: " << new_s << "s  " << mb / new_s << " MiB/s  "
+              << new_tokens / new_s << " tokens/s\n";
+    std::cout << "ids only:    " << ids_s << "s  " << mb / ids_s << " MiB/s  "
+              << id_tokens / ids_s << " tokens/s\n";
+    std::cout << "+ cache:     " << cached_s << "s  " << mb / cached_s << " MiB/s  "
+              << cached_tokens / cached_s << " tokens/s  (hit rate "
+              << 100.0 * cache.hits / (cache.hits + cache.misses) << "%)\n";
+    std::cout << "decode:      " << decode_s.count() << "s  "
+              << decoded_bytes / (1024.0 * 1024.0) / decode_s.count() << " MiB/s  "
+              << id_tokens / decode_s.count() << " tokens/s\n";
+    std::cout << "speedup:     " << ref_s / new_s << "x (" << ref_s / cached_s << "x cached)\n";
+    return mismatches == 0 ? 0 : 1;
+}
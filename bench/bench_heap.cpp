@@ -0,0 +1,108 @@
+/*
+ * IndexedHeap microbenchmark: push, updatePriority and pop on the original
+ * map-indexed binary heap vs the intrusive binary and 4-ary heaps.
+ *
+ *   bench_heap [num_nodes] [num_updates]
+ *
+ * Priorities are small skewed counts and updates are mostly +-1 steps on
+ * frequent pairs, roughly what training does. All heaps must pop the same
+ * sequence.
+ */
+#include "../include/indexed_heap.hpp"
+#include "reference_heap.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct Workload {
+        std::vector<int> priorities;
+        std::vector<std::pair<uint32_t, int>> updates;  // node, delta
+    };
+
+    Workload make_workload(size_t num_nodes, size_t num_updates) {
+        Workload w;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        for (size_t i = 0; i < num_nodes; ++i) {
+            w.priorities.push_back(1 + static_cast<int>(100000.0 / (1 + i) * unit(rng)));
+        }
+        for (size_t i = 0; i < num_updates; ++i) {
+            // Low node ids (frequent pairs) are touched far more often
+            uint32_t node = static_cast<uint32_t>(num_nodes * unit(rng) * unit(rng) * unit(rng));
+            int delta = (rng() % 3 == 0) ? 1 : -1;
+            w.updates.emplace_back(node, delta);
+        }
+        return w;
+    }
+
+    struct Timings {
+        double push_s;
+        double update_s;
+        double pop_s;
+        uint64_t checksum;
+    };
+
+    template <typename Heap>
+    Timings run(const Workload& w) {
+        std::vector<HeapNode> nodes(w.priorities.size());
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            nodes[i].tok_ids = {static_cast<int>(i), 0};
+            nodes[i].priority = w.priorities[i];
+        }
+        Heap heap;
+        Timings t{};
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& node : nodes) heap.push(&node);
+        auto pushed = std::chrono::steady_clock::now();
+        for (const auto& [idx, delta] : w.updates) {
+            HeapNode* node = &nodes[idx];
+            int priority = node->priority + delta;
+            heap.updatePriority(node, priority < 0 ? 0 : priority);
+        }
+        auto updated = std::chrono::steady_clock::now();
+        uint64_t checksum = 0;
+        while (!heap.empty()) {
+            checksum = checksum * 31 + heap.pop()->tok_ids.first;
+        }
+        auto popped = std::chrono::steady_clock::now();
+
+        t.push_s = std::chrono::duration<double>(pushed - start).count();
+        t.update_s = std::chrono::duration<double>(updated - pushed).count();
+        t.pop_s = std::chrono::duration<double>(popped - updated).count();
+        t.checksum = checksum;
+        return t;
+    }
+
+    void report(const std::string& label, const Timings& t, size_t n, size_t m) {
+        std::cout << label << "push " << t.push_s * 1e9 / n << " ns  update "
+                  << t.update_s * 1e9 / m << " ns  pop " << t.pop_s * 1e9 / n << " ns\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_nodes = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    size_t num_updates = argc > 2 ? std::stoull(argv[2]) : 5000000;
+    Workload w = make_workload(num_nodes, num_updates);
+
+    Timings reference = run<ReferenceIndexedHeap>(w);
+    Timings binary = run<DaryIndexedHeap<2>>(w);
+    Timings quaternary = run<DaryIndexedHeap<4>>(w);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "=== IndexedHeap benchmark (" << num_nodes << " nodes, " << num_updates
+              << " updates) ===\n";
+    report("map-indexed binary:  ", reference, num_nodes, num_updates);
+    report("intrusive binary:    ", binary, num_nodes, num_updates);
+    report("intrusive 4-ary:     ", quaternary, num_nodes, num_updates);
+
+    bool same = reference.checksum == binary.checksum && reference.checksum == quaternary.checksum;
+    std::cout << "pop order " << (same ? "matches" : "DIFFERS") << "\n";
+    return same ? 0 : 1;
+}
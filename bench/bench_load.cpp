@@ -0,0 +1,76 @@
+/*
+ * Model load latency: text parsing vs mmapping the binary image.
+ *
+ *   bench_load [model]
+ *
+ * Without a model file, a synthetic 50k-token vocabulary is generated.
+ */
+#include "../include/model_image.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+    ModelImage synthetic_model(size_t vocab_size) {
+        std::vector<std::string> tokens = {"</w>"};
+        for (char c = 'a'; c <= 'z'; ++c) tokens.emplace_back(1, c);
+        std::unordered_set<std::string> seen(tokens.begin(), tokens.end());
+        std::vector<std::pair<int, int>> merges;
+        std::mt19937 rng(42);
+        while (tokens.size() < vocab_size) {
+            int left = 1 + rng() % (tokens.size() - 1);
+            int right = 1 + rng() % (tokens.size() - 1);
+            std::string merged = tokens[left] + tokens[right];
+            if (merged.size() > 12 || !seen.insert(merged).second) continue;
+            merges.emplace_back(left, right);
+            tokens.push_back(merged);
+        }
+        return ModelImage::build(tokens, merges);
+    }
+
+    template <typename Load>
+    double time_us(int iterations, Load&& load) {
+        auto start = std::chrono::steady_clock::now();
+        size_t sink = 0;
+        for (int i = 0; i < iterations; ++i) {
+            ModelImage image = load();
+            sink += image.vocab_size();
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        if (sink == 0) std::cout << "";
+        return elapsed.count() / iterations;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const std::string text_file = "bench_load_model.txt";
+    const std::string binary_file = "bench_load_model.bin";
+
+    ModelImage source = argc > 1 ? ModelImage::load_text(argv[1]) : synthetic_model(50000);
+    source.write_text(text_file);
+    source.write_binary(binary_file);
+
+    double text_us = time_us(5, [&] { return ModelImage::load_text(text_file); });
+    double binary_us = time_us(200, [&] { return ModelImage::map_file(binary_file, false); });
+    double verified_us = time_us(200, [&] { return ModelImage::map_file(binary_file); });
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "=== Load benchmark ===\n";
+    std::cout << "vocab: " << source.vocab_size() << "  merges: " << source.num_merges()
+              << "  binary size: " << source.size_bytes() / 1024 << " KiB\n";
+    std::cout << "text load:   " << text_us << " us\n";
+    std::cout << "binary mmap: " << binary_us << " us\n";
+    std::cout << "  checksum:  " << verified_us << " us\n";
+    std::cout << "speedup:     " << text_us / binary_us << "x\n";
+
+    std::filesystem::remove(text_file);
+    std::filesystem::remove(binary_file);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Pre-tokenizer throughput: the stringstream and byte-at-a-time word loops
+ * the library used before vs pretokenize() in both modes.
+ *
+ *   bench_pretokenize [corpus] [max_bytes] [repeats]
+ *
+ * The corpus (default wikitext2.txt, first 64 MiB) is read into memory once;
+ * each splitter runs over it `repeats` times (default 5) and the best run is
+ * reported.
+ */
+#include "../include/pretokenizer.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::string read_prefix(const std::string& path, size_t max_bytes) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open corpus: " + path);
+        }
+        std::string text(max_bytes, '\0');
+        in.read(text.data(), text.size());
+        text.resize(in.gcount());
+        return text;
+    }
+
+    // Returns the number of pieces so the work cannot be optimized away.
+    size_t stringstream_words(const std::string& text) {
+        std::istringstream in(text);
+        std::string word;
+        size_t n = 0;
+        while (in >> word) ++n;
+        return n;
+    }
+
+    size_t scalar_words(const std::string& text) {
+        auto is_space = [](char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+        };
+        size_t n = 0;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            while (pos < text.size() && is_space(text[pos])) pos++;
+            size_t start = pos;
+            while (pos < text.size() && !is_space(text[pos])) pos++;
+            if (start == pos) break;
+            ++n;
+        }
+        return n;
+    }
+
+    size_t simd_pieces(const std::string& text, PreTokenizer mode) {
+        thread_local std::vector<std::string_view> pieces;
+        pieces.clear();
+        pretokenize(text, mode, pieces);
+        return pieces.size();
+    }
+
+    void report(const std::string& label, const std::string& text, int repeats,
+                const std::function<size_t(const std::string&)>& split) {
+        double best = 1e30;
+        size_t pieces = 0;
+        for (int r = 0; r < repeats; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            pieces = split(text);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        std::cout << label << std::setw(9) << text.size() / 1e9 / best << " GB/s  "
+                  << pieces << " pieces\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string corpus = argc > 1 ? argv[1] : "wikitext2.txt";
+    size_t max_bytes = argc > 2 ? std::stoull(argv[2]) : (64u << 20);
+    int repeats = argc > 3 ? std::stoi(argv[3]) : 5;
+    std::string text = read_prefix(corpus, max_bytes);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "=== Pre-tokenizer benchmark (" << text.size() / (1024.0 * 1024.0) << " MiB) ===\n";
+    report("stringstream >> word:  ", text, 1, stringstream_words);
+    report("byte loop:             ", text, repeats, scalar_words);
+    report("pretokenize Whitespace:", text, repeats,
+           [](const std::string& t) { return simd_pieces(t, PreTokenizer::Whitespace); });
+    report("pretokenize CharClass: ", text, repeats,
+           [](const std::string& t) { return simd_pieces(t, PreTokenizer::CharClass); });
+    return 0;
+}
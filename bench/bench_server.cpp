@@ -0,0 +1,235 @@
+/*
+ * Load generator for tokenize-server: closed-loop clients, each keeping
+ * `depth` encode requests in flight, report QPS and client-side latency.
+ *
+ *   bench_server --model FILE [options]           serve in-process on a temp socket
+ *   bench_server --socket PATH | --port N [options]  drive a running server
+ *
+ * With --model, --window-us takes a comma-separated list and the run is
+ * repeated for each window, which shows the batching/latency tradeoff.
+ * Requests are the corpus's lines joined up to about --bytes each.
+ */
+#include "bpe.hpp"
+#include "tokenize_server.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::string model;
+        std::string socket;
+        int port = -1;
+        std::string corpus = "wikitext2.txt";
+        size_t connections = 8;
+        size_t depth = 4;
+        double seconds = 3;
+        size_t bytes = 256;
+        std::vector<uint32_t> windows = {200};
+        size_t max_batch = 64;
+        uint32_t slo_us = 0;
+        size_t threads = 0;
+    };
+
+    struct Result {
+        uint64_t requests = 0;
+        uint64_t bytes = 0;
+        double seconds = 0;
+        std::vector<double> latency_us;
+    };
+
+    void usage() {
+        std::cerr <<
+            "usage: bench_server (--model FILE | --socket PATH | --port N) [options]\n"
+            "  --corpus FILE        request text (default wikitext2.txt)\n"
+            "  --connections N      concurrent clients (default 8)\n"
+            "  --depth N            requests in flight per client (default 4)\n"
+            "  --seconds S          run time per configuration (default 3)\n"
+            "  --bytes N            approximate request size (default 256)\n"
+            "  in-process server only (--model):\n"
+            "  --window-us A,B,...  batch windows to compare (default 200)\n"
+            "  --max-batch N        requests per batch at most (default 64)\n"
+            "  --slo-us N           latency SLO mode\n"
+            "  --threads N          encoding threads (default: one per core)\n";
+    }
+
+    Options parse_args(int argc, char* argv[]) {
+        Options opts;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--model") opts.model = value();
+            else if (arg == "--socket") opts.socket = value();
+            else if (arg == "--port") opts.port = std::stoi(value());
+            else if (arg == "--corpus") opts.corpus = value();
+            else if (arg == "--connections") opts.connections = std::max<size_t>(1, std::stoull(value()));
+            else if (arg == "--depth") opts.depth = std::max<size_t>(1, std::stoull(value()));
+            else if (arg == "--seconds") opts.seconds = std::stod(value());
+            else if (arg == "--bytes") opts.bytes = std::max<size_t>(1, std::stoull(value()));
+            else if (arg == "--window-us") {
+                opts.windows.clear();
+                std::stringstream list(value());
+                for (std::string w; std::getline(list, w, ',');) opts.windows.push_back(std::stoul(w));
+            }
+            else if (arg == "--max-batch") opts.max_batch = std::stoull(value());
+            else if (arg == "--slo-us") opts.slo_us = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--threads") opts.threads = std::stoull(value());
+            else if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            else throw std::runtime_error("Unknown option " + arg);
+        }
+        if (opts.model.empty() && opts.socket.empty() && opts.port < 0) {
+            usage();
+            std::exit(2);
+        }
+        return opts;
+    }
+
+    std::vector<std::string> load_requests(const std::string& corpus, size_t bytes) {
+        std::ifstream in(corpus);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open corpus: " + corpus);
+        }
+        std::vector<std::string> requests;
+        std::string current, line;
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            current += line;
+            current += '\n';
+            if (current.size() >= bytes) {
+                requests.push_back(std::move(current));
+                current.clear();
+            }
+        }
+        if (!current.empty()) requests.push_back(std::move(current));
+        if (requests.empty()) {
+            throw std::runtime_error("Corpus is empty: " + corpus);
+        }
+        return requests;
+    }
+
+    // One closed-loop client: keep `depth` requests in flight until the deadline
+    void run_client(TokenizeClient client, const std::vector<std::string>& requests, size_t first,
+                    size_t depth, Clock::time_point deadline, Result& result) {
+        std::deque<Clock::time_point> sent;
+        size_t next = first;
+        auto send_one = [&] {
+            const std::string& text = requests[next++ % requests.size()];
+            sent.push_back(Clock::now());
+            client.send(server_protocol::Op::Encode, text);
+            result.bytes += text.size();
+        };
+        for (size_t i = 0; i < depth; ++i) send_one();
+        while (!sent.empty()) {
+            client.receive();
+            result.latency_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent.front()).count());
+            sent.pop_front();
+            ++result.requests;
+            if (Clock::now() < deadline) send_one();
+        }
+    }
+
+    Result run_load(const Options& opts, const std::vector<std::string>& requests,
+                    const std::string& socket, uint16_t port) {
+        std::vector<TokenizeClient> clients;
+        for (size_t c = 0; c < opts.connections; ++c) {
+            clients.push_back(socket.empty() ? TokenizeClient::connect_tcp(port) : TokenizeClient::connect_unix(socket));
+        }
+        std::vector<Result> results(opts.connections);
+        std::vector<std::thread> threads;
+        const auto start = Clock::now();
+        const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(opts.seconds));
+        for (size_t c = 0; c < opts.connections; ++c) {
+            threads.emplace_back(run_client, std::move(clients[c]), std::cref(requests),
+                                 c * requests.size() / opts.connections, opts.depth, deadline, std::ref(results[c]));
+        }
+        for (auto& t : threads) t.join();
+
+        Result total;
+        total.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        for (auto& r : results) {
+            total.requests += r.requests;
+            total.bytes += r.bytes;
+            total.latency_us.insert(total.latency_us.end(), r.latency_us.begin(), r.latency_us.end());
+        }
+        std::sort(total.latency_us.begin(), total.latency_us.end());
+        return total;
+    }
+
+    void print_row(const std::string& label, const Result& r, double mean_batch) {
+        auto pct = [&](double p) {
+            return r.latency_us.empty() ? 0.0 : r.latency_us[static_cast<size_t>(p * (r.latency_us.size() - 1))];
+        };
+        std::cout << std::setw(10) << label << std::setw(11) << std::setprecision(0) << r.requests / r.seconds
+                  << std::setw(9) << std::setprecision(1) << r.bytes / r.seconds / (1024.0 * 1024.0)
+                  << std::setw(10) << std::setprecision(0) << pct(0.5) << std::setw(10) << pct(0.99)
+                  << std::setw(10) << (r.latency_us.empty() ? 0.0 : r.latency_us.back());
+        if (mean_batch > 0) std::cout << std::setw(12) << std::setprecision(1) << mean_batch;
+        std::cout << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options opts = parse_args(argc, argv);
+        const auto requests = load_requests(opts.corpus, opts.bytes);
+
+        std::cout << "=== Tokenize server load ===\n";
+        std::cout << "corpus: " << opts.corpus << ", " << requests.size() << " requests of ~" << opts.bytes
+                  << " bytes, " << opts.connections << " connections x depth " << opts.depth << "\n";
+        std::cout << std::fixed << " window_us        qps    MiB/s   p50_us    p99_us    max_us  mean_batch\n";
+
+        if (opts.model.empty()) {
+            Result r = run_load(opts, requests, opts.socket, static_cast<uint16_t>(std::max(opts.port, 0)));
+            print_row("-", r, 0);
+            auto client = opts.socket.empty() ? TokenizeClient::connect_tcp(static_cast<uint16_t>(opts.port))
+                                              : TokenizeClient::connect_unix(opts.socket);
+            std::cout << "server: " << client.stats_json() << "\n";
+            return 0;
+        }
+
+        auto tokenizer = std::make_shared<const Tokenizer>(Tokenizer::load(opts.model));
+        const std::string socket = opts.port >= 0 ? "" :
+            (std::filesystem::temp_directory_path() / ("bench_server_" + std::to_string(::getpid()) + ".sock")).string();
+        for (uint32_t window : opts.windows) {
+            ServerOptions server_opts;
+            server_opts.unix_socket = socket;
+            server_opts.port = static_cast<uint16_t>(std::max(opts.port, 0));
+            server_opts.threads = opts.threads;
+            server_opts.batch_window_us = window;
+            server_opts.max_batch = opts.max_batch;
+            server_opts.slo_us = opts.slo_us;
+            TokenizeServer server(tokenizer, server_opts);
+            server.start();
+            Result r = run_load(opts, requests, socket, server.port());
+            const ServerStats stats = server.stats();
+            print_row(std::to_string(window), r, stats.mean_batch());
+            server.stop();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "bench_server: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
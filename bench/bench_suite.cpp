@@ -0,0 +1,281 @@
+/*
+ * Google Benchmark suite over the whole pipeline: pre-tokenization, encode
+ * and decode by text length, model load, training time per merge and the
+ * IndexedHeap operations. Inputs are generated by synthetic_corpus.hpp.
+ *
+ *   bench_suite [--benchmark_filter=...] [--benchmark_out=results.json --benchmark_out_format=json]
+ *
+ * The `bench` build target runs everything and writes bench_results.json
+ * into the build directory.
+ */
+#include "../include/bpe.hpp"
+#include "../include/indexed_heap.hpp"
+#include "../include/pretokenizer.hpp"
+#include "../include/stream_encoder.hpp"
+#include "synthetic_corpus.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    constexpr size_t kCorpusBytes = 8u << 20;
+    constexpr size_t kTrainBytes = 1u << 20;
+    constexpr size_t kModelVocab = 5000;
+
+    const std::string& corpus() {
+        static const std::string text = synthetic_corpus(kCorpusBytes);
+        return text;
+    }
+
+    // The first `len` bytes of the corpus, cut back to a word boundary.
+    std::string_view corpus_prefix(size_t len) {
+        std::string_view text = corpus();
+        if (len >= text.size()) return text;
+        while (len > 0 && !is_space_byte(text[len])) --len;
+        return text.substr(0, len);
+    }
+
+    std::string scratch_path(const std::string& name) {
+        return (std::filesystem::temp_directory_path() / ("bench_suite_" + name)).string();
+    }
+
+    const std::string& train_file() {
+        static const std::string path = [] {
+            std::string p = scratch_path("train.txt");
+            std::ofstream(p) << corpus_prefix(kTrainBytes);
+            return p;
+        }();
+        return path;
+    }
+
+    Tokenizer train_quietly(const std::string& path, size_t vocab_size) {
+        Trainer trainer;
+        return trainer.train(path, vocab_size, TrainOptions{.log = nullptr});
+    }
+
+    const Tokenizer& model() {
+        static const Tokenizer tokenizer = train_quietly(train_file(), kModelVocab);
+        return tokenizer;
+    }
+
+    void BM_Pretokenize(benchmark::State& state) {
+        const PreTokenizer mode = static_cast<PreTokenizer>(state.range(0));
+        std::string_view text = corpus();
+        std::vector<std::string_view> pieces;
+        for (auto _ : state) {
+            pieces.clear();
+            pretokenize(text, mode, pieces);
+            benchmark::DoNotOptimize(pieces.data());
+        }
+        state.SetBytesProcessed(state.iterations() * text.size());
+        state.counters["pieces/s"] = benchmark::Counter(
+            static_cast<double>(pieces.size()) * state.iterations(), benchmark::Counter::kIsRate);
+    }
+    BENCHMARK(BM_Pretokenize)->ArgName("char_class")->Arg(0)->Arg(1);
+
+    void BM_Encode(benchmark::State& state) {
+        const Tokenizer& tokenizer = model();
+        std::string_view text = corpus_prefix(state.range(0));
+        std::vector<uint32_t> ids;
+        for (auto _ : state) {
+            ids.clear();
+            tokenizer.encode(text, ids);
+            benchmark::DoNotOptimize(ids.data());
+        }
+        state.SetBytesProcessed(state.iterations() * text.size());
+        state.counters["tokens/s"] = benchmark::Counter(
+            static_cast<double>(ids.size()) * state.iterations(), benchmark::Counter::kIsRate);
+    }
+    BENCHMARK(BM_Encode)->RangeMultiplier(16)->Range(64, 4 << 20);
+
+    void BM_EncodeCached(benchmark::State& state) {
+        Tokenizer tokenizer = Tokenizer::load(scratch_path("model.bin"));
+        tokenizer.set_cache_budget(64u << 20);
+        std::string_view text = corpus_prefix(state.range(0));
+        std::vector<uint32_t> ids;
+        tokenizer.encode(text, ids);  // warm the cache
+        for (auto _ : state) {
+            ids.clear();
+            tokenizer.encode(text, ids);
+            benchmark::DoNotOptimize(ids.data());
+        }
+        state.SetBytesProcessed(state.iterations() * text.size());
+        state.counters["tokens/s"] = benchmark::Counter(
+            static_cast<double>(ids.size()) * state.iterations(), benchmark::Counter::kIsRate);
+    }
+    BENCHMARK(BM_EncodeCached)->Arg(1 << 20);
+
+    // Chat-formatted text: corpus turns of about 200 bytes wrapped in markers,
+    // against the same turns with special token matching turned off
+    void BM_EncodeChat(benchmark::State& state) {
+        static const Tokenizer tokenizer = [] {
+            Tokenizer t = train_quietly(train_file(), kModelVocab);
+            t.add_special_tokens({"<|im_start|>", "<|im_end|>"});
+            return t;
+        }();
+        static const std::string chat = [] {
+            std::string text;
+            std::string_view rest = corpus_prefix(1u << 20);
+            for (bool user = true; !rest.empty(); user = !user) {
+                size_t len = std::min<size_t>(200, rest.size());
+                while (len < rest.size() && !is_space_byte(rest[len])) ++len;
+                text += user ? "<|im_start|>user\n" : "<|im_start|>assistant\n";
+                text += rest.substr(0, len);
+                text += "<|im_end|>\n";
+                rest.remove_prefix(len);
+            }
+            return text + "<|endoftext|>";
+        }();
+        const SpecialTokenPolicy special{.mode = state.range(0) ? SpecialTokenPolicy::Mode::All
+                                                                : SpecialTokenPolicy::Mode::None};
+        std::vector<uint32_t> ids;
+        for (auto _ : state) {
+            ids.clear();
+            tokenizer.encode(chat, ids, nullptr, special);
+            benchmark::DoNotOptimize(ids.data());
+        }
+        state.SetBytesProcessed(state.iterations() * chat.size());
+        state.counters["tokens/s"] = benchmark::Counter(
+            static_cast<double>(ids.size()) * state.iterations(), benchmark::Counter::kIsRate);
+    }
+    BENCHMARK(BM_EncodeChat)->ArgName("special")->Arg(0)->Arg(1);
+
+    // The corpus fed to a StreamEncoder in chunks of range(0) bytes
+    void BM_EncodeStream(benchmark::State& state) {
+        const Tokenizer& tokenizer = model();
+        std::string_view text = corpus_prefix(4 << 20);
+        const size_t chunk = state.range(0);
+        uint64_t tokens = 0;
+        StreamEncoder encoder(tokenizer, [&](std::span<const uint32_t> ids) { tokens += ids.size(); });
+        for (auto _ : state) {
+            for (size_t at = 0; at < text.size(); at += chunk) {
+                encoder.write(text.substr(at, chunk));
+            }
+            encoder.finish();
+        }
+        state.SetBytesProcessed(state.iterations() * text.size());
+        state.counters["tokens/s"] = benchmark::Counter(static_cast<double>(tokens), benchmark::Counter::kIsRate);
+    }
+    BENCHMARK(BM_EncodeStream)->Arg(4 << 10)->Arg(1 << 20);
+
+    void BM_Decode(benchmark::State& state) {
+        const Tokenizer& tokenizer = model();
+        std::vector<uint32_t> ids = tokenizer.encode(corpus_prefix(state.range(0)));
+        std::string text;
+        for (auto _ : state) {
+            text.clear();
+            tokenizer.decode_append(ids, text);
+            benchmark::DoNotOptimize(text.data());
+        }
+        state.SetBytesProcessed(state.iterations() * text.size());
+        state.counters["tokens/s"] = benchmark::Counter(
+            static_cast<double>(ids.size()) * state.iterations(), benchmark::Counter::kIsRate);
+    }
+    BENCHMARK(BM_Decode)->RangeMultiplier(16)->Range(64, 4 << 20);
+
+    void BM_LoadModel(benchmark::State& state) {
+        const bool binary = state.range(0) != 0;
+        const std::string path = scratch_path(binary ? "model.bin" : "model.txt");
+        for (auto _ : state) {
+            Tokenizer tokenizer = Tokenizer::load(path);
+            benchmark::DoNotOptimize(tokenizer.vocab_size());
+        }
+        state.SetLabel(binary ? "binary (mmap)" : "text");
+    }
+    BENCHMARK(BM_LoadModel)->ArgName("binary")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+    void BM_Train(benchmark::State& state) {
+        const size_t vocab_size = state.range(0);
+        size_t merges = 0;
+        for (auto _ : state) {
+            Tokenizer tokenizer = train_quietly(train_file(), vocab_size);
+            merges = tokenizer.model().num_merges();
+        }
+        state.SetBytesProcessed(state.iterations() * kTrainBytes);
+        state.counters["merges"] = static_cast<double>(merges);
+        state.counters["time/merge"] = benchmark::Counter(
+            static_cast<double>(merges) * state.iterations(),
+            benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    }
+    BENCHMARK(BM_Train)->Arg(1000)->Arg(5000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    // Heap workload shaped like training: skewed counts, mostly +-1 updates.
+    std::vector<HeapNode> heap_nodes(size_t n) {
+        std::mt19937 rng(42);
+        std::vector<HeapNode> nodes(n);
+        for (size_t i = 0; i < n; ++i) {
+            nodes[i].tok_ids = {static_cast<int>(i), 0};
+            nodes[i].priority = 1 + static_cast<int>(100000 / (1 + i)) + static_cast<int>(rng() % 8);
+        }
+        std::shuffle(nodes.begin(), nodes.end(), rng);
+        return nodes;
+    }
+
+    void BM_HeapPush(benchmark::State& state) {
+        std::vector<HeapNode> nodes = heap_nodes(state.range(0));
+        IndexedHeap heap;
+        for (auto _ : state) {
+            for (auto& node : nodes) heap.push(&node);
+            state.PauseTiming();
+            heap.clear();
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.iterations() * nodes.size());
+    }
+    BENCHMARK(BM_HeapPush)->Arg(1 << 16)->Arg(1 << 20);
+
+    void BM_HeapPop(benchmark::State& state) {
+        std::vector<HeapNode> nodes = heap_nodes(state.range(0));
+        IndexedHeap heap;
+        for (auto _ : state) {
+            state.PauseTiming();
+            for (auto& node : nodes) heap.push(&node);
+            state.ResumeTiming();
+            while (!heap.empty()) benchmark::DoNotOptimize(heap.pop());
+        }
+        state.SetItemsProcessed(state.iterations() * nodes.size());
+    }
+    BENCHMARK(BM_HeapPop)->Arg(1 << 16)->Arg(1 << 20);
+
+    void BM_HeapUpdate(benchmark::State& state) {
+        std::vector<HeapNode> nodes = heap_nodes(state.range(0));
+        IndexedHeap heap;
+        for (auto& node : nodes) heap.push(&node);
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::vector<std::pair<HeapNode*, int>> updates(1 << 16);
+        for (auto& [node, delta] : updates) {
+            node = &nodes[static_cast<size_t>(nodes.size() * unit(rng) * unit(rng) * unit(rng))];
+            delta = rng() % 3 == 0 ? 1 : -1;
+        }
+        size_t i = 0;
+        for (auto _ : state) {
+            auto [node, delta] = updates[i++ & (updates.size() - 1)];
+            heap.updatePriority(node, std::max(0, node->priority + delta));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_HeapUpdate)->Arg(1 << 16)->Arg(1 << 20);
+}
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    model().save(scratch_path("model.txt"), ModelFormat::Text);
+    model().save(scratch_path("model.bin"), ModelFormat::Binary);
+    benchmark::AddCustomContext("corpus", "synthetic wikitext-style, " + std::to_string(kCorpusBytes) + " bytes");
+    benchmark::AddCustomContext("model_vocab", std::to_string(kModelVocab));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    for (const char* name : {"train.txt", "model.txt", "model.bin"}) {
+        std::filesystem::remove(scratch_path(name));
+    }
+    return 0;
+}
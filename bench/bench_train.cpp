@@ -0,0 +1,106 @@
+/*
+ * Training time on a corpus slice, with and without word deduplication, and
+ * with each merge queue.
+ *
+ *   bench_train [corpus] [vocab_size] [max_bytes] [plain_max_bytes]
+ *
+ * Defaults to wikitext2.txt, a 5000 token vocabulary and the whole corpus.
+ * Training one run per occurrence (dedup_words = false) is far slower, so it
+ * runs on the first `plain_max_bytes` (default 1 MiB; 0 skips it). A run
+ * with TrainOptions::collect_metrics shows what the per-merge timers cost.
+ */
+#include "../include/bpe.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    // Copy the first max_bytes of `path`, cut at a line end, to a scratch file.
+    std::string slice(const std::string& path, size_t max_bytes, const std::string& out_path) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open corpus: " + path);
+        }
+        std::ofstream out(out_path);
+        std::string line;
+        size_t total = 0;
+        while (total < max_bytes && std::getline(in, line)) {
+            total += line.size() + 1;
+            out << line << '\n';
+        }
+        return out_path;
+    }
+
+    struct Run {
+        double seconds;
+        size_t merges;
+        size_t bytes;
+        std::vector<std::pair<int, int>> merge_list;
+        TrainMetrics metrics;
+    };
+
+    Run time_train(const std::string& corpus, size_t vocab_size, TrainOptions options) {
+        options.log = nullptr;
+        Trainer trainer;
+        auto start = std::chrono::steady_clock::now();
+        Tokenizer tokenizer = trainer.train(corpus, vocab_size, options);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        Run run{elapsed.count(), tokenizer.model().num_merges(),
+                static_cast<size_t>(std::filesystem::file_size(corpus)), {}, trainer.metrics()};
+        for (size_t rank = 0; rank < run.merges; ++rank) {
+            const ModelImage::Merge& merge = tokenizer.model().merge(rank);
+            run.merge_list.emplace_back(merge.left, merge.right);
+        }
+        return run;
+    }
+
+    void report(const std::string& label, const Run& run) {
+        std::cout << label << run.seconds << "s  " << run.merges << " merges  "
+                  << run.merges / run.seconds << " merges/s  "
+                  << run.bytes / (1024.0 * 1024.0) / run.seconds << " MiB/s\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string corpus = argc > 1 ? argv[1] : "wikitext2.txt";
+    size_t vocab_size = argc > 2 ? std::stoull(argv[2]) : 5000;
+    size_t max_bytes = argc > 3 ? std::stoull(argv[3]) : 0;
+    size_t plain_max_bytes = argc > 4 ? std::stoull(argv[4]) : (1u << 20);
+
+    std::string full = max_bytes > 0 ? slice(corpus, max_bytes, "bench_train_slice.txt") : corpus;
+    Run indexed = time_train(full, vocab_size, TrainOptions{.queue = MergeQueue::Indexed});
+    Run lazy = time_train(full, vocab_size, TrainOptions{.queue = MergeQueue::Lazy});
+    Run measured = time_train(full, vocab_size, TrainOptions{.collect_metrics = true});
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "=== Training benchmark ===\n";
+    std::cout << "corpus:      " << corpus << ", vocab " << vocab_size << "\n";
+    report("dedup, indexed heap:    ", indexed);
+    report("dedup, lazy heap:       ", lazy);
+    report("  with collect_metrics: ", measured);
+    const Histogram& latency = measured.metrics.merge_ns;
+    std::cout << "  merge latency p50 <" << latency.percentile(0.5) / 1000.0 << "us  p99 <"
+              << latency.percentile(0.99) / 1000.0 << "us  max " << latency.max / 1000.0 << "us\n";
+    bool same = indexed.merge_list == lazy.merge_list && indexed.merge_list == measured.merge_list;
+    if (plain_max_bytes > 0) {
+        std::string part = slice(corpus, plain_max_bytes, "bench_train_plain.txt");
+        Run plain = time_train(part, vocab_size, TrainOptions{.dedup_words = false, .queue = MergeQueue::Indexed});
+        Run plain_lazy = time_train(part, vocab_size, TrainOptions{.dedup_words = false, .queue = MergeQueue::Lazy});
+        Run plain_dedup = time_train(part, vocab_size, TrainOptions{.dedup_words = true});
+        report("per-occurrence (slice): ", plain);
+        report("  with lazy heap:       ", plain_lazy);
+        report("dedup (slice):          ", plain_dedup);
+        same = same && plain.merge_list == plain_lazy.merge_list && plain.merge_list == plain_dedup.merge_list;
+        std::filesystem::remove(part);
+    }
+    if (full != corpus) std::filesystem::remove(full);
+    std::cout << "merges " << (same ? "match" : "DIFFER") << " across modes\n";
+    return same ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * WordPiece vs BPE: training time for the same vocab size, and encode
+ * throughput of the BPE encoder, the LinMaxMatch WordPiece encoder and
+ * BERT's original hash-probing loop (bench/reference_wordpiece.hpp), whose
+ * tokens must match.
+ *
+ *   bench_wordpiece [corpus] [vocab_size] [max_bytes]
+ *
+ * Defaults to wikitext2.txt, a 5000 token vocab and the first 4 MiB of the
+ * corpus, which both models are trained on.
+ */
+#include "../include/bpe.hpp"
+#include "../include/wordpiece.hpp"
+#include "reference_wordpiece.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    std::string read_prefix(const std::string& path, size_t max_bytes) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open corpus: " + path);
+        }
+        std::string text(max_bytes, '\0');
+        in.read(text.data(), text.size());
+        text.resize(in.gcount());
+        while (!text.empty() && !is_space_byte(text.back())) text.pop_back();
+        return text;
+    }
+
+    template <typename Fn>
+    double seconds(Fn&& fn) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const std::string& label, double secs, size_t bytes, size_t tokens) {
+        std::cout << label << std::setw(8) << secs << "s  " << std::setw(8) << bytes / (1024.0 * 1024.0) / secs
+                  << " MiB/s  " << tokens << " tokens\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string corpus = argc > 1 ? argv[1] : "wikitext2.txt";
+    size_t vocab_size = argc > 2 ? std::stoull(argv[2]) : 5000;
+    size_t max_bytes = argc > 3 ? std::stoull(argv[3]) : (4u << 20);
+
+    const std::string text = read_prefix(corpus, max_bytes);
+    const std::string slice = "bench_wordpiece_slice.txt";
+    std::ofstream(slice, std::ios::binary) << text;
+
+    Trainer trainer;
+    Tokenizer bpe;
+    WordPiece wp;
+    double bpe_train = seconds([&] { bpe = trainer.train(slice, vocab_size, TrainOptions{.log = nullptr}); });
+    double wp_train = seconds([&] { wp = train_wordpiece(slice, vocab_size, TrainOptions{.log = nullptr}); });
+    std::filesystem::remove(slice);
+
+    std::vector<std::string_view> words;
+    pretokenize(text, PreTokenizer::Whitespace, words);
+    ReferenceWordPiece reference(std::vector<std::string>(
+        [&] {
+            std::vector<std::string> vocab;
+            for (int id = 0; id < wp.vocab_size(); ++id) vocab.push_back(wp.token(id));
+            return vocab;
+        }()));
+
+    std::vector<uint32_t> bpe_ids, wp_ids, ref_ids;
+    double bpe_secs = seconds([&] { bpe.encode(text, bpe_ids); });
+    double wp_secs = seconds([&] { wp.encode(text, wp_ids); });
+    double ref_secs = seconds([&] {
+        for (std::string_view word : words) reference.encode_word(word, ref_ids);
+    });
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "=== WordPiece benchmark (" << text.size() / (1024.0 * 1024.0) << " MiB, vocab "
+              << vocab_size << ") ===\n";
+    std::cout << "train BPE:              " << bpe_train << "s (" << bpe.vocab_size() << " tokens)\n";
+    std::cout << "train WordPiece:        " << wp_train << "s (" << wp.vocab_size() << " tokens)\n";
+    report("encode BPE:             ", bpe_secs, text.size(), bpe_ids.size());
+    report("encode WordPiece:       ", wp_secs, text.size(), wp_ids.size());
+    report("  reference (probing):  ", ref_secs, text.size(), ref_ids.size());
+    bool same = wp_ids == ref_ids;
+    std::cout << "WordPiece tokens " << (same ? "match" : "DIFFER from") << " the reference\n";
+    return same ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#ifndef REFERENCE_BPE_HPP
+#define REFERENCE_BPE_HPP
+
+/*
+ * The original tokenize() loop, kept as a correctness oracle and a baseline
+ * for the encode benchmark: every merge is applied in order by rescanning the
+ * word and erasing. Reads the text model format written by save_model().
+ */
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ReferenceBpe {
+public:
+    explicit ReferenceBpe(const std::string& model_file) {
+        std::ifstream in(model_file);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open model file: " + model_file);
+        }
+        std::string line;
+        std::getline(in, line);  // VOCAB_SIZE
+        std::getline(in, line);  // VOCAB
+        while (std::getline(in, line) && line != "MERGES") {
+            size_t tab_pos = line.find('\t');
+            if (tab_pos == std::string::npos) continue;
+            std::string token = line.substr(0, tab_pos);
+            int id = std::stoi(line.substr(tab_pos + 1));
+            vocab_to_id[token] = id;
+            id_to_vocab[id] = token;
+            if (id >= vocab_size) vocab_size = id + 1;
+        }
+        while (std::getline(in, line)) {
+            size_t space_pos = line.find(' ');
+            if (space_pos == std::string::npos) continue;
+            auto first = vocab_to_id.find(line.substr(0, space_pos));
+            auto second = vocab_to_id.find(line.substr(space_pos + 1));
+            if (first != vocab_to_id.end() && second != vocab_to_id.end()) {
+                merges.emplace_back(first->second, second->second);
+            }
+        }
+    }
+
+    std::vector<std::string> tokenize(const std::string& text) {
+        std::vector<std::vector<int> > words;
+        std::stringstream ss(text);
+        std::string word;
+        while (ss >> word) {
+            std::vector<int> token_ids;
+            for (size_t i = 0; i < word.size(); ++i) {
+                std::string ch = word.substr(i, 1);
+                if (vocab_to_id.find(ch) == vocab_to_id.end()) {
+                    vocab_to_id[ch] = vocab_size;
+                    id_to_vocab[vocab_size++] = ch;
+                }
+                token_ids.push_back(vocab_to_id[ch]);
+            }
+            if (vocab_to_id.find("</w>") != vocab_to_id.end()) {
+                token_ids.push_back(vocab_to_id["</w>"]);
+            }
+            words.push_back(token_ids);
+        }
+        for (auto& token_ids : words) {
+            for (const auto& merge : merges) {
+                bool changed = true;
+                while (changed) {
+                    changed = false;
+                    for (size_t i = 0; i + 1 < token_ids.size(); ++i) {
+                        if (token_ids[i] == merge.first && token_ids[i + 1] == merge.second) {
+                            auto merged = vocab_to_id.find(id_to_vocab[merge.first] + id_to_vocab[merge.second]);
+                            if (merged == vocab_to_id.end()) continue;
+                            token_ids[i] = merged->second;
+                            token_ids.erase(token_ids.begin() + i + 1);
+                            changed = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        std::vector<std::string> result;
+        for (const auto& token_ids : words) {
+            for (int id : token_ids) {
+                result.push_back(id_to_vocab[id]);
+            }
+        }
+        return result;
+    }
+
+private:
+    std::unordered_map<std::string, int> vocab_to_id;
+    std::unordered_map<int, std::string> id_to_vocab;
+    std::vector<std::pair<int, int> > merges;
+    int vocab_size = 0;
+};
+
+#endif // REFERENCE_BPE_HPP
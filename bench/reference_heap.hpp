@@ -0,0 +1,101 @@
+#ifndef REFERENCE_HEAP_HPP
+#define REFERENCE_HEAP_HPP
+
+/*
+ * The original IndexedHeap, kept as a baseline for the heap benchmark: a
+ * binary heap of node pointers whose positions live in an
+ * unordered_map<HeapNode*, int> updated on every swap. Ties are broken by
+ * tok_ids like the current heap so both pop in the same order.
+ */
+#include "../include/indexed_heap.hpp"
+
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ReferenceIndexedHeap {
+public:
+    void push(HeapNode* node) {
+        if (nodeToIndex.find(node) != nodeToIndex.end()) {
+            updatePriority(node, node->priority);
+            return;
+        }
+        nodeToIndex[node] = heap.size();
+        heap.push_back(node);
+        bubbleUp(heap.size() - 1);
+    }
+
+    void updatePriority(HeapNode* node, int newPriority) {
+        auto it = nodeToIndex.find(node);
+        if (it == nodeToIndex.end()) return;
+        int idx = it->second;
+        int oldPriority = node->priority;
+        node->priority = newPriority;
+        if (newPriority > oldPriority) {
+            bubbleUp(idx);
+        } else if (newPriority < oldPriority) {
+            bubbleDown(idx);
+        }
+    }
+
+    HeapNode* pop() {
+        if (heap.empty()) {
+            throw std::runtime_error("Heap is empty");
+        }
+        HeapNode* result = heap[0];
+        nodeToIndex.erase(result);
+        if (heap.size() > 1) {
+            heap[0] = heap.back();
+            nodeToIndex[heap[0]] = 0;
+            heap.pop_back();
+            bubbleDown(0);
+        } else {
+            heap.pop_back();
+        }
+        return result;
+    }
+
+    bool empty() const { return heap.empty(); }
+    size_t size() const { return heap.size(); }
+
+private:
+    std::vector<HeapNode*> heap;
+    std::unordered_map<HeapNode*, int> nodeToIndex;
+
+    static bool before(const HeapNode* a, const HeapNode* b) {
+        if (a->priority != b->priority) return a->priority > b->priority;
+        return a->tok_ids < b->tok_ids;
+    }
+
+    void swapNodes(int i, int j) {
+        nodeToIndex[heap[i]] = j;
+        nodeToIndex[heap[j]] = i;
+        std::swap(heap[i], heap[j]);
+    }
+
+    void bubbleUp(int idx) {
+        while (idx > 0) {
+            int parent = (idx - 1) / 2;
+            if (!before(heap[idx], heap[parent])) break;
+            swapNodes(idx, parent);
+            idx = parent;
+        }
+    }
+
+    void bubbleDown(int idx) {
+        int n = heap.size();
+        while (true) {
+            int largest = idx;
+            int left = 2 * idx + 1;
+            int right = 2 * idx + 2;
+            if (left < n && before(heap[left], heap[largest])) largest = left;
+            if (right < n && before(heap[right], heap[largest])) largest = right;
+            if (largest == idx) break;
+            swapNodes(idx, largest);
+            idx = largest;
+        }
+    }
+};
+
+#endif // REFERENCE_HEAP_HPP
@@ -0,0 +1,63 @@
+#ifndef REFERENCE_WORDPIECE_HPP
+#define REFERENCE_WORDPIECE_HPP
+
+/*
+ * BERT's original WordPiece loop, kept as a correctness oracle and a baseline
+ * for the WordPiece benchmark: at each position the longest remaining
+ * substring is looked up in a hash set, then shorter and shorter ones.
+ */
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ReferenceWordPiece {
+public:
+    ReferenceWordPiece(const std::vector<std::string>& vocab, std::string unk_token = "[UNK]",
+                       std::string prefix = "##", size_t max_word_bytes = 100)
+        : prefix(std::move(prefix)), max_word_bytes(max_word_bytes) {
+        for (size_t id = 0; id < vocab.size(); ++id) {
+            ids.emplace(vocab[id], static_cast<int>(id));  // the first id of a repeated token wins
+        }
+        unk = ids.at(unk_token);
+    }
+
+    void encode_word(std::string_view word, std::vector<uint32_t>& out) const {
+        if (word.size() > max_word_bytes) {
+            out.push_back(unk);
+            return;
+        }
+        std::vector<uint32_t> pieces;
+        size_t start = 0;
+        std::string candidate;
+        while (start < word.size()) {
+            int found = -1;
+            size_t end = word.size();
+            for (; end > start; --end) {
+                candidate = start > 0 ? prefix : std::string();
+                candidate.append(word.substr(start, end - start));
+                auto it = ids.find(candidate);
+                if (it != ids.end()) {
+                    found = it->second;
+                    break;
+                }
+            }
+            if (found < 0) {
+                out.push_back(unk);
+                return;
+            }
+            pieces.push_back(found);
+            start = end;
+        }
+        out.insert(out.end(), pieces.begin(), pieces.end());
+    }
+
+private:
+    std::unordered_map<std::string, int> ids;
+    std::string prefix;
+    size_t max_word_bytes;
+    int unk = -1;
+};
+
+#endif // REFERENCE_WORDPIECE_HPP
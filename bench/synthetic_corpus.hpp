@@ -0,0 +1,54 @@
+#ifndef SYNTHETIC_CORPUS_HPP
+#define SYNTHETIC_CORPUS_HPP
+
+/*
+ * Wikitext-style text generated on the spot, so benchmarks need no
+ * downloaded data: " = Heading = " lines followed by paragraphs of
+ * sentences over a Zipf-distributed vocabulary of pseudo-words, with
+ * numbers, commas and wikitext's " @-@ " / " @,@ " joins.
+ */
+#include <random>
+#include <string>
+#include <vector>
+
+inline std::string synthetic_corpus(size_t bytes, unsigned seed = 42) {
+    static const char* const syllables[] = {
+        "a", "an", "ar", "be", "con", "de", "di", "en", "er", "ex", "for", "ga", "in", "is",
+        "ka", "la", "le", "ma", "ment", "mi", "na", "ne", "o", "on", "or", "pa", "per", "pro",
+        "ra", "re", "ri", "sa", "se", "si", "sta", "ta", "te", "ter", "ti", "tion", "to", "tra",
+        "u", "un", "ver", "vi", "za"};
+    constexpr size_t n_syllables = sizeof(syllables) / sizeof(syllables[0]);
+
+    std::mt19937 rng(seed);
+    std::vector<std::string> words = {"the", "of", "and", "in", "to", "a", "was", "is", "for", "on"};
+    while (words.size() < 20000) {
+        std::string word;
+        for (size_t n = 1 + rng() % 4; n > 0; --n) word += syllables[rng() % n_syllables];
+        words.push_back(word);
+    }
+    std::vector<double> weights(words.size());
+    for (size_t rank = 0; rank < words.size(); ++rank) weights[rank] = 1.0 / (rank + 1);
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+
+    std::string text;
+    text.reserve(bytes + 256);
+    while (text.size() < bytes) {
+        text += " = " + words[zipf(rng)] + " " + words[zipf(rng)] + " = \n";
+        for (size_t sentences = 3 + rng() % 6; sentences > 0; --sentences) {
+            for (size_t n = 6 + rng() % 20; n > 0; --n) {
+                switch (rng() % 40) {
+                    case 0: text += std::to_string(rng() % 2000) + " "; break;
+                    case 1: text += ", "; break;
+                    case 2: text += "@-@ "; break;
+                    case 3: text += std::to_string(rng() % 100) + " @,@ " + std::to_string(rng() % 1000) + " "; break;
+                    default: text += words[zipf(rng)] + " "; break;
+                }
+            }
+            text += ". ";
+        }
+        text += "\n";
+    }
+    return text;
+}
+
+#endif // SYNTHETIC_CORPUS_HPP
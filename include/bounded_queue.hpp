@@ -0,0 +1,91 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/*
+ * Blocking FIFO of at most `capacity` items for producer/consumer
+ * pipelines: a full queue stalls its producers, so a fast stage cannot run
+ * ahead of a slow one and memory stays bounded. close() ends the stream;
+ * consumers still drain what was queued before it.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * Append `item`, waiting while the queue is full
+     * Returns false, dropping the item, if the queue is closed
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mu);
+        not_full.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * Take the oldest item, waiting while the queue is empty
+     * Returns false once the queue is closed and empty
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mu);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    /**
+     * Like pop(), but give up at `deadline`
+     * Returns false on timeout, or once the queue is closed and empty
+     */
+    template <typename Clock, typename Duration>
+    bool pop_until(T& item, const std::chrono::time_point<Clock, Duration>& deadline) {
+        std::unique_lock<std::mutex> lock(mu);
+        if (!not_empty.wait_until(lock, deadline, [&] { return closed || !items.empty(); })) return false;
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    /**
+     * Refuse further pushes and wake every waiting thread
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mu);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mu);
+        return items.size();
+    }
+
+private:
+    const size_t capacity;
+    mutable std::mutex mu;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+#endif // BOUNDED_QUEUE_HPP
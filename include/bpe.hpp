@@ -1,27 +1,295 @@
 #ifndef BPE_HPP
 #define BPE_HPP
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <utility>
 
-// Count frequencies of adjacent token pairs in the training data
-void count_freqs();
+#include "model_image.hpp"
+#include "pretokenizer.hpp"
+#include "special_tokens.hpp"
+#include "thread_pool.hpp"
+#include "train_metrics.hpp"
+#include "word_cache.hpp"
 
-// Apply a merge operation to a token vector
-void apply_merge_to(std::vector<std::string>& tokens, 
-                    const std::pair<std::string, std::string>& merge, 
-                    bool training);
+// default tokens.
+inline const std::string EOW = "</w>";
+inline const std::string EOS = "<|endoftext|>";
 
-// Train BPE on the given raw data file, building a vocabulary of the specified size
+// Byte range [begin, end) of the input covered by one token. The end-of-word
+// marker covers no input bytes.
+struct TokenSpan {
+    uint32_t begin;
+    uint32_t end;
+
+    bool operator==(const TokenSpan&) const = default;
+};
+
+// Which registered special tokens one encode call turns into their ids
+struct SpecialTokenPolicy {
+    enum class Mode {
+        All,     // every registered special token
+        None,    // none: they are encoded as ordinary text
+        Listed   // only the ids in `allowed`
+    };
+    Mode mode = Mode::All;
+    std::vector<uint32_t> allowed{};
+
+    // Throw std::runtime_error on a registered special token that is not
+    // allowed instead of encoding it as text, e.g. for untrusted input that
+    // must not smuggle control markers into a prompt
+    bool reject_disallowed = false;
+};
+
+enum class ModelFormat {
+    Text,    // human-readable VOCAB/MERGES listing
+    Binary   // versioned flat image, mmapped by load_model()
+};
+
+/*
+ * A trained BPE model. Immutable once constructed: every encode method is
+ * const and safe to call from any number of threads at once without locking.
+ * Bytes that are not in the vocab map to ids past vocab_size() and are
+ * emitted as themselves; they never change the model.
+ *
+ * Special tokens are matched in the text before it is pre-tokenized and
+ * each becomes a single id; text on either side of one is encoded as if the
+ * token were a word boundary. EOS is registered by default.
+ *
+ * The optional per-word encode cache is the only shared mutable state. It is
+ * off unless a budget is set and is internally synchronized.
+ */
+class Tokenizer {
+public:
+    Tokenizer();
+    explicit Tokenizer(ModelImage model);
+    ~Tokenizer();
+
+    Tokenizer(Tokenizer&&) noexcept;
+    Tokenizer& operator=(Tokenizer&&) noexcept;
+
+    // Load a model file (text or binary, detected from the file)
+    static Tokenizer load(const std::string& model_file);
+
+    void save(const std::string& output_file, ModelFormat format = ModelFormat::Text) const;
+
+    // Encode text to token ids. Performs no string allocation
+    std::vector<uint32_t> encode(std::string_view text, const SpecialTokenPolicy& special = {}) const;
+
+    // Append the ids of `text` to `ids` and, if given, each token's byte span to `offsets`
+    void encode(std::string_view text, std::vector<uint32_t>& ids,
+                std::vector<TokenSpan>* offsets = nullptr, const SpecialTokenPolicy& special = {}) const;
+
+    // Write ids (and spans, if `offsets` is non-empty) into caller buffers. Returns the
+    // number of tokens in `text`; if that exceeds ids.size() only the first ids.size() are written
+    size_t encode(std::string_view text, std::span<uint32_t> ids,
+                  std::span<TokenSpan> offsets = {}, const SpecialTokenPolicy& special = {}) const;
+
+    // Tokenize text using the learned BPE merges
+    std::vector<std::string> tokenize(std::string_view text, const SpecialTokenPolicy& special = {}) const;
+
+    // Length of the longest prefix of `text` that encodes the same on its own
+    // as when more text follows: it ends after whitespace or at either end of
+    // a special token, never inside one. 0 if there is no such prefix yet.
+    // Encoding a stream prefix by prefix this way gives the same ids as
+    // encoding it whole
+    size_t safe_prefix(std::string_view text, const SpecialTokenPolicy& special = {}) const;
+
+    // Register special tokens and return their ids. A token already in the
+    // vocab keeps its id; any other is added past the raw byte ids, from
+    // vocab_size() + 256 on. Registering a token twice is a no-op. Not
+    // thread-safe: register before sharing the tokenizer
+    std::vector<uint32_t> add_special_tokens(const std::vector<std::string>& tokens);
+
+    // Id of a registered special token, or -1
+    int special_token_id(std::string_view token) const;
+
+    // Registered special tokens, in registration order
+    const std::vector<std::string>& special_tokens() const { return specials; }
+
+    // Turn ids back into text: every end-of-word marker becomes a space, except
+    // after the last word. Throws std::out_of_range on ids outside the model
+    std::string decode(std::span<const uint32_t> ids) const;
+
+    // Append the text of `ids` to `out`, keeping the space after the last word.
+    // Decoding a sequence chunk by chunk this way gives the same bytes as
+    // decoding it in one go, so it suits streaming generated tokens
+    void decode_append(std::span<const uint32_t> ids, std::string& out) const;
+
+    std::vector<std::string> decode_batch(std::span<const std::vector<uint32_t>> docs) const;
+
+    // Encode many documents in parallel; results are in input order.
+    // Documents are handed out in chunks of `chunk_size` and balanced by work stealing
+    std::vector<std::vector<uint32_t>> encode_batch(std::span<const std::string_view> docs,
+                                                    ThreadPool& pool, size_t chunk_size = 16) const;
+
+    // Same, on a pool of `num_threads` created for this call (0 = one per core)
+    std::vector<std::vector<uint32_t>> encode_batch(std::span<const std::string_view> docs,
+                                                    size_t num_threads = 0, size_t chunk_size = 16) const;
+
+    // Set the byte budget of the per-word encode cache; 0 disables it
+    void set_cache_budget(size_t bytes) const;
+    WordCacheStats cache_stats() const;
+
+    const ModelImage& model() const { return image; }
+    int vocab_size() const { return image.vocab_size(); }
+
+private:
+    ModelImage image;
+    int eow_id = -1;
+    std::unique_ptr<WordCache> cache;
+
+    std::vector<std::string> specials;
+    std::vector<uint32_t> special_ids;        // parallel to specials
+    std::vector<std::string> added_tokens;    // special tokens outside the vocab, by id - vocab_size() - 256
+    SpecialTokenMatcher matcher;              // over specials
+
+    void encode_word(std::string_view word, bool ends_word, std::vector<int>& ids) const;
+
+    // Encode text holding no special tokens; spans are relative to `origin`
+    void encode_text(std::string_view text, const char* origin, std::vector<uint32_t>& ids,
+                     std::vector<TokenSpan>* offsets) const;
+};
+
+// How the trainer finds the most frequent pair
+enum class MergeQueue {
+    Indexed,  // IndexedHeap: every count change re-sifts the pair
+    Lazy      // max-heap of (count, pair) snapshots, stale ones requeued on pop
+};
+
+// Set fields with designated initializers, e.g. TrainOptions{.log = nullptr}.
+// Every member has an initializer, so omitted ones do not trip
+// -Wmissing-field-initializers.
+struct TrainOptions {
+    // Count each distinct word once and weight its pairs by its frequency.
+    // Gives the same merges as one pass per occurrence, in far less time and memory
+    bool dedup_words = true;
+
+    // Threads for counting words and initial pairs (0 = one per core).
+    // The result does not depend on the thread count
+    size_t num_threads = 0;
+
+    MergeQueue queue = MergeQueue::Indexed;
+
+    // Byte-level vocabulary: all 256 bytes get a token (ids 2..257, in byte
+    // order) whether or not they occur in the corpus, so no input ever falls
+    // outside the vocab
+    bool byte_level = false;
+
+    // How words are cut before merging. Saved with the model, so encoding
+    // cuts text the same way
+    PreTokenizer pretokenizer = PreTokenizer::Whitespace;
+
+    // Give bytes after the first of each word their own tokens, spelled with
+    // this prefix ("##" for WordPiece), so word-initial and continuation
+    // pieces are learned apart. train_wordpiece() sets it; the BPE encoder
+    // does not understand such models
+    std::string continuation_prefix{};
+
+    // Where the trainer reports what it is doing: the corpus summary, a
+    // progress line every progress_interval merges and the phase profile.
+    // nullptr trains silently
+    std::ostream* log = &std::cout;
+
+    // Called every progress_interval merges and once more when training stops
+    std::function<void(const TrainProgress&)> on_progress{};
+    size_t progress_interval = 1000;
+
+    // Time every merge and record the merge latency and work histograms and
+    // the queue size samples in Trainer::metrics(). Off, the merge loop
+    // reads no clock and records nothing per merge
+    bool collect_metrics = false;
+
+    // Write the full trainer state to checkpoint_path every
+    // checkpoint_interval merges (0 = only when training stops). The file is
+    // replaced atomically, so it always holds a complete checkpoint
+    std::string checkpoint_path{};
+    size_t checkpoint_interval = 0;
+
+    // Continue from a checkpoint instead of reading the corpus: the raw data
+    // argument of train() is ignored and merging carries on from where the
+    // checkpoint left off, up to the new vocab size. The result is the same
+    // model an uninterrupted run would give. byte_level, pretokenizer and
+    // continuation_prefix must match the checkpointed run
+    std::string resume_from{};
+};
+
+/*
+ * Learns BPE merges from a corpus. All training state lives in the Trainer,
+ * so independent trainers can run side by side.
+ */
+class Trainer {
+public:
+    Trainer();
+    ~Trainer();
+
+    Trainer(const Trainer&) = delete;
+    Trainer& operator=(const Trainer&) = delete;
+
+    // Train BPE on the given raw data file, building a vocabulary of the specified size.
+    // Pairs of equal frequency are merged in order of their token ids, smallest first
+    Tokenizer train(const std::string& raw_data, size_t vocab_size, const TrainOptions& options = {});
+
+    // Learn merges on top of an existing model until the vocab reaches
+    // vocab_size. The model's merges are replayed on the training data with
+    // its encoder and merging continues from there, giving the same model as
+    // a fresh train() to vocab_size on the same data. The model must come
+    // from this trainer; its byte_level and pretokenizer settings are kept
+    Tokenizer train_continue(const Tokenizer& model, const std::string& raw_data, size_t vocab_size,
+                             const TrainOptions& options = {});
+
+    // Timings and counters of the last train() call
+    const TrainMetrics& metrics() const { return last_metrics; }
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+    TrainMetrics last_metrics;
+
+    Tokenizer run(const std::string& raw_data, size_t vocab_size, const TrainOptions& options,
+                  const Tokenizer* base);
+};
+
+// Convenience API over a process-wide default model. train() and load_model()
+// replace the default; encoding threads already holding the previous model
+// keep using it.
+
+// Train BPE on the given raw data file, save it to bpe_model.txt and make it the default model
 void train(const std::string& raw_data, size_t vocab_size);
 
-// Load a previously trained BPE model from file
-void load_model(const std::string& model_file);
+// Grow the model in `model_file` to vocab_size merges learned on raw_data, save it
+// to bpe_model.txt and make it the default model
+void train_continue(const std::string& model_file, const std::string& raw_data, size_t vocab_size);
+
+// Save the default model. Binary files load with a single mmap and no parsing
+void save_model(const std::string& output_file, ModelFormat format = ModelFormat::Text);
 
-// Tokenize text using the learned BPE merges
+// Load a previously trained BPE model from file and make it the default model
+std::shared_ptr<const Tokenizer> load_model(const std::string& model_file);
+
+// The current default model (empty before the first train()/load_model())
+std::shared_ptr<const Tokenizer> default_tokenizer();
+
+// Tokenize text using the default model
 std::vector<std::string> tokenize(const std::string& text);
 
-#endif
\ No newline at end of file
+// Encode text to token ids using the default model
+std::vector<uint32_t> encode(const std::string& text);
+
+// Decode token ids using the default model
+std::string decode(const std::vector<uint32_t>& ids);
+
+// Set the byte budget of the default model's per-word encode cache; 0 disables it
+void set_encode_cache_budget(size_t bytes);
+
+// Hit/miss/eviction counters of the default model's encode cache
+WordCacheStats encode_cache_stats();
+
+#endif
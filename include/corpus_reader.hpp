@@ -0,0 +1,76 @@
+#ifndef CORPUS_READER_HPP
+#define CORPUS_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pretokenizer.hpp"
+
+/*
+ * Streams whitespace-separated words (or finer pre-tokenizer pieces) out of
+ * a corpus file of any size.
+ *
+ * The file is read with plain read(2) calls into one reusable block, so
+ * memory stays at about one block no matter how large the corpus is. A word
+ * cut by the end of a block is carried over to the front of the next one.
+ * Whitespace is the C locale set (space, \t, \n, \v, \f, \r), the same words
+ * `std::istream >> std::string` would produce; see pretokenizer.hpp.
+ */
+class CorpusReader {
+public:
+    static constexpr size_t kDefaultBlockSize = 4u << 20;
+
+    /**
+     * Open `path` for reading. Throws std::runtime_error if it cannot be opened
+     */
+    explicit CorpusReader(const std::string& path, size_t block_size = kDefaultBlockSize,
+                          PreTokenizer mode = PreTokenizer::Whitespace);
+    ~CorpusReader();
+
+    CorpusReader(const CorpusReader&) = delete;
+    CorpusReader& operator=(const CorpusReader&) = delete;
+
+    /**
+     * Replace `words` with the words (pieces) of the next block
+     * The views stay valid until the next call. Returns false at end of file
+     */
+    bool next(std::vector<std::string_view>& words);
+
+    /**
+     * Replace `chunk` with the next block of raw bytes, cut after its last
+     * whitespace byte so no word is split between chunks. Lets the caller
+     * split and process chunks on other threads. Returns false at end of file
+     */
+    bool next_chunk(std::vector<char>& chunk);
+
+    /**
+     * Size of the file when opened, or 0 if it is not a regular file
+     */
+    uint64_t file_size() const { return size; }
+
+    uint64_t bytes_read() const { return consumed; }
+
+private:
+    int fd = -1;
+    uint64_t size = 0;
+    uint64_t consumed = 0;
+    size_t block_size;
+    PreTokenizer mode;
+    std::vector<char> buffer;
+    size_t pending = 0;  // offset of the unfinished word at the end of the last block
+    size_t carry = 0;    // its length
+    bool at_eof = false;
+
+    // Read the next block behind the carried-over bytes; returns bytes in buffer
+    size_t fill();
+};
+
+/**
+ * Peak resident set size of this process in bytes
+ */
+size_t peak_rss_bytes();
+
+#endif // CORPUS_READER_HPP
@@ -1,25 +1,46 @@
 #ifndef INDEXED_HEAP_HPP
 #define INDEXED_HEAP_HPP
 
+#include <cstddef>
+#include <memory>
+#include <utility>
 #include <vector>
-#include <unordered_map>
 
 struct HeapNode {
-    std::pair<int, int> tok_ids;      
+    std::pair<int, int> tok_ids;
     int priority;
-    
+    int heap_index = -1;  // position in the heap holding the node, -1 if none
+
     HeapNode() : tok_ids(-1, -1), priority(0) {}
     HeapNode(int t, int p) : tok_ids(-1, -1), priority(p) {}
 };
 
-class IndexedHeap {
+/*
+ * Max heap of HeapNode pointers with `Arity` children per slot. Each node
+ * stores its own position, so updates and removals need no lookup table,
+ * and sifting moves a hole instead of swapping. Nodes with equal priority
+ * are ordered by tok_ids, smallest first, so the top is the same whatever
+ * order the updates arrived in.
+ *
+ * A node can be in at most one heap at a time.
+ */
+template <int Arity>
+class DaryIndexedHeap {
+    static_assert(Arity >= 2, "a heap needs at least two children per slot");
+
 private:
     std::vector<HeapNode*> heap;  // Heap stores pointers to nodes
-    std::unordered_map<HeapNode*, int> nodeToIndex;  // Track position of each node
 
-    void bubbleUp(int idx);
-    void bubbleDown(int idx);
-    void swapNodes(int i, int j);
+    void siftUp(size_t idx);
+    void siftDown(size_t idx);
+    void place(HeapNode* node, size_t idx) {
+        heap[idx] = node;
+        node->heap_index = static_cast<int>(idx);
+    }
+    static bool before(const HeapNode* a, const HeapNode* b) {
+        if (a->priority != b->priority) return a->priority > b->priority;
+        return a->tok_ids < b->tok_ids;
+    }
 
 public:
     /**
@@ -30,7 +51,7 @@ public:
 
     /**
      * Update the priority of a node already in the heap
-     * Call this after modifying the node's priority externally
+     * Does nothing if the node is not in the heap
      */
     void updatePriority(HeapNode* node, int newPriority);
 
@@ -47,12 +68,12 @@ public:
     /**
      * Check if heap is empty
      */
-    bool empty() const;
+    bool empty() const { return heap.empty(); }
 
     /**
      * Get the current size of the heap
      */
-    size_t size() const;
+    size_t size() const { return heap.size(); }
 
     /**
      * Remove a specific node from the heap
@@ -65,4 +86,36 @@ public:
     void clear();
 };
 
+extern template class DaryIndexedHeap<2>;
+extern template class DaryIndexedHeap<4>;
+
+using IndexedHeap = DaryIndexedHeap<4>;
+
+/*
+ * Stable storage for HeapNodes: nodes are handed out from fixed-size
+ * contiguous blocks and never move, so neighbouring pairs created together
+ * share cache lines.
+ */
+class HeapNodePool {
+public:
+    static constexpr size_t kBlockSize = 4096;
+
+    HeapNode* make(std::pair<int, int> tok_ids, int priority) {
+        if (used == kBlockSize || blocks.empty()) {
+            blocks.push_back(std::make_unique<HeapNode[]>(kBlockSize));
+            used = 0;
+        }
+        HeapNode* node = &blocks.back()[used++];
+        node->tok_ids = tok_ids;
+        node->priority = priority;
+        return node;
+    }
+
+    size_t size() const { return blocks.empty() ? 0 : (blocks.size() - 1) * kBlockSize + used; }
+
+private:
+    std::vector<std::unique_ptr<HeapNode[]>> blocks;
+    size_t used = 0;
+};
+
 #endif // INDEXED_HEAP_HPP
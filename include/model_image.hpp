@@ -0,0 +1,148 @@
+#ifndef MODEL_IMAGE_HPP
+#define MODEL_IMAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "pretokenizer.hpp"
+
+/*
+ * Flat, read-only representation of a trained BPE model.
+ *
+ * The same byte layout is used in memory and on disk, so a binary model file
+ * is simply mmapped and every lookup is served straight from the mapping:
+ *
+ *   header | offsets | string blob | merges | pair table | token table | byte ids
+ *
+ * - offsets[id]..offsets[id + 1] is the token's span in the string blob
+ *   (empty for ids that are not in the vocab)
+ * - merges[rank] holds the pair, the id it merges into (-1 if the merged
+ *   string is not in the vocab) and the next rank with the same pair
+ * - the pair table is an open-addressing hash of pair -> first live rank
+ * - the token table is an open-addressing hash of token string -> id
+ * - byte ids maps each single-byte token straight to its id
+ *
+ * Files are little-endian and carry a format version and a checksum of
+ * everything after the header.
+ */
+class ModelImage {
+public:
+    static constexpr uint32_t kVersion = 1;
+
+    struct Merge {
+        int32_t left;
+        int32_t right;
+        int32_t merged;
+        int32_t next_rank;
+    };
+
+    ModelImage() = default;
+    ~ModelImage();
+
+    ModelImage(ModelImage&& other) noexcept;
+    ModelImage& operator=(ModelImage&& other) noexcept;
+    ModelImage(const ModelImage&) = delete;
+    ModelImage& operator=(const ModelImage&) = delete;
+
+    /**
+     * Build an image from tokens indexed by id and merges in learned order
+     * When a string appears under several ids, lookups return the largest id
+     */
+    static ModelImage build(const std::vector<std::string>& tokens,
+                            const std::vector<std::pair<int, int>>& merges,
+                            PreTokenizer pretokenizer = PreTokenizer::Whitespace);
+
+    /**
+     * Parse the text format written by write_text()
+     */
+    static ModelImage load_text(const std::string& path);
+
+    /**
+     * Map a binary model file. The header, section bounds and every stored
+     * id are always checked, so lookups never leave the mapping; the
+     * checksum is checked too unless `verify_checksum` is false.
+     * Throws std::runtime_error if malformed
+     */
+    static ModelImage map_file(const std::string& path, bool verify_checksum = true);
+
+    /**
+     * True if the file starts with the binary model magic
+     */
+    static bool is_binary_file(const std::string& path);
+
+    /**
+     * Text format: VOCAB_SIZE, then `token<TAB>id` lines, then `left right`
+     * merge lines. 256 single-byte tokens at consecutive ids in byte order
+     * are written as one `BYTES <first id>` line, and a CharClass model
+     * starts its vocab with a `PRETOKENIZER char_class` line
+     */
+    void write_text(const std::string& path) const;
+    void write_binary(const std::string& path) const;
+
+    bool empty() const { return header == nullptr; }
+    int vocab_size() const;
+    size_t num_merges() const;
+
+    /**
+     * How text is cut into words before merging, as in training
+     */
+    PreTokenizer pretokenizer() const;
+
+    /**
+     * Token string for `id`; empty if the id is not in the vocab
+     */
+    std::string_view token(int id) const;
+
+    /**
+     * Id of `token`, or -1
+     */
+    int token_id(std::string_view token) const;
+
+    /**
+     * Id of the single-byte token `b`, or -1
+     */
+    int byte_id(unsigned char b) const { return byte_ids[b]; }
+
+    const Merge& merge(size_t rank) const { return merges[rank]; }
+
+    /**
+     * Rank of the first live merge of (left, right), or -1
+     */
+    int find_pair(int left, int right) const;
+
+    /**
+     * Size in bytes of the image (and of its binary file)
+     */
+    size_t size_bytes() const { return size; }
+
+private:
+    struct Header;
+    struct PairSlot {
+        int32_t left;
+        int32_t right;
+        int32_t rank;
+    };
+
+    // Either `owned` holds the bytes or they are an mmapped file.
+    std::vector<uint64_t> owned;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+
+    const Header* header = nullptr;
+    const uint32_t* offsets = nullptr;
+    const char* blob = nullptr;
+    const Merge* merges = nullptr;
+    const PairSlot* pair_table = nullptr;
+    const int32_t* token_table = nullptr;
+    const int32_t* byte_ids = nullptr;
+
+    void bind(const uint8_t* bytes, size_t n_bytes);
+    void release();
+};
+
+#endif // MODEL_IMAGE_HPP
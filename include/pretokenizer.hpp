@@ -0,0 +1,64 @@
+#ifndef PRETOKENIZER_HPP
+#define PRETOKENIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+ * Pre-tokenization: cutting text into the pieces BPE merges within.
+ *
+ * Bytes are classified 64 at a time (AVX2 when the CPU has it, else SSE2,
+ * else scalar) into bitmasks, and piece boundaries are the bits where the
+ * class changes, so the cost is a few vector compares per 64 bytes plus one
+ * step per piece. Pieces are views into the input; nothing is copied.
+ *
+ * Whitespace is the C locale set (space, \t, \n, \v, \f, \r) and is never
+ * part of a piece.
+ */
+enum class PreTokenizer : uint32_t {
+    // Maximal runs of non-whitespace bytes, what `std::istream >> word` gives
+    Whitespace = 0,
+
+    // Each whitespace-separated word is further cut where letters, digits and
+    // other bytes meet, like GPT-2's letter/number/punctuation split: "it's 42%"
+    // gives "it", "'", "s", "42", "%". Bytes >= 0x80 count as letters, so
+    // UTF-8 text stays in one piece
+    CharClass = 1,
+};
+
+inline bool is_space_byte(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * True if `piece`, a view into `text`, is the last piece of its word
+ */
+inline bool ends_word(std::string_view piece, std::string_view text) {
+    const char* end = piece.data() + piece.size();
+    return end == text.data() + text.size() || is_space_byte(*end);
+}
+
+/**
+ * Append the pieces of `text` to `pieces`
+ */
+void pretokenize(std::string_view text, PreTokenizer mode, std::vector<std::string_view>& pieces);
+
+/**
+ * Append the whitespace-separated words of `text` to `words`
+ */
+inline void split_words(std::string_view text, std::vector<std::string_view>& words) {
+    pretokenize(text, PreTokenizer::Whitespace, words);
+}
+
+/**
+ * Block splitter behind CorpusReader. Appends the pieces of p[0, n); unless
+ * `at_end`, the last word may continue past n, so its pieces are left out.
+ * If begin > 0, p[0, begin) is the start of a word already scanned (the
+ * CharClass mode rescans it). Returns where the left-out word starts, or n
+ */
+size_t pretokenize_block(const char* p, size_t begin, size_t n, PreTokenizer mode, bool at_end,
+                         std::vector<std::string_view>& pieces);
+
+#endif // PRETOKENIZER_HPP
@@ -0,0 +1,59 @@
+#ifndef SPECIAL_TOKENS_HPP
+#define SPECIAL_TOKENS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Aho-Corasick automaton over a fixed set of byte strings, used to find
+ * special tokens ("<|endoftext|>", chat markers, ...) in text before it is
+ * pre-tokenized. Transitions are a dense table, so scanning costs one
+ * lookup per byte, and bytes that start no pattern are skipped without
+ * entering the automaton at all.
+ *
+ * Matches are leftmost-longest and never overlap: of the patterns occurring
+ * in the text the one starting first wins, and of those starting at the
+ * same byte the longest.
+ */
+class SpecialTokenMatcher {
+public:
+    struct Match {
+        size_t begin;
+        size_t end;
+        uint32_t pattern;  // index into the pattern list; a repeated pattern matches as its first copy
+    };
+
+    SpecialTokenMatcher() = default;
+
+    // Throws std::runtime_error on an empty pattern
+    explicit SpecialTokenMatcher(const std::vector<std::string>& patterns);
+
+    /**
+     * Find the first match in text[from, end)
+     * Returns false if there is none
+     */
+    bool find(std::string_view text, size_t from, Match& match) const;
+
+    size_t size() const { return lengths.size(); }
+    bool empty() const { return lengths.empty(); }
+
+    /**
+     * Length of the longest suffix of `text` that some pattern starts with
+     * A match that could continue past the end of `text` starts within it
+     */
+    size_t open_suffix(std::string_view text) const;
+
+private:
+    std::vector<int32_t> delta;     // state * 256 + byte -> next state
+    std::vector<int32_t> longest;   // per state: longest pattern that is a suffix of it, or -1
+    std::vector<uint32_t> depth;    // per state: length of the string it spells
+    std::vector<uint32_t> lengths;  // per pattern
+    bool starts[256] = {};          // bytes some pattern starts with
+    int only_start = -1;            // the one such byte, if all patterns share it
+    size_t max_len = 0;
+};
+
+#endif // SPECIAL_TOKENS_HPP
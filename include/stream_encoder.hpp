@@ -0,0 +1,103 @@
+#ifndef STREAM_ENCODER_HPP
+#define STREAM_ENCODER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bpe.hpp"
+
+/*
+ * Encodes a text stream of any length with a Tokenizer, handing ids to a
+ * sink as soon as the text they cover can no longer change. Input arrives in
+ * chunks of any size, cut anywhere; only the bytes after the last safe cut
+ * (Tokenizer::safe_prefix: after whitespace, or at a special token) are held
+ * back, and text is encoded at most block_size bytes at a time. Memory stays
+ * at about one block plus the longest word, whatever the stream's length.
+ *
+ * The ids are exactly those of Tokenizer::encode on the whole stream, unless
+ * a run of more than max_pending bytes has no safe cut (a very long word, or
+ * binary data): that run is encoded in pieces of about max_pending bytes,
+ * cut at a UTF-8 character boundary, so memory stays bounded.
+ */
+class StreamEncoder {
+public:
+    static constexpr size_t kDefaultBlockSize = 64u << 10;
+    static constexpr size_t kDefaultMaxPending = 1u << 20;
+
+    // Receives the next ids of the stream, in order. The span is only valid during the call
+    using Sink = std::function<void(std::span<const uint32_t> ids)>;
+
+    // The tokenizer must outlive the encoder, and keep its special tokens
+    // while the encoder is in use. max_pending is raised to block_size if smaller
+    StreamEncoder(const Tokenizer& tokenizer, Sink sink, SpecialTokenPolicy special = {},
+                  size_t block_size = kDefaultBlockSize, size_t max_pending = kDefaultMaxPending);
+
+    /**
+     * Feed the next bytes of the stream
+     * Ids of every complete word among them reach the sink before this returns
+     */
+    void write(std::string_view chunk);
+
+    /**
+     * End the stream: encode what is held back
+     * The encoder can then start on a new stream
+     */
+    void finish();
+
+    uint64_t bytes_written() const { return bytes_in; }
+    uint64_t tokens_emitted() const { return tokens_out; }
+
+    // Bytes held back waiting for the rest of their word
+    size_t buffered() const { return pending.size(); }
+
+private:
+    const Tokenizer& tokenizer;
+    Sink sink;
+    SpecialTokenPolicy special;
+    size_t block_size;
+    size_t max_pending;
+    std::string pending;
+    size_t scanned = 0;  // leading bytes of pending already found to hold no safe cut
+    size_t reach = 0;    // longest special token that can move a cut, 0 if none
+    std::array<bool, 256> special_start{};  // first bytes of those tokens
+    std::vector<uint32_t> ids;
+    uint64_t bytes_in = 0;
+    uint64_t tokens_out = 0;
+
+    // Encode and emit the safe part of `text`; returns how many bytes that was
+    size_t drain(std::string_view text, bool at_end);
+
+    // False if the bytes added to pending since the last scan cannot create a safe cut
+    bool may_cut() const;
+
+    // Encode and emit pending, all but its last few bytes, even though it has no safe cut
+    void force_cut();
+};
+
+// Encode a whole stream through `sink` and return the number of ids. The
+// input is read block_size bytes at a time, so memory does not grow with it.
+
+// From an istream
+uint64_t encode_stream(const Tokenizer& tokenizer, std::istream& in, const StreamEncoder::Sink& sink,
+                       const SpecialTokenPolicy& special = {},
+                       size_t block_size = StreamEncoder::kDefaultBlockSize);
+
+// From a file descriptor, read to end of file. Throws std::runtime_error on read errors
+uint64_t encode_stream(const Tokenizer& tokenizer, int fd, const StreamEncoder::Sink& sink,
+                       const SpecialTokenPolicy& special = {},
+                       size_t block_size = StreamEncoder::kDefaultBlockSize);
+
+// From a callback that fills up to `capacity` bytes at `buffer` and returns
+// how many it wrote, 0 at the end of the stream
+uint64_t encode_stream(const Tokenizer& tokenizer, const std::function<size_t(char* buffer, size_t capacity)>& read,
+                       const StreamEncoder::Sink& sink, const SpecialTokenPolicy& special = {},
+                       size_t block_size = StreamEncoder::kDefaultBlockSize);
+
+#endif // STREAM_ENCODER_HPP
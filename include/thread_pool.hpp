@@ -0,0 +1,65 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing thread pool for data-parallel loops.
+ * Each worker owns a deque of chunks: it pops its own from the back and,
+ * when that runs dry, steals from the front of the others. parallel_for()
+ * can be called from several threads at once; each call blocks until its
+ * own chunks are done.
+ */
+class ThreadPool {
+public:
+    /**
+     * Start `num_threads` workers (0 = std::thread::hardware_concurrency())
+     */
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Call fn(begin, end) over [0, n) in chunks of at most `grain` items and
+     * wait for all of them. The first exception thrown by fn is rethrown here
+     */
+    void parallel_for(size_t n, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+    size_t size() const { return workers.size(); }
+
+private:
+    struct Job;
+    struct Task {
+        Job* job;
+        size_t begin;
+        size_t end;
+    };
+    struct Queue {
+        std::mutex mu;
+        std::vector<Task> tasks;  // owner takes from the back, thieves from the front
+        size_t head = 0;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<size_t> queued{0};
+    std::mutex sleep_mu;
+    std::condition_variable sleep_cv;
+    bool stopping = false;
+
+    void worker_loop(size_t self);
+    bool pop_local(size_t self, Task& task);
+    bool steal(size_t self, Task& task);
+    void run(const Task& task);
+};
+
+#endif // THREAD_POOL_HPP
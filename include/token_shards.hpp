@@ -0,0 +1,110 @@
+#ifndef TOKEN_SHARDS_HPP
+#define TOKEN_SHARDS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+// Bytes per token in a shard
+enum class TokenWidth : uint32_t {
+    U16 = 2,
+    U32 = 4
+};
+
+/*
+ * Writes token ids as packed shards for training data loaders. Shard k is
+ * two files:
+ *
+ *   <dir>/<prefix>_0000k.bin  the ids of whole documents back to back, as
+ *                             little-endian uint16 or uint32, nothing else
+ *   <dir>/<prefix>_0000k.idx  header, then the token offset at which each
+ *                             document starts, and the shard's token count
+ *
+ * The .bin can be mmapped as a flat array (numpy.memmap, torch.from_file).
+ * A shard is closed at the first document end at or past shard_tokens
+ * tokens, so no document is split between shards.
+ */
+class TokenShardWriter {
+public:
+    // Header of an .idx file, followed by num_docs + 1 uint64 offsets
+    struct IndexHeader {
+        char magic[8];         // "TOKIDX1\0"
+        uint32_t version;
+        uint32_t token_bytes;  // 2 or 4
+        uint64_t num_docs;
+        uint64_t num_tokens;
+    };
+
+    static constexpr uint32_t kVersion = 1;
+
+    /**
+     * Create `dir` if needed. Nothing is written until the first token
+     */
+    TokenShardWriter(const std::string& dir, TokenWidth width, uint64_t shard_tokens,
+                     std::string prefix = "shard");
+    ~TokenShardWriter();
+
+    TokenShardWriter(const TokenShardWriter&) = delete;
+    TokenShardWriter& operator=(const TokenShardWriter&) = delete;
+
+    /**
+     * Append ids to the current document, starting one if needed
+     * Throws std::runtime_error on an id that does not fit the token width
+     */
+    void write(std::span<const uint32_t> ids);
+
+    /**
+     * End the current document; an empty one is recorded as such
+     */
+    void end_document();
+
+    /**
+     * End any unfinished document and write out the last shard
+     */
+    void finish();
+
+    uint64_t tokens() const { return total_tokens; }
+    uint64_t documents() const { return total_docs; }
+    size_t shards() const { return shard_count; }
+
+    // Path of shard `index` without the .bin/.idx extension
+    std::string shard_path(size_t index) const;
+
+private:
+    std::string dir;
+    std::string prefix;
+    TokenWidth width;
+    uint64_t shard_tokens;
+    std::ofstream bin;
+    std::vector<uint64_t> offsets;  // of the open shard's documents
+    uint64_t tokens_in_shard = 0;
+    bool in_document = false;
+    uint64_t total_tokens = 0;
+    uint64_t total_docs = 0;
+    size_t shard_count = 0;
+    std::vector<char> packed;
+
+    void open_shard();
+    void close_shard();
+    void begin_document();
+};
+
+// One shard read back into memory, for checks and tests
+struct TokenShard {
+    TokenWidth width = TokenWidth::U32;
+    std::vector<uint32_t> tokens;
+    std::vector<uint64_t> doc_offsets;  // document d is tokens[doc_offsets[d], doc_offsets[d + 1])
+
+    size_t num_docs() const { return doc_offsets.empty() ? 0 : doc_offsets.size() - 1; }
+
+    /**
+     * Read `path`.bin and `path`.idx
+     * Throws std::runtime_error if they are missing, corrupt or disagree
+     */
+    static TokenShard read(const std::string& path);
+};
+
+#endif // TOKEN_SHARDS_HPP
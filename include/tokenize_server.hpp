@@ -0,0 +1,155 @@
+#ifndef TOKENIZE_SERVER_HPP
+#define TOKENIZE_SERVER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bpe.hpp"
+
+/*
+ * Wire protocol, little-endian, over a Unix domain socket or localhost TCP.
+ * Every message is a frame: a uint32 length, then that many bytes, the first
+ * of which is the request op or the response status.
+ *
+ *   request   op (1 byte) | payload
+ *   response  status (1 byte) | payload, or the error message
+ *
+ * Encode: UTF-8 text in, uint32 ids out. Decode: uint32 ids in, text out.
+ * Stats: empty in, the server's ServerStats as JSON out. A client may send
+ * several requests before reading; responses come back in request order.
+ */
+namespace server_protocol {
+    enum class Op : uint8_t {
+        Encode = 1,
+        Decode = 2,
+        Stats = 3
+    };
+
+    enum class Status : uint8_t {
+        Ok = 0,
+        Error = 1
+    };
+
+    // Request frames above this size close the connection; a response that
+    // would exceed it is answered with Status::Error instead
+    constexpr uint32_t kMaxFrame = 64u << 20;
+}
+
+struct ServerOptions {
+    // Listen on this Unix socket path if set, else on 127.0.0.1:port
+    // (port 0 picks a free one; see TokenizeServer::port())
+    std::string unix_socket{};
+    uint16_t port = 0;
+
+    // Encoding threads (0 = one per core)
+    size_t threads = 0;
+
+    // Requests arriving within this long of the first one in a batch are
+    // encoded together; 0 dispatches whatever is queued at once
+    uint32_t batch_window_us = 200;
+    size_t max_batch = 64;
+
+    // Latency SLO mode: when non-zero, a batch is dispatched early enough
+    // that its oldest request, plus the recent average batch time, stays
+    // within this budget, even if the window has not closed
+    uint32_t slo_us = 0;
+};
+
+struct ServerStats {
+    uint64_t requests = 0;     // answered, errors included
+    uint64_t errors = 0;
+    uint64_t batches = 0;
+    uint64_t connections = 0;  // accepted so far
+    double uptime_seconds = 0;
+    double qps = 0;            // over the recent latency window
+    double p50_us = 0;         // request latency, arrival to response ready,
+    double p99_us = 0;         // over the most recent requests
+    double max_us = 0;
+
+    double mean_batch() const { return batches ? static_cast<double>(requests) / batches : 0.0; }
+    std::string to_json() const;
+};
+
+/*
+ * Serves encode/decode requests from one shared, read-only Tokenizer. Each
+ * connection has a reader thread that queues its requests; a batcher groups
+ * queued requests that arrive within the batch window and encodes them in
+ * parallel on a ThreadPool, then hands the responses, in order, to each
+ * connection's writer thread. A client that stops reading stalls only its
+ * own connection: once it has 256 requests unanswered, the server stops
+ * reading from it until it catches up.
+ */
+class TokenizeServer {
+public:
+    TokenizeServer(std::shared_ptr<const Tokenizer> tokenizer, ServerOptions options = {});
+    ~TokenizeServer();
+
+    TokenizeServer(const TokenizeServer&) = delete;
+    TokenizeServer& operator=(const TokenizeServer&) = delete;
+
+    /**
+     * Bind, listen and start serving in the background
+     * Throws std::runtime_error if the socket cannot be set up
+     */
+    void start();
+
+    /**
+     * Stop accepting, drop open connections and join every thread
+     */
+    void stop();
+
+    // The TCP port listened on, once started (0 for a Unix socket)
+    uint16_t port() const { return bound_port; }
+
+    ServerStats stats() const;
+
+private:
+    struct Connection;
+    struct Request;
+    struct State;
+
+    std::shared_ptr<const Tokenizer> tokenizer;
+    ServerOptions opts;
+    std::unique_ptr<State> state;
+    uint16_t bound_port = 0;
+
+    void accept_loop();
+    void reap_connections();  // join and drop connections whose threads have returned
+    void read_loop(std::shared_ptr<Connection> conn);
+    void write_loop(std::shared_ptr<Connection> conn);
+    void batch_loop();
+};
+
+/*
+ * Blocking client for the protocol above; one connection, not thread-safe.
+ */
+class TokenizeClient {
+public:
+    static TokenizeClient connect_unix(const std::string& path);
+    static TokenizeClient connect_tcp(uint16_t port);
+
+    ~TokenizeClient();
+    TokenizeClient(TokenizeClient&& other) noexcept;
+    TokenizeClient& operator=(TokenizeClient&& other) noexcept;
+
+    // Round trips. Throw std::runtime_error on a server error or a broken connection
+    std::vector<uint32_t> encode(std::string_view text);
+    std::string decode(std::span<const uint32_t> ids);
+    std::string stats_json();
+
+    // Pipelining: send any number of requests, then receive their responses
+    // in order. receive() returns the payload and throws on an error status
+    void send(server_protocol::Op op, std::string_view payload);
+    std::string receive();
+
+private:
+    explicit TokenizeClient(int fd) : fd(fd) {}
+    int fd = -1;
+};
+
+#endif // TOKENIZE_SERVER_HPP
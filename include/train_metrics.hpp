@@ -0,0 +1,113 @@
+#ifndef TRAIN_METRICS_HPP
+#define TRAIN_METRICS_HPP
+
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/*
+ * Histogram over power-of-two buckets: bucket 0 counts zeros and bucket i
+ * counts values in [2^(i-1), 2^i). Recording is a bit scan and an add, so
+ * it can sit in a hot loop; percentiles are bucket upper bounds.
+ */
+struct Histogram {
+    static constexpr int kBuckets = 65;
+
+    uint64_t buckets[kBuckets] = {};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    void record(uint64_t value) {
+        buckets[std::bit_width(value)]++;
+        count++;
+        sum += value;
+        if (value > max) max = value;
+    }
+
+    double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+
+    /**
+     * Smallest bucket bound at or above the p-th fraction of values (0 < p <= 1)
+     */
+    uint64_t percentile(double p) const;
+};
+
+/*
+ * Adds the wall time between construction and destruction to `*seconds`.
+ * With a null target it reads no clock at all.
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(double* seconds)
+        : target(seconds), start(seconds ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{}) {}
+
+    ~ScopedTimer() {
+        if (target) *target += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    double* target;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Passed to TrainOptions::on_progress every progress_interval merges and
+// once when training stops.
+struct TrainProgress {
+    size_t merges = 0;          // merges learned so far
+    size_t target_merges = 0;   // merges needed to reach the requested vocab size
+    int vocab_size = 0;
+    size_t queue_size = 0;      // pairs waiting in the merge queue
+    double elapsed_seconds = 0; // since training started
+    std::string last_token;     // token created by the latest merge
+    int last_count = 0;         // its pair's frequency when merged
+    bool done = false;
+};
+
+/*
+ * What one training run did and where its time went. Phase times and
+ * counts are always filled in; the per-merge histograms and the queue
+ * samples only with TrainOptions::collect_metrics.
+ */
+struct TrainMetrics {
+    // Phases, in seconds
+    double preprocess_seconds = 0;
+    double count_pairs_seconds = 0;
+    double merge_seconds = 0;
+    double checkpoint_seconds = 0;  // writing checkpoints and resuming from one
+    double total_seconds = 0;
+
+    uint64_t corpus_bytes = 0;
+    uint64_t corpus_words = 0;
+    uint64_t unique_words = 0;
+    uint64_t initial_pairs = 0;
+    size_t merges = 0;
+    size_t peak_rss_bytes = 0;
+
+    Histogram merge_ns;               // one merge: pop from the queue and apply
+    Histogram sites_per_merge;        // occurrence sites visited by a merge
+    Histogram count_updates_per_merge;  // pair count changes made by a merge
+
+    struct Sample {
+        size_t merge;
+        double elapsed_seconds;
+        size_t queue_size;
+    };
+    std::vector<Sample> queue_samples;  // one per progress_interval merges
+
+    // Human-readable summary, the old profile printout
+    void print(std::ostream& out) const;
+
+    // Everything above as one JSON object
+    std::string to_json() const;
+};
+
+#endif // TRAIN_METRICS_HPP
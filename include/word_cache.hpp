@@ -0,0 +1,73 @@
+#ifndef WORD_CACHE_HPP
+#define WORD_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct WordCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+/*
+ * Word -> token id cache sitting in front of the BPE merge loop.
+ * Memory is bounded by a byte budget (keys, ids and a fixed per-entry
+ * overhead). Eviction is CLOCK: a hit only sets a reference bit, and the
+ * hand gives every referenced entry a second chance before evicting it.
+ * The cache is split into independently locked shards so it can be shared
+ * between encoding threads.
+ */
+class WordCache {
+public:
+    static constexpr size_t kDefaultBudget = 8u << 20;
+
+    explicit WordCache(size_t budget_bytes = kDefaultBudget, size_t num_shards = 16);
+    ~WordCache();
+
+    WordCache(const WordCache&) = delete;
+    WordCache& operator=(const WordCache&) = delete;
+
+    /**
+     * Copy the cached ids for `word` into `ids`
+     * Returns false (and leaves `ids` untouched) on a miss
+     */
+    bool lookup(std::string_view word, std::vector<int>& ids);
+
+    /**
+     * Cache the ids for `word`, evicting entries as needed to stay in budget
+     * Entries larger than a shard's share of the budget are not cached
+     */
+    void insert(std::string_view word, const std::vector<int>& ids);
+
+    /**
+     * Change the byte budget. A budget of 0 disables the cache
+     */
+    void set_budget(size_t budget_bytes);
+
+    size_t budget() const;
+
+    /**
+     * Drop all entries. Counters are kept
+     */
+    void clear();
+
+    WordCacheStats stats() const;
+
+private:
+    struct Shard;
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<size_t> budget_bytes;
+
+    Shard& shard_for(std::string_view word);
+};
+
+#endif // WORD_CACHE_HPP
@@ -0,0 +1,120 @@
+#ifndef WORDPIECE_HPP
+#define WORDPIECE_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bpe.hpp"
+#include "pretokenizer.hpp"
+
+struct WordPieceOptions {
+    std::string unk_token = "[UNK]";
+
+    // Marks tokens that continue a word rather than start it
+    std::string continuation_prefix = "##";
+
+    // Longer words encode to a single unk token, as in BERT
+    size_t max_word_bytes = 100;
+
+    // How text is cut into words before matching
+    PreTokenizer pretokenizer = PreTokenizer::Whitespace;
+
+    // Put first in a trained vocab, in this order; unk_token must be one of them
+    std::vector<std::string> special_tokens = {"[PAD]", "[UNK]", "[CLS]", "[SEP]", "[MASK]"};
+};
+
+/*
+ * BERT-style WordPiece tokenizer. Each word is split greedily, longest match
+ * first: the longest vocab token the word starts with, then the longest
+ * continuation token ("##" + bytes) at each following position. A word that
+ * cannot be covered this way becomes the unk token.
+ *
+ * Matching is LinMaxMatch (Song et al., "Fast WordPiece Tokenization"): the
+ * vocab is held in a double-array trie whose nodes also carry a failure link
+ * and the tokens to emit when following it, so a word is matched in a single
+ * left-to-right pass with no backtracking. Immutable once built; every
+ * encode method is const and thread-safe.
+ */
+class WordPiece {
+public:
+    WordPiece() = default;
+
+    // Token ids are positions in `vocab`; a repeated token keeps its first id
+    explicit WordPiece(std::vector<std::string> vocab, WordPieceOptions options = {});
+
+    // Load a vocab.txt: one token per line, ids in line order
+    static WordPiece load(const std::string& vocab_file, WordPieceOptions options = {});
+
+    void save(const std::string& vocab_file) const;
+
+    std::vector<uint32_t> encode(std::string_view text) const;
+
+    // Append the ids of `text` to `ids`
+    void encode(std::string_view text, std::vector<uint32_t>& ids) const;
+
+    std::vector<std::string> tokenize(std::string_view text) const;
+
+    // Join tokens back into text: continuation tokens lose their prefix and
+    // attach to the previous token, other tokens start a new space-separated
+    // word. Throws std::out_of_range on ids outside the vocab
+    std::string decode(std::span<const uint32_t> ids) const;
+
+    int vocab_size() const { return static_cast<int>(vocab.size()); }
+    const std::string& token(int id) const { return vocab.at(id); }
+
+    // Id of a vocab token, or -1
+    int token_id(std::string_view token) const;
+
+    int unk_id() const { return unk; }
+    const WordPieceOptions& options() const { return opts; }
+
+private:
+    // Double-array trie cell: the children of state s live at base + byte,
+    // each with check == s
+    struct Cell {
+        int32_t base = 0;
+        int32_t check = -1;  // -1 while the cell is free
+    };
+
+    // Per state: the token it spells (-1 if none), its failure link (-1 if
+    // none) and the range of `pops` emitted when following the link
+    struct Link {
+        int32_t token = -1;
+        int32_t fail = -1;
+        uint32_t pops_begin = 0;
+        uint32_t pops_end = 0;
+    };
+
+    std::vector<std::string> vocab;
+    WordPieceOptions opts;
+    int unk = -1;
+    std::vector<Cell> cells;
+    std::vector<Link> links;
+    std::vector<int32_t> pops;
+    int32_t suffix_root = -1;  // the state spelling the continuation prefix
+
+    void build_trie();
+
+    int32_t next(int32_t state, unsigned char c) const {
+        uint32_t t = static_cast<uint32_t>(cells[state].base) + c;
+        return t < cells.size() && cells[t].check == state ? static_cast<int32_t>(t) : -1;
+    }
+
+    void encode_word(std::string_view word, std::vector<uint32_t>& ids) const;
+    void encode_word_probing(std::string_view word, std::vector<uint32_t>& ids) const;
+};
+
+/*
+ * Learn a WordPiece vocab of up to vocab_size tokens with the BPE trainer:
+ * bytes after the first of each word are counted as continuation tokens,
+ * merges are learned as usual, and the vocab is the special tokens followed
+ * by the trainer's tokens in id order. Bytes, not characters, are the base
+ * units, so rare multi-byte characters may end in continuation bytes.
+ */
+WordPiece train_wordpiece(const std::string& raw_data, size_t vocab_size,
+                          const TrainOptions& train_options = {}, WordPieceOptions options = {});
+
+#endif // WORDPIECE_HPP
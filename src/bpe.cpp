@@ -2,462 +2,519 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <list>
-#include <map>
 #include <algorithm>
-#include <fstream>
-#include <sstream>
-#include <ranges>
-#include <filesystem>
-#include <set>
-#include <unordered_set>
-#include <map>
+#include <functional>
 #include <memory>
-#include <chrono>
-#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <cstring>
 
 #include <bpe.hpp>
-#include <indexed_heap.hpp>
+#include <model_image.hpp>
+#include <word_cache.hpp>
 
-struct PairHash {
-    std::size_t operator()(const std::pair<int, int>& p) const {
-        auto h1 = std::hash<int>{}(p.first);
-        auto h2 = std::hash<int>{}(p.second);
-        return h1 ^ (h2 << 1);
+namespace {
+
+    // Scratch space reused across words by merge_word().
+    struct WordSymbol {
+        int tok;
+        int prev;
+        int next;
+    };
+
+    struct MergeCandidate {
+        int rank;
+        int pos;
+        int left;
+        int right;
+
+        bool operator>(const MergeCandidate& other) const {
+            if (rank != other.rank) return rank > other.rank;
+            return pos > other.pos;
+        }
+    };
+
+    struct MergeScratch {
+        std::vector<WordSymbol> symbols;
+        std::vector<MergeCandidate> queue;
+    };
+
+    // Smallest rank > floor at which (left, right) merges, or -1.
+    int lookup_rank(const ModelImage& model, int left, int right, int floor) {
+        int rank = model.find_pair(left, right);
+        while (rank != -1 && rank <= floor) {
+            rank = model.merge(rank).next_rank;
+        }
+        return rank;
     }
-};
 
-std::unordered_map<std::string, int> vocab_to_id; 
-std::unordered_map<int, std::string> id_to_vocab; 
-int vocab_size = 0; 
+    // Apply the learned merges to one word, lowest rank first and leftmost first
+    // within a rank. This reproduces applying `merges` one after another over the
+    // word, but each step only looks at the two pairs touching the merge site.
+    // Pairs formed after their rank has been passed are never merged, which is
+    // why each new pair looks up its next rank above the rank being applied.
+    void merge_word(const ModelImage& model, std::vector<int>& token_ids, MergeScratch& scratch) {
+        const int n = token_ids.size();
+        if (n < 2 || model.num_merges() == 0) return;
+
+        auto& symbols = scratch.symbols;
+        auto& queue = scratch.queue;
+        symbols.resize(n);
+        queue.clear();
+        for (int i = 0; i < n; ++i) {
+            symbols[i] = {token_ids[i], i - 1, i + 1 < n ? i + 1 : -1};
+        }
 
-std::unordered_map<std::pair<int, int>, std::list<int>, PairHash> occurrences; 
-std::vector<std::pair<int, int> > merges;
+        auto push_pair = [&](int pos, int floor) {
+            int left = symbols[pos].tok;
+            int right = symbols[symbols[pos].next].tok;
+            int rank = lookup_rank(model, left, right, floor);
+            if (rank == -1) return;
+            queue.push_back({rank, pos, left, right});
+            std::push_heap(queue.begin(), queue.end(), std::greater<>{});
+        };
+
+        for (int i = 0; i + 1 < n; ++i) {
+            push_pair(i, -1);
+        }
 
-IndexedHeap frequency_heap;
-std::unordered_map<std::pair<int, int>, std::unique_ptr<HeapNode>, PairHash> pair_frequencies; 
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<>{});
+            MergeCandidate cand = queue.back();
+            queue.pop_back();
 
-// default tokens. 
-const std::string EOW = "</w>";
-const std::string EOS = "<|endoftext|>";
+            // Skip stale candidates: either side has since been merged away.
+            WordSymbol& sym = symbols[cand.pos];
+            if (sym.tok != cand.left || sym.next == -1) continue;
+            WordSymbol& right = symbols[sym.next];
+            if (right.tok != cand.right) continue;
 
-namespace {
+            sym.tok = model.merge(cand.rank).merged;
+            sym.next = right.next;
+            right.tok = -1;
+            if (sym.next != -1) symbols[sym.next].prev = cand.pos;
 
-    // Profiling data
-    struct ProfileData {
-        std::chrono::duration<double> bump_priority_time{0};
-        std::chrono::duration<double> count_freqs_time{0};
-        std::chrono::duration<double> apply_merge_time{0};
-        std::chrono::duration<double> get_merge_time{0};
-        long long bump_priority_calls = 0;
-        long long apply_merge_calls = 0;
-    } profile_data;
-
-    void print_profile_stats() {
-        std::cout << "\n=== Performance Profile ===\n";
-        std::cout << std::fixed << std::setprecision(3);
-        std::cout << "count_freqs:    " << profile_data.count_freqs_time.count() << "s\n";
-        std::cout << "get_merge:      " << profile_data.get_merge_time.count() << "s\n";
-        std::cout << "apply_merge:    " << profile_data.apply_merge_time.count() << "s (" 
-                  << profile_data.apply_merge_calls << " calls)\n";
-        std::cout << "bump_priority:  " << profile_data.bump_priority_time.count() << "s (" 
-                  << profile_data.bump_priority_calls << " calls)\n";
-        std::cout << "===========================\n\n";
-    }
+            if (sym.prev != -1) push_pair(sym.prev, cand.rank);
+            if (sym.next != -1) push_pair(cand.pos, cand.rank);
+        }
 
-    void add_def_tokens() {
-        vocab_to_id[EOW] = vocab_size; 
-        id_to_vocab[vocab_size++] = EOW; 
-        vocab_to_id[EOS] = vocab_size; 
-        id_to_vocab[vocab_size++] = EOS; 
+        int out = 0;
+        for (int i = 0; i != -1; i = symbols[i].next) {
+            token_ids[out++] = symbols[i].tok;
+        }
+        token_ids.resize(out);
     }
 
-    // DLL within a fixed size vector. 
-    struct DLLNode {
-        int tok; 
-        int prev; 
-        int next; 
-        bool active; 
-    };
+    bool matches_special(const SpecialTokenMatcher& matcher, const SpecialTokenPolicy& special) {
+        return !matcher.empty() && (special.mode != SpecialTokenPolicy::Mode::None || special.reject_disallowed);
+    }
 
-    void bump_priority(const std::pair<int,int>& p, int delta) {
-        auto it = pair_frequencies.find(p);
-        if (it == pair_frequencies.end()) {
-            auto node_ptr = std::make_unique<HeapNode>();
-            node_ptr->tok_ids = p;
-            node_ptr->priority = 0;
-            frequency_heap.push(node_ptr.get()); // inserts into heap
-            auto insert_result = pair_frequencies.insert({p, std::move(node_ptr)});
-            it = insert_result.first;  // Use iterator from insert, not redundant find
+    bool allows(const SpecialTokenPolicy& special, uint32_t id) {
+        switch (special.mode) {
+            case SpecialTokenPolicy::Mode::All: return true;
+            case SpecialTokenPolicy::Mode::None: return false;
+            case SpecialTokenPolicy::Mode::Listed: break;
         }
-        HeapNode* node = it->second.get();
-        int newPri = node->priority + delta;
-        if (newPri < 0) newPri = 0;
-        frequency_heap.updatePriority(node, newPri);
+        return std::find(special.allowed.begin(), special.allowed.end(), id) != special.allowed.end();
     }
 
+    // The model behind the free-function API. Readers copy the pointer under
+    // the lock and then encode without it.
+    std::mutex default_mutex;
+    std::shared_ptr<Tokenizer> default_model = std::make_shared<Tokenizer>();
+    size_t default_cache_budget = WordCache::kDefaultBudget;
+
+    void set_default(Tokenizer tokenizer) {
+        auto next = std::make_shared<Tokenizer>(std::move(tokenizer));
+        std::lock_guard<std::mutex> lock(default_mutex);
+        next->set_cache_budget(default_cache_budget);
+        default_model = std::move(next);
+    }
+}
 
-    std::vector<DLLNode> train_tokens; 
+Tokenizer::Tokenizer() : cache(std::make_unique<WordCache>(0)) {}
 
-    void preprocess_train(const std::string& train_file) {
-        add_def_tokens(); 
-        std::ifstream file(train_file);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open training file: " + train_file);
-        }
-        std::string line; 
-        while (std::getline(file, line)) {
-            std::stringstream ss(line); 
-            std::string word; 
-            while (ss >> word) {
-                size_t n = word.size(); 
-                for (size_t i = 0; i < n; ++i) {
-                    std::string tok = word.substr(i, 1); 
-                    if (vocab_to_id.find(tok) == vocab_to_id.end()) {
-                        vocab_to_id[tok] = vocab_size; 
-                        id_to_vocab[vocab_size++] = tok; 
-                    }
-                    DLLNode node = {vocab_to_id[tok], -1, -1, true};
-                    train_tokens.push_back(node);
-                }
-                DLLNode eow_node = {vocab_to_id[EOW], -1, -1, true};
-                train_tokens.push_back(eow_node);
-            }
-        }
-        // Set prev and next ptrs. 
-        size_t n = train_tokens.size(); 
-        for (size_t i = 0; i < n; ++i) {
-                DLLNode& node = train_tokens[i]; 
-            if (i > 0) {
-                node.prev = i - 1; 
-            }
-            if (i + 1 < n) {
-                node.next = i + 1; 
-            }
-        }
+Tokenizer::Tokenizer(ModelImage model)
+    : image(std::move(model)), cache(std::make_unique<WordCache>(0)) {
+    eow_id = image.token_id(EOW);
+    if (image.token_id(EOS) != -1) {
+        add_special_tokens({EOS});
     }
+}
 
-    std::pair<int,int> get_merge() {
-        while (!frequency_heap.empty()) {
-            HeapNode* node = frequency_heap.pop();
-            if (node->priority <= 0) continue;
+Tokenizer::~Tokenizer() = default;
+Tokenizer::Tokenizer(Tokenizer&&) noexcept = default;
+Tokenizer& Tokenizer::operator=(Tokenizer&&) noexcept = default;
 
-            auto itOcc = occurrences.find(node->tok_ids);
-            if (itOcc == occurrences.end() || itOcc->second.empty()) continue;
+Tokenizer Tokenizer::load(const std::string& model_file) {
+    if (ModelImage::is_binary_file(model_file)) {
+        return Tokenizer(ModelImage::map_file(model_file));
+    }
+    return Tokenizer(ModelImage::load_text(model_file));
+}
 
-            return node->tok_ids;
-        }
-        throw std::runtime_error("No more merges available");
+void Tokenizer::save(const std::string& output_file, ModelFormat format) const {
+    if (format == ModelFormat::Binary) {
+        image.write_binary(output_file);
+    } else {
+        image.write_text(output_file);
     }
+}
 
-    void count_freqs(const std::vector<DLLNode>& tokens) {
-        const int EOW_ID = vocab_to_id[EOW];
-        size_t n = tokens.size(); 
-        for (size_t i = 0; i < n; ++i) {
-            const DLLNode& token = tokens[i];
-            if (token.next == -1) continue;
-            if (token.tok == EOW_ID) continue;
-            if (tokens[token.next].tok == EOW_ID) continue;
-            
-            std::pair<int, int> tok_pair(token.tok, tokens[token.next].tok);
-            auto it = pair_frequencies.find(tok_pair);
-            if (it == pair_frequencies.end()) {
-                auto node_ptr = std::make_unique<HeapNode>();
-                node_ptr->tok_ids = std::make_pair(tok_pair.first, tok_pair.second);
-                node_ptr->priority = 1;
-                frequency_heap.push(node_ptr.get());
-                pair_frequencies[tok_pair] = std::move(node_ptr);
-            } else {
-                HeapNode* node = it->second.get();
-                frequency_heap.updatePriority(node, node->priority + 1);
+std::vector<uint32_t> Tokenizer::add_special_tokens(const std::vector<std::string>& tokens) {
+    std::vector<uint32_t> ids;
+    bool grew = false;
+    for (const std::string& tok : tokens) {
+        if (tok.empty()) {
+            throw std::runtime_error("Special tokens must not be empty");
+        }
+        int id = special_token_id(tok);
+        if (id == -1) {
+            id = image.token_id(tok);
+            if (id == -1) {
+                id = image.vocab_size() + 256 + static_cast<int>(added_tokens.size());
+                added_tokens.push_back(tok);
             }
-            occurrences[tok_pair].push_back(i);
+            specials.push_back(tok);
+            special_ids.push_back(id);
+            grew = true;
         }
+        ids.push_back(id);
     }
+    if (grew) {
+        matcher = SpecialTokenMatcher(specials);
+    }
+    return ids;
+}
 
-    void apply_merge_to(std::vector<DLLNode>& tokens, const std::pair<int,int>& merge) {
-        auto start = std::chrono::high_resolution_clock::now();
-        profile_data.apply_merge_calls++;
-        
-        auto itOcc = occurrences.find(merge);
-        if (itOcc == occurrences.end()) {
-            auto end = std::chrono::high_resolution_clock::now();
-            profile_data.apply_merge_time += (end - start);
-            return;
-        }
-
-        const std::list<int>& indices = itOcc->second;
-        
-        int new_id = vocab_size;
-        bool did_merge = false;
+int Tokenizer::special_token_id(std::string_view token) const {
+    for (size_t i = 0; i < specials.size(); ++i) {
+        if (specials[i] == token) return static_cast<int>(special_ids[i]);
+    }
+    return -1;
+}
 
-        for (int idx : indices) {
+void Tokenizer::set_cache_budget(size_t bytes) const {
+    cache->set_budget(bytes);
+}
 
-            DLLNode& token = tokens[idx];
-            if (!token.active || token.next == -1 || token.tok != merge.first) continue;
+WordCacheStats Tokenizer::cache_stats() const {
+    return cache->stats();
+}
 
-            DLLNode& next_token = tokens[token.next];
-            if (!next_token.active || next_token.tok != merge.second) continue;
+void Tokenizer::encode_word(std::string_view word, bool ends_word, std::vector<int>& token_ids) const {
+    thread_local MergeScratch scratch;
+    const int n_vocab = image.vocab_size();
+    token_ids.clear();
+    for (unsigned char c : word) {
+        int id = n_vocab > 0 ? image.byte_id(c) : -1;
+        // Bytes outside the vocab get a fixed id past its end
+        token_ids.push_back(id != -1 ? id : n_vocab + c);
+    }
+    if (ends_word && eow_id != -1) {
+        token_ids.push_back(eow_id);
+    }
+    merge_word(image, token_ids, scratch);
+}
 
-            did_merge = true;
+void Tokenizer::encode(std::string_view text, std::vector<uint32_t>& ids,
+                       std::vector<TokenSpan>* offsets, const SpecialTokenPolicy& special) const {
+    if (!matches_special(matcher, special)) {
+        encode_text(text, text.data(), ids, offsets);
+        return;
+    }
 
-            // remove occurrences (prev, token), (token, next), (next, next.next)
-            if (token.prev != -1 && tokens[token.prev].active) {
-                std::pair<int,int> prev_pair(tokens[token.prev].tok, token.tok);
-                auto it = occurrences.find(prev_pair);
-                if (it != occurrences.end()) {
-                    auto& occ_list = it->second;
-                    occ_list.remove(token.prev);
-                    if (occ_list.empty()) {
-                        occurrences.erase(it);
-                    }
-                }
-                bump_priority(prev_pair, -1);
-            }
-        
-            bump_priority(std::make_pair(token.tok, next_token.tok), -1);
-            
-            // (next_token, next_token.next) 
-            if (next_token.next != -1 && tokens[next_token.next].active) {
-                std::pair<int,int> next_pair(next_token.tok, tokens[next_token.next].tok);
-                auto it = occurrences.find(next_pair);
-                if (it != occurrences.end()) {
-                    auto& occ_list = it->second;
-                    occ_list.remove(token.next);
-                    if (occ_list.empty()) {
-                        occurrences.erase(it);
-                    }
-                }
-                bump_priority(next_pair, -1);
+    // One scan finds the special tokens; the text between them is encoded as usual.
+    size_t done = 0;
+    size_t from = 0;
+    SpecialTokenMatcher::Match match;
+    while (matcher.find(text, from, match)) {
+        const uint32_t id = special_ids[match.pattern];
+        from = match.end;
+        if (!allows(special, id)) {
+            if (special.reject_disallowed) {
+                throw std::runtime_error("encode: special token " + specials[match.pattern] + " is not allowed");
             }
+            continue;
+        }
+        encode_text(text.substr(done, match.begin - done), text.data(), ids, offsets);
+        ids.push_back(id);
+        if (offsets != nullptr) {
+            offsets->push_back({static_cast<uint32_t>(match.begin), static_cast<uint32_t>(match.end)});
+        }
+        done = match.end;
+    }
+    encode_text(text.substr(done), text.data(), ids, offsets);
+}
 
-            // merge
-            int next_neighbor_idx = next_token.next;
-            token.tok = new_id;
-            token.next = next_neighbor_idx;
-            if (next_neighbor_idx != -1) tokens[next_neighbor_idx].prev = idx;
-            next_token.active = false;
-
-            // add new occs. 
-            const int EOW_ID = vocab_to_id[EOW];  // Cache for fast comparison
-            if (token.prev != -1 && tokens[token.prev].active) {
-                // Only check if tokens are NOT the EOW token (fast integer comparison)
-                if (tokens[token.prev].tok != EOW_ID && token.tok != EOW_ID) {
-                    std::pair<int,int> new_prev_pair(tokens[token.prev].tok, token.tok);
-                    bump_priority(new_prev_pair, +1);
-                    occurrences[new_prev_pair].push_back(token.prev);
-                }
+void Tokenizer::encode_text(std::string_view text, const char* origin, std::vector<uint32_t>& ids,
+                            std::vector<TokenSpan>* offsets) const {
+    thread_local std::vector<int> token_ids;
+    thread_local std::vector<std::string_view> pieces;
+    const bool use_cache = cache->budget() > 0;
+    const int n_vocab = image.vocab_size();
+
+    // Pre-tokenize a window at a time so huge texts need no piece list of
+    // their own size. A word running past the window waits for the next one.
+    constexpr size_t kWindow = 64u << 10;
+    size_t done = 0;
+    size_t window = kWindow;
+    while (done < text.size()) {
+        size_t n = std::min(window, text.size() - done);
+        bool last = done + n == text.size();
+        pieces.clear();
+        size_t tail = pretokenize_block(text.data() + done, 0, n, image.pretokenizer(), last, pieces);
+        if (tail == 0 && !last) {
+            window *= 2;  // one word fills the window
+            continue;
+        }
+        done += tail;
+        window = kWindow;
+
+        for (std::string_view word : pieces) {
+            const size_t start = word.data() - origin;
+            const size_t pos = start + word.size();
+            // Only pieces that end a word carry EOW, and only those are cached.
+            const bool ends = ends_word(word, text);
+            const bool cached = use_cache && ends;
+            if (!cached || !cache->lookup(word, token_ids)) {
+                encode_word(word, ends, token_ids);
+                if (cached) cache->insert(word, token_ids);
             }
-            if (token.next != -1 && tokens[token.next].active) {
-                if (token.tok != EOW_ID && tokens[token.next].tok != EOW_ID) {
-                
-                    std::pair<int,int> new_next_pair(token.tok, tokens[token.next].tok);
-                    bump_priority(new_next_pair, +1);
-                    occurrences[new_next_pair].push_back(idx);
+            ids.insert(ids.end(), token_ids.begin(), token_ids.end());
+
+            if (offsets != nullptr) {
+                // The tokens of a word spell out the word followed by EOW, so
+                // spans follow from token lengths clamped to the word's end.
+                size_t at = start;
+                for (int id : token_ids) {
+                    size_t len = id < n_vocab ? image.token(id).size() : 1;
+                    size_t end = std::min(at + len, pos);
+                    offsets->push_back({static_cast<uint32_t>(at), static_cast<uint32_t>(end)});
+                    at = end;
                 }
             }
         }
-
-        if (!did_merge) {
-            auto end = std::chrono::high_resolution_clock::now();
-            profile_data.apply_merge_time += (end - start);
-            return;
-        }
-
-        // update vocab
-        std::string new_token_str = id_to_vocab[merge.first] + id_to_vocab[merge.second];
-        vocab_to_id[new_token_str] = new_id;
-        id_to_vocab[new_id] = new_token_str;
-        vocab_size++;
-
-        merges.push_back(merge);
-        occurrences.erase(merge);
-        
-        auto end = std::chrono::high_resolution_clock::now();
-        profile_data.apply_merge_time += (end - start);
     }
+}
 
+std::vector<uint32_t> Tokenizer::encode(std::string_view text, const SpecialTokenPolicy& special) const {
+    std::vector<uint32_t> ids;
+    encode(text, ids, nullptr, special);
+    return ids;
+}
 
-    void clear() {
-        vocab_to_id.clear(); 
-        id_to_vocab.clear(); 
-        occurrences.clear(); 
-        merges.clear(); 
-        pair_frequencies.clear(); 
-        frequency_heap.clear(); 
-        train_tokens.clear();
-        vocab_size = 0;
-    }
+size_t Tokenizer::encode(std::string_view text, std::span<uint32_t> ids,
+                         std::span<TokenSpan> offsets, const SpecialTokenPolicy& special) const {
+    thread_local std::vector<uint32_t> all_ids;
+    thread_local std::vector<TokenSpan> all_offsets;
+    all_ids.clear();
+    all_offsets.clear();
+    encode(text, all_ids, offsets.empty() ? nullptr : &all_offsets, special);
+
+    std::copy_n(all_ids.begin(), std::min(ids.size(), all_ids.size()), ids.begin());
+    std::copy_n(all_offsets.begin(), std::min(offsets.size(), all_offsets.size()), offsets.begin());
+    return all_ids.size();
 }
 
-void save_model(const std::string& output_file) {
-    std::ofstream out(output_file);
-    if (!out.is_open()) {
-        throw std::runtime_error("Failed to open output file: " + output_file);
+size_t Tokenizer::safe_prefix(std::string_view text, const SpecialTokenPolicy& special) const {
+    if (!matches_special(matcher, special)) {
+        size_t cut = text.size();
+        while (cut > 0 && !is_space_byte(text[cut - 1])) --cut;
+        return cut;
     }
-    
-    out << "VOCAB_SIZE " << vocab_size << "\n";
-    out << "VOCAB\n";
-    for (const auto& pair : vocab_to_id) {
-        out << pair.first << "\t" << pair.second << "\n";
+
+    // Special tokens starting before `limit` are matched the same whatever
+    // follows; one that might run past the end of `text` starts after it.
+    const size_t limit = text.size() - matcher.open_suffix(text);
+    thread_local std::vector<SpecialTokenMatcher::Match> matches;
+    matches.clear();
+    SpecialTokenMatcher::Match match;
+    for (size_t from = 0; from < limit && matcher.find(text, from, match) && match.begin < limit; from = match.end) {
+        matches.push_back(match);
     }
-    
-    out << "MERGES\n";
-    for (const auto& merge : merges) {
-        std::string first_tok = id_to_vocab[merge.first];
-        std::string second_tok = id_to_vocab[merge.second];
-        out << first_tok << " " << second_tok << "\n";
+
+    size_t k = matches.size();  // matches[k - 1] is the last one starting before `cut`
+    for (size_t cut = limit; cut > 0; --cut) {
+        while (k > 0 && matches[k - 1].begin >= cut) --k;
+        if (k > 0 && cut <= matches[k - 1].end) {
+            const SpecialTokenMatcher::Match& m = matches[k - 1];
+            const bool allowed = allows(special, special_ids[m.pattern]);
+            if (cut == m.end && (allowed || is_space_byte(text[cut - 1]))) return cut;
+            if (allowed) return m.begin;
+            cut = m.begin + 1;  // nothing inside the token; continue before it
+            continue;
+        }
+        if (is_space_byte(text[cut - 1])) return cut;
     }
-    
-    out.close();
-    std::cout << "Model saved to " << output_file << "\n";
-    std::cout << "Final vocabulary size: " << vocab_size << "\n";
-    std::cout << "Number of merges learned: " << merges.size() << "\n";
+    return 0;
 }
 
-void train(const std::string& raw_data, size_t target_vocab_size) {    
-    clear();  
-    std::cout << "Preprocessing training data..." << std::endl;
-    preprocess_train(raw_data);
-    std::cout << " Initial vocabulary size: " << vocab_size << std::endl;
-    count_freqs(train_tokens);    
-    int merge_count = 0;
-    while (vocab_size < target_vocab_size && !frequency_heap.empty()) {
-        try {
-            std::pair<int, int> merge = get_merge(); 
-            
-                std::cout << "  Merge " << merge_count << ": " << id_to_vocab[merge.first] 
-                        << " + " << id_to_vocab[merge.second] << std::endl;
-            
-            apply_merge_to(train_tokens, merge); 
-            merge_count++;
-        } catch (const std::runtime_error& e) {
-            std::cout << "  No more valid merges available. Stopping at vocab size: " << vocab_size << std::endl;
-            break;
+std::vector<std::string> Tokenizer::tokenize(std::string_view text, const SpecialTokenPolicy& special) const {
+    std::vector<uint32_t> ids;
+    encode(text, ids, nullptr, special);
+
+    const uint32_t n_vocab = image.vocab_size();
+    std::vector<std::string> result;
+    result.reserve(ids.size());
+    for (uint32_t id : ids) {
+        if (id < n_vocab) {
+            result.emplace_back(image.token(id));
+        } else if (id < n_vocab + 256) {
+            result.emplace_back(1, static_cast<char>(id - n_vocab));
+        } else {
+            result.push_back(added_tokens[id - n_vocab - 256]);
         }
     }
-    
-    print_profile_stats();
-    save_model("bpe_model.txt");
-    std::cout << std::endl;
-    std::cout << "=== Training Complete ===" << std::endl;
+    return result;
 }
 
-void load_model(const std::string& model_file) {
-    std::cout << "Loading BPE model from " << model_file << "..." << std::endl;
-    
-    clear();
-    
-    std::ifstream in(model_file);
-    if (!in.is_open()) {
-        throw std::runtime_error("Failed to open model file: " + model_file);
-    }
-    
-    std::string line;
-    
-    // Read vocab size
-    std::getline(in, line);
-    if (line.substr(0, 11) != "VOCAB_SIZE ") {
-        throw std::runtime_error("Invalid model file format: expected VOCAB_SIZE");
+void Tokenizer::decode_append(std::span<const uint32_t> ids, std::string& out) const {
+    const uint32_t n_vocab = image.vocab_size();
+    const std::string_view eow = EOW;
+
+    // Size the output first so the copy loop is nothing but memcpy.
+    size_t total = 0;
+    for (uint32_t id : ids) {
+        if (id < n_vocab) {
+            std::string_view tok = image.token(id);
+            total += tok.ends_with(eow) ? tok.size() - eow.size() + 1 : tok.size();
+        } else if (id < n_vocab + 256) {
+            total += 1;
+        } else if (id - n_vocab - 256 < added_tokens.size()) {
+            total += added_tokens[id - n_vocab - 256].size();
+        } else {
+            throw std::out_of_range("decode: token id " + std::to_string(id) + " is not in the model");
+        }
     }
-    int expected_vocab_size = std::stoi(line.substr(11));
-    
-    // Read VOCAB header
-    std::getline(in, line);
-    if (line != "VOCAB") {
-        throw std::runtime_error("Invalid model file format: expected VOCAB");
+
+    size_t at = out.size();
+    out.resize(at + total);
+    char* dst = out.data();
+    for (uint32_t id : ids) {
+        if (id >= n_vocab + 256) {
+            const std::string& tok = added_tokens[id - n_vocab - 256];
+            std::memcpy(dst + at, tok.data(), tok.size());
+            at += tok.size();
+            continue;
+        }
+        if (id >= n_vocab) {
+            dst[at++] = static_cast<char>(id - n_vocab);
+            continue;
+        }
+        std::string_view tok = image.token(id);
+        if (tok.ends_with(eow)) {
+            size_t len = tok.size() - eow.size();
+            std::memcpy(dst + at, tok.data(), len);
+            dst[at + len] = ' ';
+            at += len + 1;
+        } else {
+            std::memcpy(dst + at, tok.data(), tok.size());
+            at += tok.size();
+        }
     }
-    
-    // Read vocabulary
-    while (std::getline(in, line) && line != "MERGES") {
-        size_t tab_pos = line.find('\t');
-        if (tab_pos == std::string::npos) continue;
-        
-        std::string token = line.substr(0, tab_pos);
-        int id = std::stoi(line.substr(tab_pos + 1));
-        
-        vocab_to_id[token] = id;
-        id_to_vocab[id] = token;
-        if (id >= vocab_size) vocab_size = id + 1;
+}
+
+std::string Tokenizer::decode(std::span<const uint32_t> ids) const {
+    std::string text;
+    decode_append(ids, text);
+    if (!text.empty() && text.back() == ' ') {
+        text.pop_back();
     }
-    
-    // Read merges (line already contains "MERGES" or next merge)
-    if (line == "MERGES") {
-        std::getline(in, line);
+    return text;
+}
+
+std::vector<std::string> Tokenizer::decode_batch(std::span<const std::vector<uint32_t>> docs) const {
+    std::vector<std::string> texts;
+    texts.reserve(docs.size());
+    for (const auto& ids : docs) {
+        texts.push_back(decode(ids));
     }
-    
-    do {
-        if (line.empty()) continue;
-        
-        size_t space_pos = line.find(' ');
-        if (space_pos == std::string::npos) continue;
-        
-        std::string first = line.substr(0, space_pos);
-        std::string second = line.substr(space_pos + 1);
-        
-        // Convert to IDs and store
-        if (vocab_to_id.find(first) != vocab_to_id.end() && 
-            vocab_to_id.find(second) != vocab_to_id.end()) {
-            merges.push_back(std::make_pair(vocab_to_id[first], vocab_to_id[second]));
+    return texts;
+}
+
+std::vector<std::vector<uint32_t>> Tokenizer::encode_batch(std::span<const std::string_view> docs,
+                                                           ThreadPool& pool, size_t chunk_size) const {
+    std::vector<std::vector<uint32_t>> results(docs.size());
+    pool.parallel_for(docs.size(), chunk_size, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            encode(docs[i], results[i]);
         }
-    } while (std::getline(in, line));
-    
-    in.close();
-    
-    std::cout << "  Loaded vocabulary size: " << vocab_size << std::endl;
-    std::cout << "  Loaded merges: " << merges.size() << std::endl;
+    });
+    return results;
+}
+
+std::vector<std::vector<uint32_t>> Tokenizer::encode_batch(std::span<const std::string_view> docs,
+                                                           size_t num_threads, size_t chunk_size) const {
+    ThreadPool pool(num_threads);
+    return encode_batch(docs, pool, chunk_size);
+}
+
+void train(const std::string& raw_data, size_t target_vocab_size) {
+    Trainer trainer;
+    Tokenizer tokenizer = trainer.train(raw_data, target_vocab_size);
+    tokenizer.save("bpe_model.txt");
+    std::cout << "Model saved to bpe_model.txt\n";
+    std::cout << "Final vocabulary size: " << tokenizer.vocab_size() << "\n";
+    std::cout << "Number of merges learned: " << tokenizer.model().num_merges() << "\n";
+    set_default(std::move(tokenizer));
+    std::cout << std::endl;
+    std::cout << "=== Training Complete ===" << std::endl;
+}
+
+void train_continue(const std::string& model_file, const std::string& raw_data, size_t target_vocab_size) {
+    Trainer trainer;
+    Tokenizer tokenizer = trainer.train_continue(Tokenizer::load(model_file), raw_data, target_vocab_size);
+    tokenizer.save("bpe_model.txt");
+    std::cout << "Model saved to bpe_model.txt\n";
+    std::cout << "Final vocabulary size: " << tokenizer.vocab_size() << "\n";
+    std::cout << "Number of merges learned: " << tokenizer.model().num_merges() << "\n";
+    set_default(std::move(tokenizer));
+    std::cout << std::endl;
+    std::cout << "=== Training Complete ===" << std::endl;
+}
+
+void save_model(const std::string& output_file, ModelFormat format) {
+    auto tokenizer = default_tokenizer();
+    tokenizer->save(output_file, format);
+    std::cout << "Model saved to " << output_file << "\n";
+    std::cout << "Final vocabulary size: " << tokenizer->vocab_size() << "\n";
+    std::cout << "Number of merges learned: " << tokenizer->model().num_merges() << "\n";
+}
+
+std::shared_ptr<const Tokenizer> load_model(const std::string& model_file) {
+    std::cout << "Loading BPE model from " << model_file << "..." << std::endl;
+    set_default(Tokenizer::load(model_file));
+    auto tokenizer = default_tokenizer();
+    std::cout << "  Loaded vocabulary size: " << tokenizer->vocab_size() << std::endl;
+    std::cout << "  Loaded merges: " << tokenizer->model().num_merges() << std::endl;
     std::cout << "Model loaded successfully!" << std::endl << std::endl;
+    return tokenizer;
+}
+
+std::shared_ptr<const Tokenizer> default_tokenizer() {
+    std::lock_guard<std::mutex> lock(default_mutex);
+    return default_model;
 }
 
 std::vector<std::string> tokenize(const std::string& text) {
-    std::vector<std::vector<int> > words;
-    std::stringstream ss(text);
-    std::string word;
-    while (ss >> word) {
-        std::vector<int> token_ids;
-        for (size_t i = 0; i < word.size(); ++i) {
-            std::string ch = word.substr(i, 1);
-            // If character not in vocab, add it
-            if (vocab_to_id.find(ch) == vocab_to_id.end()) {
-                vocab_to_id[ch] = vocab_size;
-                id_to_vocab[vocab_size++] = ch;
-            }
-            token_ids.push_back(vocab_to_id[ch]);
-        }
-        if (vocab_to_id.find(EOW) != vocab_to_id.end()) {
-            token_ids.push_back(vocab_to_id[EOW]);
-        }
-        words.push_back(token_ids);
-    }
-    for (auto& token_ids : words) {
-        for (const auto& merge : merges) {
-            bool changed = true;
-            while (changed) {
-                changed = false;
-                for (size_t i = 0; i + 1 < token_ids.size(); ++i) {
-                    if (token_ids[i] == merge.first && token_ids[i + 1] == merge.second) {
-                        std::string merged_token = id_to_vocab[merge.first] + id_to_vocab[merge.second];
-                        int merged_id;
-                        if (vocab_to_id.find(merged_token) != vocab_to_id.end()) {
-                            merged_id = vocab_to_id[merged_token];
-                        } else {
-                            continue;
-                        }
-                        token_ids[i] = merged_id;
-                        token_ids.erase(token_ids.begin() + i + 1);
-                        changed = true;
-                        break;
-                    }
-                }
-            }
-        }
-    }
-    std::vector<std::string> result;
-    for (const auto& token_ids : words) {
-        for (int id : token_ids) {
-            result.push_back(id_to_vocab[id]);
-        }
-    }
-    
-    return result;
-}
\ No newline at end of file
+    return default_tokenizer()->tokenize(text);
+}
+
+std::vector<uint32_t> encode(const std::string& text) {
+    return default_tokenizer()->encode(text);
+}
+
+std::string decode(const std::vector<uint32_t>& ids) {
+    return default_tokenizer()->decode(ids);
+}
+
+void set_encode_cache_budget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(default_mutex);
+    default_cache_budget = bytes;
+    default_model->set_cache_budget(bytes);
+}
+
+WordCacheStats encode_cache_stats() {
+    return default_tokenizer()->cache_stats();
+}
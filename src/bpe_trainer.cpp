@@ -0,0 +1,1015 @@
+/*
+ * BPE Trainer
+ * Learns merges over a doubly linked list of corpus tokens, picking the most
+ * frequent pair from an IndexedHeap and patching pair counts around each merge.
+ * By default each distinct word is stored once and weighted by its count.
+ */
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <memory>
+#include <chrono>
+#include <iomanip>
+#include <queue>
+
+#include <bpe.hpp>
+#include <corpus_reader.hpp>
+#include <indexed_heap.hpp>
+
+namespace {
+
+    struct PairHash {
+        std::size_t operator()(const std::pair<int, int>& p) const {
+            auto h1 = std::hash<int>{}(p.first);
+            auto h2 = std::hash<int>{}(p.second);
+            return h1 ^ (h2 << 1);
+        }
+    };
+
+    // DLL within a fixed size vector. A node merged into its left neighbour
+    // is unlinked and its tok set to -1. count is the number of times the
+    // node's word occurs in the corpus.
+    //
+    // occ_prev/occ_next thread the node onto the occurrence list of the pair
+    // it starts, (tok, tokens[next].tok), so it can be unlinked in O(1).
+    // occ_prev is kUnlinked while the node is on no list.
+    struct DLLNode {
+        int tok; 
+        int prev; 
+        int next; 
+        int count;
+        int occ_prev;
+        int occ_next;
+
+        bool active() const { return tok >= 0; }
+    };
+
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const {
+            return std::hash<std::string_view>{}(s);
+        }
+    };
+
+    // Word and pair tables are split by hash into this many partitions so
+    // thread-local tables can be merged one partition per task.
+    constexpr size_t kPartitions = 64;
+
+    struct WordStat {
+        int count;
+        uint64_t first;  // (chunk << 32) | index of the word's first occurrence
+    };
+
+    using WordTable = std::unordered_map<std::string, WordStat, StringHash, std::equal_to<>>;
+    using LocalWordTable = std::unordered_map<std::string_view, WordStat>;
+
+    struct PairStat {
+        int count = 0;
+        std::vector<int> positions;
+    };
+
+    using LocalPairTable = std::unordered_map<std::pair<int, int>, PairStat, PairHash>;
+
+    constexpr int kUnlinked = -2;
+
+    // Entry of the lazy merge queue: a pair's count when it was pushed.
+    // Ordered like IndexedHeap: highest count first, then smallest pair.
+    struct LazyEntry {
+        int count;
+        std::pair<int, int> tok_ids;
+
+        bool operator<(const LazyEntry& other) const {
+            if (count != other.count) return count < other.count;
+            return tok_ids > other.tok_ids;
+        }
+    };
+
+    // A pair's queue node. `raised` is MergeQueue::Lazy state: the pair is
+    // listed in State::raised, waiting to be pushed at its new count.
+    struct PairEntry {
+        HeapNode* node = nullptr;
+        bool raised = false;
+    };
+
+    // Occurrence list of one pair: first and last node, in insertion order.
+    struct OccList {
+        int head = -1;
+        int tail = -1;
+
+        bool empty() const { return head == -1; }
+    };
+
+    constexpr double kMiB = 1024.0 * 1024.0;
+
+    // Checkpoint file: this header, then the continuation prefix as (length,
+    // bytes), the vocab as (length, bytes) in id order, the merges, the token
+    // nodes as stored, (left, right, count) for every pair with a nonzero
+    // count and (left, right, head, tail) for every occurrence list, pairs in
+    // ascending order, then a checksum of everything before it.
+    // Little-endian, like the binary model format.
+    constexpr char kCheckpointMagic[8] = {'B', 'P', 'E', 'C', 'K', 'P', 'T', '1'};
+    constexpr uint32_t kCheckpointVersion = 2;
+
+    struct CheckpointHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t pretokenizer;
+        uint32_t byte_level;
+        int32_t vocab_size;
+        uint64_t num_merges;
+        uint64_t num_nodes;
+        uint64_t num_pairs;
+        uint64_t num_lists;
+        uint64_t corpus_bytes;
+        uint64_t corpus_words;
+        uint64_t unique_words;
+        uint64_t initial_pairs;
+    };
+
+    // Binary stream that hashes what passes through it (FNV-1a)
+    class CheckpointWriter {
+    public:
+        explicit CheckpointWriter(const std::string& path) : out(path, std::ios::binary), path(path) {
+            if (!out.is_open()) {
+                throw std::runtime_error("Failed to open checkpoint file: " + path);
+            }
+        }
+
+        void write(const void* data, size_t n) {
+            hash_bytes(data, n);
+            out.write(static_cast<const char*>(data), n);
+        }
+
+        template <typename T>
+        void put(const T& value) { write(&value, sizeof(T)); }
+
+        void finish() {
+            uint64_t sum = hash;
+            out.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+            out.close();
+            if (!out) throw std::runtime_error("Failed to write checkpoint file: " + path);
+        }
+
+    private:
+        void hash_bytes(const void* data, size_t n) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < n; ++i) hash = (hash ^ p[i]) * 0x100000001b3ull;
+        }
+
+        std::ofstream out;
+        std::string path;
+        uint64_t hash = 0xcbf29ce484222325ull;
+    };
+
+    class CheckpointReader {
+    public:
+        explicit CheckpointReader(const std::string& path) : in(path, std::ios::binary), path(path) {
+            if (!in.is_open()) {
+                throw std::runtime_error("Failed to open checkpoint file: " + path);
+            }
+            in.seekg(0, std::ios::end);
+            file_size = static_cast<uint64_t>(in.tellg());
+            in.seekg(0);
+        }
+
+        // `count`, after checking the file can hold that many records, so a
+        // corrupt count fails before it is allocated
+        size_t expect(uint64_t count, uint64_t record_size) {
+            if (count > file_size / record_size) fail("truncated");
+            return static_cast<size_t>(count);
+        }
+
+        void read(void* data, size_t n) {
+            in.read(static_cast<char*>(data), n);
+            if (static_cast<size_t>(in.gcount()) != n) fail("truncated");
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < n; ++i) hash = (hash ^ p[i]) * 0x100000001b3ull;
+        }
+
+        template <typename T>
+        T get() {
+            T value;
+            read(&value, sizeof(T));
+            return value;
+        }
+
+        void finish() {
+            uint64_t expected = hash;
+            uint64_t sum = 0;
+            in.read(reinterpret_cast<char*>(&sum), sizeof(sum));
+            if (in.gcount() != sizeof(sum) || sum != expected) fail("checksum mismatch");
+        }
+
+        [[noreturn]] void fail(const std::string& why) const {
+            throw std::runtime_error("Invalid checkpoint file " + path + ": " + why);
+        }
+
+    private:
+        std::ifstream in;
+        std::string path;
+        uint64_t file_size = 0;
+        uint64_t hash = 0xcbf29ce484222325ull;
+    };
+}
+
+struct Trainer::State {
+    std::unordered_map<std::string, int> vocab_to_id; 
+    std::unordered_map<int, std::string> id_to_vocab; 
+    int vocab_size = 0; 
+
+    std::unordered_map<std::pair<int, int>, OccList, PairHash> occurrences; 
+    std::vector<std::pair<int, int> > merges;
+
+    // Pairs by frequency; equal counts go to the smaller (left, right) ids.
+    // Ids are EOW, EOS, the corpus bytes in byte order, then merged tokens in
+    // merge order, so ties fall the same way on every platform and for any
+    // word order. With MergeQueue::Indexed every count change
+    // re-sifts the pair's node in frequency_heap. With MergeQueue::Lazy the
+    // node only records the count. Pairs whose count rose are collected in
+    // `raised` and pushed once, at their final count, before the next pop,
+    // so each pair's best entry never understates it. An entry popped with
+    // an outdated count is pushed back at the current one.
+    MergeQueue queue_kind = MergeQueue::Indexed;
+    IndexedHeap frequency_heap;
+    std::priority_queue<LazyEntry> lazy_heap;
+    std::vector<PairEntry*> raised;
+    HeapNodePool heap_nodes;
+    std::unordered_map<std::pair<int, int>, PairEntry, PairHash> pair_frequencies; 
+
+    std::vector<DLLNode> train_tokens; 
+    std::unique_ptr<ThreadPool> pool;
+
+    TrainMetrics metrics;
+    // Work done by the current merge: sites visited and pair count changes.
+    // Plain counters, read only when metrics are collected
+    uint64_t merge_sites = 0;
+    uint64_t count_updates = 0;
+    int merged_count = 0;  // count of the pair get_merge() returned last
+
+    void add_def_tokens() {
+        vocab_to_id[EOW] = vocab_size; 
+        id_to_vocab[vocab_size++] = EOW; 
+        vocab_to_id[EOS] = vocab_size; 
+        id_to_vocab[vocab_size++] = EOS; 
+    }
+
+    // Byte nodes hold kRawByte + byte until every word is read; then each
+    // byte seen gets its id in byte order, so ids (and with them the heap's
+    // tie-break) do not depend on where in the corpus a byte first appears.
+    // With byte_level every byte gets an id whether it was seen or not.
+    // With a continuation prefix, bytes after the first of a word are
+    // kRawByte + 256 + byte and become prefixed tokens, numbered after the
+    // word-initial ones.
+    static constexpr int kRawByte = 1 << 16;
+    bool byte_seen[512];
+    bool byte_level = false;
+    PreTokenizer pretokenizer = PreTokenizer::Whitespace;
+    std::string continuation_prefix;
+
+    // Append a word's byte nodes and its EOW node, all weighted by `count`.
+    // Pairs with EOW are never counted, so the EOW node only separates words;
+    // the pieces of a CharClass-split word are pushed as words of their own.
+    void push_word(std::string_view word, int count) {
+        if (replay) {
+            push_encoded(word, count);
+            return;
+        }
+        const int continuation = continuation_prefix.empty() ? 0 : 256;
+        for (size_t i = 0; i < word.size(); ++i) {
+            int b = static_cast<unsigned char>(word[i]) + (i > 0 ? continuation : 0);
+            byte_seen[b] = true;
+            int idx = static_cast<int>(train_tokens.size());
+            train_tokens.push_back({kRawByte + b, idx - 1, idx + 1, count, kUnlinked, -1});
+        }
+        int idx = static_cast<int>(train_tokens.size());
+        train_tokens.push_back({vocab_to_id[EOW], idx - 1, idx + 1, count, kUnlinked, -1});
+    }
+
+    // Continuing from an existing model: its merges are replayed on each
+    // word with the model's encoder, and the nodes start from the resulting
+    // segmentation, which is where a run that learned those merges stands.
+    // Special token text is replayed as plain bytes, as train() reads it.
+    const Tokenizer* replay = nullptr;
+    std::vector<uint32_t> replay_ids;
+    const SpecialTokenPolicy replay_policy{.mode = SpecialTokenPolicy::Mode::None};
+
+    void push_encoded(std::string_view word, int count) {
+        replay_ids.clear();
+        replay->encode(word, replay_ids, nullptr, replay_policy);
+        for (uint32_t id : replay_ids) {
+            if (id >= static_cast<uint32_t>(vocab_size)) {
+                throw std::runtime_error("Training data has bytes outside the vocabulary of the model being continued");
+            }
+            int idx = static_cast<int>(train_tokens.size());
+            train_tokens.push_back({static_cast<int>(id), idx - 1, idx + 1, count, kUnlinked, -1});
+        }
+    }
+
+    // Take the vocab, merges and options of a model this trainer produced:
+    // EOW, EOS, single bytes in byte order, then one token per merge
+    void load_merges(const Tokenizer& model) {
+        const ModelImage& image = model.model();
+        const int n_merges = static_cast<int>(image.num_merges());
+        const int base = image.vocab_size() - n_merges;
+        auto fail = [] {
+            throw std::runtime_error("Can only continue a model laid out by the trainer "
+                                     "(special tokens, bytes in byte order, one token per merge)");
+        };
+        if (base < 2 || image.token(0) != EOW || image.token(1) != EOS) fail();
+        for (int id = 2; id < base; ++id) {
+            std::string_view tok = image.token(id);
+            if (tok.size() != 1) fail();
+            if (id > 2 && static_cast<unsigned char>(image.token(id - 1)[0]) >= static_cast<unsigned char>(tok[0])) fail();
+        }
+        for (int rank = 0; rank < n_merges; ++rank) {
+            const ModelImage::Merge& merge = image.merge(rank);
+            if (merge.merged != base + rank) fail();
+            std::string_view left = image.token(merge.left), right = image.token(merge.right);
+            std::string_view merged = image.token(merge.merged);
+            if (merged.size() != left.size() + right.size() || merged.substr(0, left.size()) != left ||
+                merged.substr(left.size()) != right) fail();
+            merges.emplace_back(merge.left, merge.right);
+        }
+        for (int id = 0; id < image.vocab_size(); ++id) {
+            std::string tok(image.token(id));
+            vocab_to_id[tok] = id;
+            id_to_vocab[id] = std::move(tok);
+        }
+        vocab_size = image.vocab_size();
+        byte_level = base - 2 == 256;
+        pretokenizer = image.pretokenizer();
+        replay = &model;
+    }
+
+    void occ_push_back(const std::pair<int,int>& p, int idx) {
+        OccList& list = occurrences[p];
+        DLLNode& node = train_tokens[idx];
+        node.occ_prev = list.tail;
+        node.occ_next = -1;
+        if (list.tail != -1) {
+            train_tokens[list.tail].occ_next = idx;
+        } else {
+            list.head = idx;
+        }
+        list.tail = idx;
+    }
+
+    void occ_unlink(OccList& list, int idx) {
+        DLLNode& node = train_tokens[idx];
+        if (node.occ_prev != -1) {
+            train_tokens[node.occ_prev].occ_next = node.occ_next;
+        } else {
+            list.head = node.occ_next;
+        }
+        if (node.occ_next != -1) {
+            train_tokens[node.occ_next].occ_prev = node.occ_prev;
+        } else {
+            list.tail = node.occ_prev;
+        }
+        node.occ_prev = kUnlinked;
+        node.occ_next = -1;
+    }
+
+    // Take node idx off the list of `p`, the pair it currently starts, and
+    // drop the list once empty unless it is `keep` (the list being merged).
+    void occ_remove(const std::pair<int,int>& p, int idx, const std::pair<int,int>& keep) {
+        if (train_tokens[idx].occ_prev == kUnlinked) return;
+        auto it = occurrences.find(p);
+        if (it == occurrences.end()) return;
+        occ_unlink(it->second, idx);
+        if (it->second.empty() && p != keep) {
+            occurrences.erase(it);
+        }
+    }
+
+    void bump_priority(const std::pair<int,int>& p, int delta) {
+        count_updates++;
+        auto it = pair_frequencies.find(p);
+        if (it == pair_frequencies.end()) {
+            HeapNode* node = heap_nodes.make(p, 0);
+            if (queue_kind == MergeQueue::Indexed) {
+                frequency_heap.push(node); // inserts into heap
+            }
+            it = pair_frequencies.emplace(p, PairEntry{node}).first;
+        }
+        PairEntry& entry = it->second;
+        HeapNode* node = entry.node;
+        int newPri = node->priority + delta;
+        if (newPri < 0) newPri = 0;
+        if (queue_kind == MergeQueue::Indexed) {
+            frequency_heap.updatePriority(node, newPri);
+        } else {
+            if (newPri > node->priority && !entry.raised) {
+                entry.raised = true;
+                raised.push_back(&entry);
+            }
+            node->priority = newPri;
+        }
+    }
+
+    bool queue_empty() {
+        if (queue_kind == MergeQueue::Indexed) return frequency_heap.empty();
+        for (PairEntry* entry : raised) {
+            entry->raised = false;
+            if (entry->node->priority > 0) lazy_heap.push({entry->node->priority, entry->node->tok_ids});
+        }
+        raised.clear();
+        return lazy_heap.empty();
+    }
+
+    size_t queue_size() const {
+        if (queue_kind == MergeQueue::Indexed) return frequency_heap.size();
+        return lazy_heap.size() + raised.size();
+    }
+
+    // Next pair off the queue, or nullptr for a stale lazy entry
+    HeapNode* pop_queue() {
+        if (queue_kind == MergeQueue::Indexed) {
+            return frequency_heap.pop();
+        }
+        LazyEntry entry = lazy_heap.top();
+        lazy_heap.pop();
+        HeapNode* node = pair_frequencies[entry.tok_ids].node;
+        if (entry.count == node->priority) return node;
+        // The count fell since this entry was pushed: requeue at the current count
+        if (node->priority > 0) lazy_heap.push({node->priority, entry.tok_ids});
+        return nullptr;
+    }
+
+    // Count distinct words. Rounds of one chunk per thread are split and
+    // counted into partitioned thread-local tables, then each partition is
+    // merged into `table` in chunk order by its own task.
+    void count_words(CorpusReader& reader, std::vector<WordTable>& table) {
+        std::vector<std::vector<char>> chunks(pool->size());
+        std::vector<std::vector<LocalWordTable>> local(chunks.size());
+        std::vector<size_t> chunk_words(chunks.size());
+        uint64_t round_start = 0;
+        while (true) {
+            size_t n_chunks = 0;
+            while (n_chunks < chunks.size() && reader.next_chunk(chunks[n_chunks])) {
+                ++n_chunks;
+            }
+            if (n_chunks == 0) break;
+
+            pool->parallel_for(n_chunks, 1, [&](size_t begin, size_t end) {
+                std::vector<std::string_view> words;
+                for (size_t c = begin; c < end; ++c) {
+                    words.clear();
+                    pretokenize(std::string_view(chunks[c].data(), chunks[c].size()), pretokenizer, words);
+                    local[c].resize(kPartitions);
+                    for (auto& part : local[c]) part.clear();
+                    uint64_t first = (round_start + c) << 32;
+                    for (size_t i = 0; i < words.size(); ++i) {
+                        size_t h = StringHash{}(words[i]);
+                        auto [it, inserted] = local[c][h % kPartitions].try_emplace(words[i], WordStat{0, first | i});
+                        it->second.count++;
+                    }
+                    chunk_words[c] = words.size();
+                }
+            });
+            pool->parallel_for(kPartitions, 1, [&](size_t begin, size_t end) {
+                for (size_t part = begin; part < end; ++part) {
+                    for (size_t c = 0; c < n_chunks; ++c) {
+                        for (const auto& [word, stat] : local[c][part]) {
+                            auto it = table[part].find(word);
+                            if (it == table[part].end()) {
+                                table[part].emplace(std::string(word), stat);
+                            } else {
+                                it->second.count += stat.count;
+                            }
+                        }
+                    }
+                }
+            });
+            for (size_t c = 0; c < n_chunks; ++c) {
+                metrics.corpus_words += chunk_words[c];
+            }
+            round_start += n_chunks;
+        }
+    }
+
+    // Stream the corpus word by word into train_tokens: one node per byte
+    // plus an EOW node per word, linked across the whole corpus. With
+    // `dedup_words` each distinct word gets one run of nodes, in order of
+    // first appearance, carrying its count; otherwise every occurrence gets
+    // its own run with count 1.
+    void preprocess_train(const std::string& train_file, bool dedup_words) {
+        ScopedTimer timer(&metrics.preprocess_seconds);
+        if (!replay) add_def_tokens();
+        std::fill(std::begin(byte_seen), std::end(byte_seen), false);
+        CorpusReader reader(train_file, CorpusReader::kDefaultBlockSize, pretokenizer);
+
+        std::vector<std::string_view> words;
+        if (dedup_words) {
+            std::vector<WordTable> table(kPartitions);
+            count_words(reader, table);
+
+            std::vector<std::pair<const std::string*, const WordStat*>> unique;
+            for (const auto& part : table) {
+                for (const auto& [word, stat] : part) {
+                    unique.emplace_back(&word, &stat);
+                }
+            }
+            std::sort(unique.begin(), unique.end(), [](const auto& a, const auto& b) {
+                return a.second->first < b.second->first;
+            });
+            for (const auto& [word, stat] : unique) {
+                push_word(*word, stat->count);
+            }
+            metrics.unique_words = unique.size();
+        } else {
+            // A word takes one node per byte plus its EOW. With Whitespace
+            // pre-tokenization every word is followed by whitespace or the end
+            // of file, so the file size bounds the node count and the vector
+            // never regrows. CharClass words can abut (each class run gets its
+            // own EOW), so the bound there is twice the file size; a quarter
+            // more covers ordinary prose, and the vector regrows past that.
+            if (reader.file_size() > 0) {
+                const size_t expected = pretokenizer == PreTokenizer::Whitespace
+                    ? reader.file_size() + 1
+                    : reader.file_size() + reader.file_size() / 4 + 1;
+                train_tokens.reserve(expected);
+            }
+            while (reader.next(words)) {
+                for (std::string_view word : words) {
+                    push_word(word, 1);
+                }
+                metrics.corpus_words += words.size();
+            }
+            metrics.unique_words = metrics.corpus_words;
+        }
+        if (!train_tokens.empty()) {
+            train_tokens.front().prev = -1;
+            train_tokens.back().next = -1;
+        }
+        if (!replay) assign_byte_ids();
+        metrics.corpus_bytes = reader.bytes_read();
+    }
+
+    void assign_byte_ids() {
+        int byte_to_id[512];
+        const int n_raw = continuation_prefix.empty() ? 256 : 512;
+        for (int b = 0; b < n_raw; ++b) {
+            if (!byte_seen[b] && !byte_level) continue;
+            std::string tok = b < 256 ? std::string(1, static_cast<char>(b))
+                                      : continuation_prefix + static_cast<char>(b - 256);
+            byte_to_id[b] = vocab_size;
+            vocab_to_id[tok] = vocab_size;
+            id_to_vocab[vocab_size++] = tok;
+        }
+        for (DLLNode& node : train_tokens) {
+            if (node.tok >= kRawByte) node.tok = byte_to_id[node.tok - kRawByte];
+        }
+    }
+
+    std::pair<int,int> get_merge() {
+        while (!queue_empty()) {
+            HeapNode* node = pop_queue();
+            if (node == nullptr || node->priority <= 0) continue;
+
+            auto itOcc = occurrences.find(node->tok_ids);
+            if (itOcc == occurrences.end() || itOcc->second.empty()) continue;
+
+            merged_count = node->priority;
+            return node->tok_ids;
+        }
+        throw std::runtime_error("No more merges available");
+    }
+
+    // Count the initial pairs. Token ranges are counted into partitioned
+    // thread-local tables and partitions are reduced in parallel, each
+    // threading its pairs' occurrence lists in ascending position order.
+    // Only then are the heap and the occurrence index filled.
+    void count_freqs(std::vector<DLLNode>& tokens) {
+        ScopedTimer timer(&metrics.count_pairs_seconds);
+        const int EOW_ID = vocab_to_id[EOW];
+        const size_t n = tokens.size();
+        const size_t n_ranges = std::max<size_t>(1, std::min(pool->size() * 4, n / 4096));
+        std::vector<std::vector<LocalPairTable>> local(n_ranges);
+
+        pool->parallel_for(n_ranges, 1, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; ++r) {
+                local[r].assign(kPartitions, LocalPairTable());
+                for (size_t i = n * r / n_ranges; i < n * (r + 1) / n_ranges; ++i) {
+                    const DLLNode& token = tokens[i];
+                    if (token.next == -1) continue;
+                    if (token.tok == EOW_ID) continue;
+                    if (tokens[token.next].tok == EOW_ID) continue;
+
+                    std::pair<int, int> tok_pair(token.tok, tokens[token.next].tok);
+                    PairStat& stat = local[r][PairHash{}(tok_pair) % kPartitions][tok_pair];
+                    stat.count += token.count;
+                    stat.positions.push_back(static_cast<int>(i));
+                }
+            }
+        });
+
+        std::vector<LocalPairTable> merged(kPartitions);
+        pool->parallel_for(kPartitions, 1, [&](size_t begin, size_t end) {
+            for (size_t part = begin; part < end; ++part) {
+                for (size_t r = 0; r < n_ranges; ++r) {
+                    for (auto& [tok_pair, stat] : local[r][part]) {
+                        PairStat& total = merged[part][tok_pair];
+                        total.count += stat.count;
+                        total.positions.insert(total.positions.end(), stat.positions.begin(), stat.positions.end());
+                    }
+                    local[r][part] = LocalPairTable();
+                }
+                for (auto& [tok_pair, stat] : merged[part]) {
+                    const std::vector<int>& pos = stat.positions;
+                    for (size_t k = 0; k < pos.size(); ++k) {
+                        tokens[pos[k]].occ_prev = k > 0 ? pos[k - 1] : -1;
+                        tokens[pos[k]].occ_next = k + 1 < pos.size() ? pos[k + 1] : -1;
+                    }
+                }
+            }
+        });
+
+        std::vector<LazyEntry> entries;
+        for (auto& part : merged) {
+            for (auto& [tok_pair, stat] : part) {
+                HeapNode* node = heap_nodes.make(tok_pair, stat.count);
+                if (queue_kind == MergeQueue::Indexed) {
+                    frequency_heap.push(node);
+                } else {
+                    entries.push_back({stat.count, tok_pair});
+                }
+                pair_frequencies[tok_pair] = PairEntry{node};
+                occurrences[tok_pair] = OccList{stat.positions.front(), stat.positions.back()};
+            }
+            part = LocalPairTable();
+        }
+        if (queue_kind == MergeQueue::Lazy) {
+            lazy_heap = std::priority_queue<LazyEntry>(std::less<LazyEntry>(), std::move(entries));
+        }
+        metrics.initial_pairs = pair_frequencies.size();
+    }
+
+    // Returns false if no site of the pair was left to merge
+    bool apply_merge_to(std::vector<DLLNode>& tokens, const std::pair<int,int>& merge) {
+        auto itOcc = occurrences.find(merge);
+        if (itOcc == occurrences.end()) {
+            return false;
+        }
+
+        // Sites are taken off the front of the list; removals below may also
+        // take later sites off it, just as they skip them.
+        OccList& indices = itOcc->second;
+        
+        int new_id = vocab_size;
+        bool did_merge = false;
+
+        while (!indices.empty()) {
+            int idx = indices.head;
+            occ_unlink(indices, idx);
+            merge_sites++;
+
+            DLLNode& token = tokens[idx];
+            if (!token.active() || token.next == -1 || token.tok != merge.first) continue;
+
+            DLLNode& next_token = tokens[token.next];
+            if (!next_token.active() || next_token.tok != merge.second) continue;
+
+            did_merge = true;
+
+            // remove occurrences (prev, token), (token, next), (next, next.next)
+            if (token.prev != -1 && tokens[token.prev].active()) {
+                std::pair<int,int> prev_pair(tokens[token.prev].tok, token.tok);
+                occ_remove(prev_pair, token.prev, merge);
+                bump_priority(prev_pair, -token.count);
+            }
+        
+            bump_priority(std::make_pair(token.tok, next_token.tok), -token.count);
+            
+            // (next_token, next_token.next) 
+            if (next_token.next != -1 && tokens[next_token.next].active()) {
+                std::pair<int,int> next_pair(next_token.tok, tokens[next_token.next].tok);
+                occ_remove(next_pair, token.next, merge);
+                bump_priority(next_pair, -token.count);
+            }
+
+            // merge
+            int next_neighbor_idx = next_token.next;
+            token.tok = new_id;
+            token.next = next_neighbor_idx;
+            if (next_neighbor_idx != -1) tokens[next_neighbor_idx].prev = idx;
+            next_token.tok = -1;
+
+            // add new occs. 
+            const int EOW_ID = vocab_to_id[EOW];  // Cache for fast comparison
+            if (token.prev != -1 && tokens[token.prev].active()) {
+                // Only check if tokens are NOT the EOW token (fast integer comparison)
+                if (tokens[token.prev].tok != EOW_ID && token.tok != EOW_ID) {
+                    std::pair<int,int> new_prev_pair(tokens[token.prev].tok, token.tok);
+                    bump_priority(new_prev_pair, token.count);
+                    occ_push_back(new_prev_pair, token.prev);
+                }
+            }
+            if (token.next != -1 && tokens[token.next].active()) {
+                if (token.tok != EOW_ID && tokens[token.next].tok != EOW_ID) {
+                
+                    std::pair<int,int> new_next_pair(token.tok, tokens[token.next].tok);
+                    bump_priority(new_next_pair, token.count);
+                    occ_push_back(new_next_pair, idx);
+                }
+            }
+        }
+
+        if (!did_merge) {
+            return false;
+        }
+
+        // update vocab
+        // The right token never starts a word, so with a continuation prefix
+        // it carries one and the merged token keeps only the left one's
+        std::string new_token_str = id_to_vocab[merge.first] +
+                                    id_to_vocab[merge.second].substr(continuation_prefix.size());
+        vocab_to_id[new_token_str] = new_id;
+        id_to_vocab[new_id] = new_token_str;
+        vocab_size++;
+
+        merges.push_back(merge);
+        occurrences.erase(merge);
+        return true;
+    }
+
+    // Write the whole merge state to `path`. The file is written beside it
+    // and renamed into place, so a crash mid-write keeps the last checkpoint.
+    void save_checkpoint(const std::string& path) {
+        ScopedTimer timer(&metrics.checkpoint_seconds);
+        std::vector<std::array<int32_t, 3>> counts;
+        counts.reserve(pair_frequencies.size());
+        for (const auto& [tok_pair, entry] : pair_frequencies) {
+            if (entry.node->priority > 0) counts.push_back({tok_pair.first, tok_pair.second, entry.node->priority});
+        }
+        std::sort(counts.begin(), counts.end());
+        std::vector<std::array<int32_t, 4>> lists;
+        lists.reserve(occurrences.size());
+        for (const auto& [tok_pair, list] : occurrences) {
+            if (!list.empty()) lists.push_back({tok_pair.first, tok_pair.second, list.head, list.tail});
+        }
+        std::sort(lists.begin(), lists.end());
+        std::vector<std::array<int32_t, 2>> merge_ids;
+        merge_ids.reserve(merges.size());
+        for (const auto& [left, right] : merges) merge_ids.push_back({left, right});
+
+        CheckpointHeader header{};
+        std::memcpy(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+        header.version = kCheckpointVersion;
+        header.pretokenizer = static_cast<uint32_t>(pretokenizer);
+        header.byte_level = byte_level;
+        header.vocab_size = vocab_size;
+        header.num_merges = merges.size();
+        header.num_nodes = train_tokens.size();
+        header.num_pairs = counts.size();
+        header.num_lists = lists.size();
+        header.corpus_bytes = metrics.corpus_bytes;
+        header.corpus_words = metrics.corpus_words;
+        header.unique_words = metrics.unique_words;
+        header.initial_pairs = metrics.initial_pairs;
+
+        const std::string tmp_path = path + ".tmp";
+        CheckpointWriter out(tmp_path);
+        out.put(header);
+        out.put(static_cast<uint32_t>(continuation_prefix.size()));
+        out.write(continuation_prefix.data(), continuation_prefix.size());
+        for (int id = 0; id < vocab_size; ++id) {
+            const std::string& tok = id_to_vocab[id];
+            out.put(static_cast<uint32_t>(tok.size()));
+            out.write(tok.data(), tok.size());
+        }
+        out.write(merge_ids.data(), merge_ids.size() * sizeof(merge_ids[0]));
+        out.write(train_tokens.data(), train_tokens.size() * sizeof(DLLNode));
+        out.write(counts.data(), counts.size() * sizeof(counts[0]));
+        out.write(lists.data(), lists.size() * sizeof(lists[0]));
+        out.finish();
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Failed to replace checkpoint file: " + path);
+        }
+    }
+
+    // Restore the state save_checkpoint() wrote and refill the merge queue
+    // from the saved pair counts
+    void load_checkpoint(const std::string& path) {
+        ScopedTimer timer(&metrics.checkpoint_seconds);
+        CheckpointReader in(path);
+        auto header = in.get<CheckpointHeader>();
+        if (std::memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0) {
+            in.fail("bad magic");
+        }
+        if (header.version != kCheckpointVersion) in.fail("unsupported version");
+        if (header.pretokenizer > static_cast<uint32_t>(PreTokenizer::CharClass)) in.fail("unknown pretokenizer");
+        if (header.vocab_size < 2 || header.num_merges > static_cast<uint64_t>(header.vocab_size)) {
+            in.fail("bad vocab size");
+        }
+        pretokenizer = static_cast<PreTokenizer>(header.pretokenizer);
+        byte_level = header.byte_level != 0;
+        continuation_prefix.assign(in.expect(in.get<uint32_t>(), 1), '\0');
+        in.read(continuation_prefix.data(), continuation_prefix.size());
+
+        for (int id = 0; id < header.vocab_size; ++id) {
+            uint32_t length = in.get<uint32_t>();
+            in.expect(length, 1);
+            std::string tok(length, '\0');
+            in.read(tok.data(), tok.size());
+            vocab_to_id[tok] = id;
+            id_to_vocab[id] = std::move(tok);
+        }
+        vocab_size = header.vocab_size;
+        auto check_id = [&](int id) {
+            if (id < 0 || id >= vocab_size) in.fail("token id out of range");
+            return id;
+        };
+        std::vector<std::array<int32_t, 2>> merge_ids(in.expect(header.num_merges, sizeof(std::array<int32_t, 2>)));
+        in.read(merge_ids.data(), merge_ids.size() * sizeof(merge_ids[0]));
+        merges.reserve(merge_ids.size());
+        for (const auto& [left, right] : merge_ids) {
+            merges.emplace_back(check_id(left), check_id(right));
+        }
+
+        const int64_t n = static_cast<int64_t>(in.expect(header.num_nodes, sizeof(DLLNode)));
+        train_tokens.resize(n);
+        in.read(train_tokens.data(), train_tokens.size() * sizeof(DLLNode));
+        auto check_index = [&](int idx) {
+            if (idx < -1 || idx >= n) in.fail("node index out of range");
+            return idx;
+        };
+        for (const DLLNode& node : train_tokens) {
+            if (node.active()) check_id(node.tok);
+            check_index(node.prev);
+            check_index(node.next);
+            if (node.occ_prev != kUnlinked) check_index(node.occ_prev);
+            check_index(node.occ_next);
+        }
+
+        std::vector<std::array<int32_t, 3>> counts(in.expect(header.num_pairs, sizeof(std::array<int32_t, 3>)));
+        in.read(counts.data(), counts.size() * sizeof(counts[0]));
+        std::vector<std::array<int32_t, 4>> lists(in.expect(header.num_lists, sizeof(std::array<int32_t, 4>)));
+        in.read(lists.data(), lists.size() * sizeof(lists[0]));
+        in.finish();
+
+        std::vector<LazyEntry> entries;
+        for (const auto& [left, right, count] : counts) {
+            std::pair<int, int> tok_pair(check_id(left), check_id(right));
+            HeapNode* node = heap_nodes.make(tok_pair, count);
+            if (queue_kind == MergeQueue::Indexed) {
+                frequency_heap.push(node);
+            } else {
+                entries.push_back({count, tok_pair});
+            }
+            pair_frequencies[tok_pair] = PairEntry{node};
+        }
+        if (queue_kind == MergeQueue::Lazy) {
+            lazy_heap = std::priority_queue<LazyEntry>(std::less<LazyEntry>(), std::move(entries));
+        }
+        for (const auto& [left, right, head, tail] : lists) {
+            occurrences[{check_id(left), check_id(right)}] = OccList{check_index(head), check_index(tail)};
+        }
+
+        metrics.corpus_bytes = header.corpus_bytes;
+        metrics.corpus_words = header.corpus_words;
+        metrics.unique_words = header.unique_words;
+        metrics.initial_pairs = header.initial_pairs;
+    }
+};
+
+Trainer::Trainer() = default;
+Trainer::~Trainer() = default;
+
+Tokenizer Trainer::train(const std::string& raw_data, size_t target_vocab_size,
+                         const TrainOptions& options) {
+    return run(raw_data, target_vocab_size, options, nullptr);
+}
+
+Tokenizer Trainer::train_continue(const Tokenizer& model, const std::string& raw_data,
+                                  size_t target_vocab_size, const TrainOptions& options) {
+    if (!options.resume_from.empty()) {
+        throw std::runtime_error("train_continue() cannot also resume from a checkpoint");
+    }
+    return run(raw_data, target_vocab_size, options, &model);
+}
+
+Tokenizer Trainer::run(const std::string& raw_data, size_t target_vocab_size,
+                       const TrainOptions& options, const Tokenizer* base) {
+    const auto train_start = std::chrono::steady_clock::now();
+    state = std::make_unique<State>();
+    last_metrics = TrainMetrics();
+    State& s = *state;
+    TrainMetrics& m = s.metrics;
+    std::ostream* log = options.log;
+    s.pool = std::make_unique<ThreadPool>(options.num_threads);
+    s.queue_kind = options.queue;
+    s.byte_level = options.byte_level;
+    s.pretokenizer = options.pretokenizer;
+    s.continuation_prefix = options.continuation_prefix;
+    if (!options.resume_from.empty()) {
+        s.load_checkpoint(options.resume_from);
+        if (s.byte_level != options.byte_level || s.pretokenizer != options.pretokenizer ||
+            s.continuation_prefix != options.continuation_prefix) {
+            throw std::runtime_error("Checkpoint " + options.resume_from +
+                                     " was written with different byte_level, pretokenizer or continuation_prefix options");
+        }
+        if (log) {
+            *log << "Resumed from " << options.resume_from << " at merge " << s.merges.size()
+                 << ", vocabulary size " << s.vocab_size << std::endl;
+        }
+    } else {
+        if (base) {
+            s.load_merges(*base);
+            if (log) *log << "Replaying " << s.merges.size() << " merges over the training data..." << std::endl;
+        } else {
+            if (log) *log << "Preprocessing training data..." << std::endl;
+        }
+        s.preprocess_train(raw_data, options.dedup_words);
+        if (log) {
+            *log << " Read " << std::fixed << std::setprecision(1)
+                 << m.corpus_bytes / kMiB << " MiB (" << m.corpus_words
+                 << " words, " << m.unique_words << " unique) in " << std::setprecision(3) << m.preprocess_seconds
+                 << "s, peak RSS " << std::setprecision(1) << peak_rss_bytes() / kMiB << " MiB" << std::endl;
+            *log << " Initial vocabulary size: " << s.vocab_size << std::endl;
+        }
+        s.count_freqs(s.train_tokens);
+    }
+    const bool checkpointing = !options.checkpoint_path.empty();
+
+    TrainProgress progress;
+    progress.target_merges = s.merges.size() + (target_vocab_size > static_cast<size_t>(s.vocab_size)
+                                                     ? target_vocab_size - s.vocab_size : 0);
+    auto report = [&](bool done) {
+        progress.merges = s.merges.size();
+        progress.vocab_size = s.vocab_size;
+        progress.queue_size = s.queue_size();
+        progress.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - train_start).count();
+        progress.last_token = s.merges.empty() ? std::string() : s.id_to_vocab[s.vocab_size - 1];
+        progress.last_count = s.merges.empty() ? 0 : s.merged_count;
+        progress.done = done;
+        if (options.collect_metrics) {
+            m.queue_samples.push_back({progress.merges, progress.elapsed_seconds, progress.queue_size});
+        }
+        if (log && !done) {
+            *log << "  Merge " << progress.merges << "/" << progress.target_merges << ": '" << progress.last_token
+                 << "' (" << progress.last_count << "), queue " << progress.queue_size << ", "
+                 << std::fixed << std::setprecision(2) << progress.elapsed_seconds << "s" << std::endl;
+        }
+        if (options.on_progress) options.on_progress(progress);
+    };
+
+    // Periodic checkpoints are written inside the merge loop but counted
+    // only in checkpoint_seconds.
+    const double checkpoint_seconds_before = m.checkpoint_seconds;
+    {
+        ScopedTimer merge_timer(&m.merge_seconds);
+        while (static_cast<size_t>(s.vocab_size) < target_vocab_size && !s.queue_empty()) {
+            std::chrono::steady_clock::time_point merge_start;
+            if (options.collect_metrics) {
+                merge_start = std::chrono::steady_clock::now();
+                s.merge_sites = 0;
+                s.count_updates = 0;
+            }
+            std::pair<int, int> merge;
+            try {
+                merge = s.get_merge();
+            } catch (const std::runtime_error& e) {
+                if (log) *log << "  No more valid merges available. Stopping at vocab size: " << s.vocab_size << std::endl;
+                break;
+            }
+            if (!s.apply_merge_to(s.train_tokens, merge)) continue;
+            if (options.collect_metrics) {
+                m.merge_ns.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - merge_start).count());
+                m.sites_per_merge.record(s.merge_sites);
+                m.count_updates_per_merge.record(s.count_updates);
+            }
+            if (checkpointing && options.checkpoint_interval > 0 &&
+                s.merges.size() % options.checkpoint_interval == 0) {
+                s.save_checkpoint(options.checkpoint_path);
+            }
+            if (options.progress_interval > 0 && s.merges.size() % options.progress_interval == 0) {
+                report(false);
+            }
+        }
+    }
+    m.merge_seconds -= m.checkpoint_seconds - checkpoint_seconds_before;
+    if (checkpointing) s.save_checkpoint(options.checkpoint_path);
+    report(true);
+
+    m.merges = s.merges.size();
+    m.peak_rss_bytes = peak_rss_bytes();
+    std::vector<std::string> tokens(s.vocab_size);
+    for (const auto& [id, token] : s.id_to_vocab) {
+        tokens[id] = token;
+    }
+    Tokenizer tokenizer(ModelImage::build(tokens, s.merges, s.pretokenizer));
+    m.total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - train_start).count();
+    if (log) m.print(*log);
+    last_metrics = std::move(m);
+    state.reset();
+    return tokenizer;
+}
@@ -0,0 +1,128 @@
+/*
+ * tokenize-server: serve encode/decode requests from one loaded model.
+ *
+ *   tokenize-server --model bpe_model.txt --socket /tmp/tok.sock [options]
+ *   tokenize-server --model bpe_model.txt --port 7070 [options]
+ *
+ * The model is loaded once and shared read-only by every connection. See
+ * tokenize_server.hpp for the wire protocol and bench_server for a load
+ * generator. Runs until SIGINT or SIGTERM, then prints its final stats.
+ */
+#include "bpe.hpp"
+#include "tokenize_server.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    struct Options {
+        std::string model;
+        ServerOptions server;
+        bool tcp = false;
+        double stats_interval = 10;
+    };
+
+    void usage() {
+        std::cerr <<
+            "usage: tokenize-server --model FILE (--socket PATH | --port N) [options]\n"
+            "  --socket PATH        listen on a Unix domain socket\n"
+            "  --port N             listen on 127.0.0.1:N (0 picks a free port)\n"
+            "  --threads N          encoding threads (default: one per core)\n"
+            "  --window-us N        micro-batch window in microseconds (default 200)\n"
+            "  --max-batch N        requests per batch at most (default 64)\n"
+            "  --slo-us N           latency SLO: close batches early to answer within N us\n"
+            "  --stats-interval S   print stats every S seconds, 0 for never (default 10)\n";
+    }
+
+    Options parse_args(int argc, char* argv[]) {
+        Options opts;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--model") opts.model = value();
+            else if (arg == "--socket") opts.server.unix_socket = value();
+            else if (arg == "--port") {
+                opts.server.port = static_cast<uint16_t>(std::stoul(value()));
+                opts.tcp = true;
+            }
+            else if (arg == "--threads") opts.server.threads = std::stoull(value());
+            else if (arg == "--window-us") opts.server.batch_window_us = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--max-batch") opts.server.max_batch = std::stoull(value());
+            else if (arg == "--slo-us") opts.server.slo_us = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--stats-interval") opts.stats_interval = std::stod(value());
+            else if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            else throw std::runtime_error("Unknown option " + arg);
+        }
+        if (opts.model.empty() || opts.server.unix_socket.empty() == !opts.tcp) {
+            usage();
+            std::exit(2);
+        }
+        return opts;
+    }
+
+    void print_stats(const ServerStats& s) {
+        std::cerr << "requests " << s.requests << "  errors " << s.errors << "  qps " << static_cast<uint64_t>(s.qps)
+                  << "  p50 " << s.p50_us << " us  p99 " << s.p99_us << " us  mean batch " << s.mean_batch()
+                  << "  connections " << s.connections << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options opts = parse_args(argc, argv);
+        auto tokenizer = std::make_shared<const Tokenizer>(Tokenizer::load(opts.model));
+
+        // Block the stop signals before any thread starts, so every thread
+        // inherits the mask and only sigtimedwait below receives them.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        TokenizeServer server(tokenizer, opts.server);
+        server.start();
+        if (opts.tcp) {
+            std::cerr << "listening on 127.0.0.1:" << server.port() << "\n";
+        } else {
+            std::cerr << "listening on " << opts.server.unix_socket << "\n";
+        }
+
+        for (;;) {
+            int received;
+            if (opts.stats_interval > 0) {
+                timespec timeout;
+                timeout.tv_sec = static_cast<time_t>(opts.stats_interval);
+                timeout.tv_nsec = static_cast<long>((opts.stats_interval - timeout.tv_sec) * 1e9);
+                received = sigtimedwait(&signals, nullptr, &timeout);
+                if (received < 0) {
+                    print_stats(server.stats());
+                    continue;
+                }
+            } else if (sigwait(&signals, &received) != 0) {
+                continue;
+            }
+            break;
+        }
+        const ServerStats final_stats = server.stats();
+        server.stop();
+        std::cerr << "stopped\n";
+        std::cout << final_stats.to_json() << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "tokenize-server: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * StreamEncoder Implementation
+ * Chunked input held back to the last safe cut, and the istream, fd and
+ * callback drivers
+ */
+#include "stream_encoder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+
+#include <unistd.h>
+
+StreamEncoder::StreamEncoder(const Tokenizer& tokenizer, Sink sink, SpecialTokenPolicy special, size_t block_size,
+                             size_t max_pending)
+    : tokenizer(tokenizer), sink(std::move(sink)), special(std::move(special)),
+      block_size(block_size == 0 ? kDefaultBlockSize : block_size),
+      max_pending(std::max(max_pending, this->block_size)) {
+    // Special tokens take part in cuts unless the policy treats them all as text
+    if (this->special.mode != SpecialTokenPolicy::Mode::None || this->special.reject_disallowed) {
+        for (const std::string& token : tokenizer.special_tokens()) {
+            reach = std::max(reach, token.size());
+            special_start[static_cast<uint8_t>(token[0])] = true;
+        }
+    }
+}
+
+size_t StreamEncoder::drain(std::string_view text, bool at_end) {
+    size_t done = 0;
+    while (done < text.size()) {
+        size_t window = std::min(block_size, text.size() - done);
+        size_t cut;
+        while (true) {
+            const bool last = done + window == text.size();
+            cut = last && at_end ? window : tokenizer.safe_prefix(text.substr(done, window), special);
+            if (cut > 0 || last) break;
+            window = std::min(window * 2, text.size() - done);  // one word fills the window
+        }
+        if (cut == 0) break;
+
+        ids.clear();
+        tokenizer.encode(text.substr(done, cut), ids, nullptr, special);
+        tokens_out += ids.size();
+        if (!ids.empty()) sink(ids);
+        done += cut;
+    }
+    return done;
+}
+
+bool StreamEncoder::may_cut() const {
+    // A cut in the new bytes needs whitespace before it or a special token
+    // at it. A token that settles a cut, or one whose match was still open,
+    // starts at most 2 * reach bytes before them.
+    const size_t from = scanned - std::min(scanned, 2 * reach);
+    return std::any_of(pending.begin() + static_cast<std::ptrdiff_t>(from), pending.end(), [&](char c) {
+        return is_space_byte(c) || special_start[static_cast<uint8_t>(c)];
+    });
+}
+
+void StreamEncoder::force_cut() {
+    // Keep the last `reach` bytes, which may begin a special token, and do
+    // not split a UTF-8 character
+    size_t cut = pending.size() - std::min(pending.size(), reach);
+    for (int i = 0; i < 3 && cut > 0 && (static_cast<uint8_t>(pending[cut]) & 0xC0) == 0x80; ++i) --cut;
+    if (cut == 0) return;
+    drain(std::string_view(pending).substr(0, cut), true);
+    pending.erase(0, cut);
+}
+
+void StreamEncoder::write(std::string_view chunk) {
+    bytes_in += chunk.size();
+    // Complete the held-back word first, a block of the chunk at a time, so
+    // a large chunk is not copied just to finish one word. Only the new bytes
+    // are looked at while the word goes on.
+    while (!pending.empty() && !chunk.empty()) {
+        const size_t take = std::min(chunk.size(), block_size);
+        pending.append(chunk.substr(0, take));
+        chunk.remove_prefix(take);
+        if (may_cut()) pending.erase(0, drain(pending, false));
+        if (pending.size() >= max_pending) force_cut();
+        scanned = pending.size();
+    }
+    if (!chunk.empty()) {
+        pending.assign(chunk.substr(drain(chunk, false)));
+        if (pending.size() >= max_pending) force_cut();
+        scanned = pending.size();
+    }
+}
+
+void StreamEncoder::finish() {
+    drain(pending, true);
+    pending.clear();
+    scanned = 0;
+}
+
+uint64_t encode_stream(const Tokenizer& tokenizer, const std::function<size_t(char* buffer, size_t capacity)>& read,
+                       const StreamEncoder::Sink& sink, const SpecialTokenPolicy& special, size_t block_size) {
+    StreamEncoder encoder(tokenizer, sink, special, block_size);
+    std::vector<char> buffer(block_size == 0 ? StreamEncoder::kDefaultBlockSize : block_size);
+    while (size_t got = read(buffer.data(), buffer.size())) {
+        encoder.write(std::string_view(buffer.data(), got));
+    }
+    encoder.finish();
+    return encoder.tokens_emitted();
+}
+
+uint64_t encode_stream(const Tokenizer& tokenizer, std::istream& in, const StreamEncoder::Sink& sink,
+                       const SpecialTokenPolicy& special, size_t block_size) {
+    auto read = [&](char* buffer, size_t capacity) -> size_t {
+        in.read(buffer, static_cast<std::streamsize>(capacity));
+        return static_cast<size_t>(in.gcount());
+    };
+    return encode_stream(tokenizer, read, sink, special, block_size);
+}
+
+uint64_t encode_stream(const Tokenizer& tokenizer, int fd, const StreamEncoder::Sink& sink,
+                       const SpecialTokenPolicy& special, size_t block_size) {
+    auto read = [&](char* buffer, size_t capacity) -> size_t {
+        while (true) {
+            ssize_t got = ::read(fd, buffer, capacity);
+            if (got >= 0) return static_cast<size_t>(got);
+            if (errno != EINTR) {
+                throw std::runtime_error(std::string("Failed to read input stream: ") + std::strerror(errno));
+            }
+        }
+    };
+    return encode_stream(tokenizer, read, sink, special, block_size);
+}
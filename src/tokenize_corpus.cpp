@@ -0,0 +1,368 @@
+/*
+ * tokenize-corpus: encode a corpus into packed token shards for training.
+ *
+ *   tokenize-corpus --model bpe_model.txt --out shards/ [options] INPUT...
+ *
+ * INPUTs are files or directories (searched recursively, files taken in
+ * sorted path order). Three stages run at once, joined by bounded queues:
+ * a reader cuts files into chunks at safe boundaries, a pool of encoders
+ * turns chunks into ids, and the writer appends them to the shards in input
+ * order. See token_shards.hpp for the output format. Memory stays bounded:
+ * a word (or, with --docs line, a line) longer than four chunks is cut.
+ */
+#include "bounded_queue.hpp"
+#include "bpe.hpp"
+#include "token_shards.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+    enum class DocMode {
+        File,  // each input file is one document
+        Line   // each non-empty line is one document
+    };
+
+    struct Options {
+        std::string model;
+        std::string out;
+        std::vector<std::string> inputs;
+        DocMode docs = DocMode::File;
+        bool eos = false;
+        std::string dtype = "auto";
+        uint64_t shard_tokens = 100'000'000;
+        size_t threads = 0;
+        size_t chunk_bytes = 4u << 20;
+        std::vector<std::string> specials;
+        bool quiet = false;
+    };
+
+    // Encoded chunk: its ids and, within them, where documents end
+    struct Encoded {
+        std::vector<uint32_t> ids;
+        std::vector<size_t> doc_ends;
+    };
+
+    struct Job {
+        std::string text;
+        bool ends_file = false;
+        bool open_line = false;       // line mode: text ends inside a line the next job continues
+        bool continues_line = false;  // line mode: text starts inside the previous job's last line
+        std::promise<Encoded> result;
+    };
+
+    // A word or line with no safe cut is held for at most this many chunks,
+    // which bounds the reader's memory and how often it rescans one buffer
+    constexpr size_t kMaxPendingChunks = 4;
+
+    void usage() {
+        std::cerr <<
+            "usage: tokenize-corpus --model FILE --out DIR [options] INPUT...\n"
+            "  --docs file|line     one document per input file (default) or per non-empty line\n"
+            "  --eos                end every document with <|endoftext|>\n"
+            "  --dtype auto|u16|u32 token width; auto picks u16 when every id fits\n"
+            "  --shard-tokens N     start a new shard after the document that reaches N tokens (default 1e8)\n"
+            "  --threads N          encoding threads (default: one per core)\n"
+            "  --chunk-bytes N      text per encoding job (default 4 MiB)\n"
+            "  --special TOKEN      also match TOKEN as a special token (repeatable)\n"
+            "  --quiet              no progress line\n";
+    }
+
+    Options parse_args(int argc, char* argv[]) {
+        Options opts;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--model") opts.model = value();
+            else if (arg == "--out") opts.out = value();
+            else if (arg == "--docs") {
+                std::string mode = value();
+                if (mode != "file" && mode != "line") throw std::runtime_error("--docs must be file or line");
+                opts.docs = mode == "line" ? DocMode::Line : DocMode::File;
+            }
+            else if (arg == "--eos") opts.eos = true;
+            else if (arg == "--dtype") opts.dtype = value();
+            else if (arg == "--shard-tokens") opts.shard_tokens = std::stoull(value());
+            else if (arg == "--threads") opts.threads = std::stoull(value());
+            else if (arg == "--chunk-bytes") opts.chunk_bytes = std::max<size_t>(1, std::stoull(value()));
+            else if (arg == "--special") opts.specials.push_back(value());
+            else if (arg == "--quiet") opts.quiet = true;
+            else if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            else if (arg.starts_with("--")) throw std::runtime_error("Unknown option " + arg);
+            else opts.inputs.push_back(arg);
+        }
+        if (opts.model.empty() || opts.out.empty() || opts.inputs.empty()) {
+            usage();
+            std::exit(2);
+        }
+        if (opts.dtype != "auto" && opts.dtype != "u16" && opts.dtype != "u32") {
+            throw std::runtime_error("--dtype must be auto, u16 or u32");
+        }
+        return opts;
+    }
+
+    std::vector<std::string> list_files(const std::vector<std::string>& inputs) {
+        std::vector<std::string> files;
+        for (const std::string& input : inputs) {
+            if (std::filesystem::is_directory(input)) {
+                std::vector<std::string> found;
+                for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
+                    if (entry.is_regular_file()) found.push_back(entry.path().string());
+                }
+                std::sort(found.begin(), found.end());
+                files.insert(files.end(), found.begin(), found.end());
+            } else if (std::filesystem::exists(input)) {
+                files.push_back(input);
+            } else {
+                throw std::runtime_error("No such input: " + input);
+            }
+        }
+        return files;
+    }
+
+    // Where to cut a buffer that has no safe cut and has reached the limit:
+    // near the end, but keeping the last `reach` bytes, which may begin a
+    // special token, and not inside a UTF-8 character. The word cut there
+    // gets different ids, as with StreamEncoder's max_pending.
+    size_t forced_cut(std::string_view buffer, size_t reach) {
+        size_t cut = buffer.size() - std::min(buffer.size(), reach);
+        for (int i = 0; i < 3 && cut > 0 && (static_cast<uint8_t>(buffer[cut]) & 0xC0) == 0x80; ++i) --cut;
+        return cut;
+    }
+
+    // Cut files into jobs of about chunk_bytes. A cut must not change the
+    // ids: in line mode it falls after a newline, otherwise at the tokenizer's
+    // safe_prefix(). Only a word or line longer than kMaxPendingChunks chunks
+    // is cut anyway. Jobs go to the encoders and, in the same order, to the writer.
+    void read_files(const std::vector<std::string>& files, const Options& opts, const Tokenizer& tokenizer,
+                    BoundedQueue<std::shared_ptr<Job>>& work, BoundedQueue<std::shared_ptr<Job>>& ordered,
+                    std::atomic<uint64_t>& bytes_read) {
+        const size_t max_pending = kMaxPendingChunks * opts.chunk_bytes;
+        size_t reach = 0;
+        for (const std::string& token : tokenizer.special_tokens()) reach = std::max(reach, token.size());
+        std::string buffer;
+        for (const std::string& path : files) {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open input file: " + path);
+            }
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            buffer.clear();
+            bool at_eof = false;
+            bool line_open = false;
+            while (!at_eof) {
+                size_t filled = buffer.size();
+                buffer.resize(filled + opts.chunk_bytes);
+                ssize_t got = ::read(fd, buffer.data() + filled, opts.chunk_bytes);
+                if (got < 0 && errno == EINTR) {
+                    buffer.resize(filled);
+                    continue;
+                }
+                if (got < 0) {
+                    ::close(fd);
+                    throw std::runtime_error("Failed to read " + path + ": " + std::strerror(errno));
+                }
+                buffer.resize(filled + got);
+                bytes_read += got;
+                at_eof = got == 0;
+                if (!at_eof && buffer.size() < opts.chunk_bytes) continue;
+
+                size_t cut = buffer.size();
+                bool forced = false;
+                if (!at_eof) {
+                    if (opts.docs == DocMode::Line) {
+                        size_t nl = buffer.rfind('\n');
+                        cut = nl == std::string::npos ? 0 : nl + 1;
+                    } else {
+                        cut = tokenizer.safe_prefix(buffer);
+                    }
+                    if (cut == 0 && buffer.size() >= max_pending) {
+                        cut = forced_cut(buffer, reach);
+                        forced = true;
+                    }
+                    if (cut == 0) continue;  // one word or line fills the buffer; read more
+                }
+                auto job = std::make_shared<Job>();
+                job->text.assign(buffer, 0, cut);
+                job->ends_file = at_eof;
+                job->continues_line = line_open;
+                job->open_line = line_open = forced && opts.docs == DocMode::Line;
+                buffer.erase(0, cut);
+                if (!ordered.push(job) || !work.push(job)) {
+                    ::close(fd);
+                    return;  // the writer stopped
+                }
+            }
+            ::close(fd);
+        }
+    }
+
+    Encoded encode_job(const Job& job, const Options& opts, const Tokenizer& tokenizer, uint32_t eos) {
+        Encoded out;
+        if (opts.docs == DocMode::File) {
+            tokenizer.encode(job.text, out.ids);
+            if (job.ends_file) {
+                if (opts.eos) out.ids.push_back(eos);
+                out.doc_ends.push_back(out.ids.size());
+            }
+            return out;
+        }
+        // A line cut across jobs is one document: its pieces are encoded
+        // separately and it ends in the job holding its last piece.
+        std::string_view text = job.text;
+        bool first = true;
+        while (!text.empty()) {
+            size_t nl = text.find('\n');
+            std::string_view line = text.substr(0, nl);
+            text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+            const bool continued = first && job.continues_line;
+            const bool open = nl == std::string_view::npos && job.open_line;
+            first = false;
+            if (!continued && !open && line.find_first_not_of(" \t\v\f\r") == std::string_view::npos) continue;
+            tokenizer.encode(line, out.ids);
+            if (open) break;
+            if (opts.eos) out.ids.push_back(eos);
+            out.doc_ends.push_back(out.ids.size());
+        }
+        if (first && job.continues_line) {
+            // The cut fell at the very end of the line's text
+            if (opts.eos) out.ids.push_back(eos);
+            out.doc_ends.push_back(out.ids.size());
+        }
+        return out;
+    }
+
+    void report(std::ostream& out, const char* prefix, uint64_t bytes, uint64_t tokens, double seconds) {
+        const double secs = std::max(seconds, 1e-9);
+        out << prefix << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MiB, " << tokens
+            << " tokens in " << seconds << "s (" << bytes / (1024.0 * 1024.0) / secs << " MiB/s, "
+            << std::setprecision(0) << tokens / secs << " tokens/s)";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options opts = parse_args(argc, argv);
+        Tokenizer tokenizer = Tokenizer::load(opts.model);
+        tokenizer.add_special_tokens(opts.specials);
+        const int eos = tokenizer.special_token_id(EOS);
+        if (opts.eos && eos < 0) {
+            throw std::runtime_error("--eos: the model has no " + EOS + " token");
+        }
+
+        // Largest possible id: past the vocab come raw bytes, then added special tokens
+        uint64_t max_id = tokenizer.vocab_size() + 255;
+        for (const std::string& tok : tokenizer.special_tokens()) {
+            max_id = std::max<uint64_t>(max_id, tokenizer.special_token_id(tok));
+        }
+        const bool fits_u16 = max_id <= UINT16_MAX;
+        if (opts.dtype == "u16" && !fits_u16) {
+            std::cerr << "warning: ids up to " << max_id << " may not fit u16; an id that does not is an error\n";
+        }
+        const TokenWidth width = opts.dtype == "u32" || (opts.dtype == "auto" && !fits_u16) ? TokenWidth::U32
+                                                                                              : TokenWidth::U16;
+
+        const std::vector<std::string> files = list_files(opts.inputs);
+        const size_t threads = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+        // Jobs in flight are bounded by the ordered queue: the reader waits
+        // for the writer once 2 jobs per encoder are queued.
+        BoundedQueue<std::shared_ptr<Job>> work(2 * threads);
+        BoundedQueue<std::shared_ptr<Job>> ordered(2 * threads);
+        std::atomic<uint64_t> bytes_read{0};
+
+        std::promise<void> reader_done;
+        std::thread reader([&] {
+            try {
+                read_files(files, opts, tokenizer, work, ordered, bytes_read);
+                reader_done.set_value();
+            } catch (...) {
+                reader_done.set_exception(std::current_exception());
+            }
+            work.close();
+            ordered.close();
+        });
+        std::vector<std::thread> encoders;
+        for (size_t t = 0; t < threads; ++t) {
+            encoders.emplace_back([&] {
+                std::shared_ptr<Job> job;
+                while (work.pop(job)) {
+                    try {
+                        job->result.set_value(encode_job(*job, opts, tokenizer, eos));
+                    } catch (...) {
+                        job->result.set_exception(std::current_exception());
+                    }
+                    job->text = std::string();
+                }
+            });
+        }
+
+        // Write in input order; stop everything on the first error.
+        TokenShardWriter writer(opts.out, width, opts.shard_tokens);
+        const auto start = std::chrono::steady_clock::now();
+        auto elapsed = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+        double last_report = 0;
+        std::exception_ptr error;
+        try {
+            std::shared_ptr<Job> job;
+            while (ordered.pop(job)) {
+                Encoded encoded = job->result.get_future().get();
+                size_t at = 0;
+                for (size_t end : encoded.doc_ends) {
+                    writer.write(std::span(encoded.ids).subspan(at, end - at));
+                    writer.end_document();
+                    at = end;
+                }
+                writer.write(std::span(encoded.ids).subspan(at));
+                if (!opts.quiet && elapsed() - last_report >= 1.0) {
+                    last_report = elapsed();
+                    report(std::cerr, "\r", bytes_read, writer.tokens(), last_report);
+                    std::cerr << std::flush;
+                }
+            }
+            writer.finish();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        work.close();
+        ordered.close();
+        reader.join();
+        for (std::thread& t : encoders) t.join();
+        if (error) std::rethrow_exception(error);
+        reader_done.get_future().get();
+
+        if (!opts.quiet) {
+            report(std::cerr, "\r", bytes_read, writer.tokens(), elapsed());
+            std::cerr << "\n";
+        }
+        std::cout << files.size() << " files, " << writer.documents() << " documents, " << writer.tokens()
+                  << " tokens in " << writer.shards() << " shard(s) of " << (width == TokenWidth::U16 ? "u16" : "u32")
+                  << " under " << opts.out << "\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "\ntokenize-corpus: " << e.what() << "\n";
+        return 1;
+    }
+}
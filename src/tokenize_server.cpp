@@ -0,0 +1,596 @@
+/*
+ * TokenizeServer Implementation
+ * Socket setup, per-connection readers and writers, the micro-batching
+ * loop with its SLO deadline, latency stats and the blocking client
+ */
+#include "tokenize_server.hpp"
+
+#include "bounded_queue.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using server_protocol::Op;
+using server_protocol::Status;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // macOS: SO_NOSIGPIPE is set on each socket instead
+#endif
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Latency samples kept for the percentiles and the recent QPS
+    constexpr size_t kLatencyWindow = 1u << 16;
+
+    // Requests of one connection queued, being encoded or waiting to be
+    // sent; past this its reader stops reading until the client catches up
+    constexpr size_t kMaxInFlight = 256;
+
+    // Close-on-exec, and no SIGPIPE on writes to a closed peer
+    int prepare_socket(int fd) {
+        if (fd < 0) return fd;
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        return fd;
+    }
+
+    bool write_all(int fd, const char* data, size_t n) {
+        while (n > 0) {
+            ssize_t sent = ::send(fd, data, n, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += sent;
+            n -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool read_all(int fd, char* data, size_t n) {
+        while (n > 0) {
+            ssize_t got = ::recv(fd, data, n, 0);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            data += got;
+            n -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    std::string make_frame(uint8_t head, std::string_view payload) {
+        const uint32_t length = static_cast<uint32_t>(payload.size() + 1);
+        std::string frame(sizeof(length) + length, '\0');
+        std::memcpy(frame.data(), &length, sizeof(length));
+        frame[sizeof(length)] = static_cast<char>(head);
+        std::memcpy(frame.data() + sizeof(length) + 1, payload.data(), payload.size());
+        return frame;
+    }
+
+    bool send_frame(int fd, uint8_t head, std::string_view payload) {
+        const std::string frame = make_frame(head, payload);
+        return write_all(fd, frame.data(), frame.size());
+    }
+
+    // False at end of stream, on an error or on a frame that is empty or too large
+    bool read_frame(int fd, uint8_t& head, std::string& payload) {
+        uint32_t length;
+        if (!read_all(fd, reinterpret_cast<char*>(&length), sizeof(length))) return false;
+        if (length == 0 || length > server_protocol::kMaxFrame) return false;
+        if (!read_all(fd, reinterpret_cast<char*>(&head), 1)) return false;
+        payload.resize(length - 1);
+        return read_all(fd, payload.data(), payload.size());
+    }
+
+    double micros(Clock::duration d) {
+        return std::chrono::duration<double, std::micro>(d).count();
+    }
+}
+
+/*
+ * One client. Its reader thread queues requests for the batcher, and its
+ * writer thread sends the responses the batcher hands back, so a client
+ * that is slow to read only holds up its own writer. The reader admits at
+ * most kMaxInFlight requests ahead of the writer, which bounds the
+ * responses waiting here and means handing one over never blocks.
+ */
+struct TokenizeServer::Connection {
+    int fd;
+    std::thread reader;
+    std::thread writer;
+    std::atomic<int> running{2};  // reader and writer; 0 once both have returned
+
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<std::string> replies;  // frames ready to send
+    size_t in_flight = 0;             // admitted and not yet sent
+    bool reading = true;
+    bool closed = false;              // stop, or the client is gone: drop everything
+
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    // Reader: wait for room for one more request. False once closed
+    bool admit() {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [&] { return closed || in_flight < kMaxInFlight; });
+        if (closed) return false;
+        ++in_flight;
+        return true;
+    }
+
+    // Batcher: queue the response to an admitted request
+    void reply(std::string frame) {
+        std::lock_guard<std::mutex> lock(mu);
+        if (closed) return;
+        replies.push_back(std::move(frame));
+        cv.notify_all();
+    }
+
+    // Writer: take the next frame to send. False when closed, or when the
+    // reader has stopped and every admitted request has been answered
+    bool next(std::string& frame) {
+        std::unique_lock<std::mutex> lock(mu);
+        cv.wait(lock, [&] { return closed || !replies.empty() || (!reading && in_flight == 0); });
+        if (closed || replies.empty()) return false;
+        frame = std::move(replies.front());
+        replies.pop_front();
+        return true;
+    }
+
+    // Writer: one frame has gone out
+    void sent() {
+        std::lock_guard<std::mutex> lock(mu);
+        --in_flight;
+        cv.notify_all();
+    }
+
+    void stop_reading() {
+        std::lock_guard<std::mutex> lock(mu);
+        reading = false;
+        cv.notify_all();
+    }
+
+    // Drop queued responses, stop both threads and wake any blocked on the socket
+    void close() {
+        std::lock_guard<std::mutex> lock(mu);
+        closed = true;
+        replies.clear();
+        cv.notify_all();
+        if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+    }
+
+    // Reader or writer, on return. The last one out closes the socket at
+    // once, rather than leaving it in CLOSE_WAIT until the connection is
+    // reaped, and writes to `wake` so the accept loop reaps it.
+    void thread_done(int wake) {
+        if (--running > 0) return;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            ::close(fd);
+            fd = -1;
+        }
+        char byte = 0;
+        while (::write(wake, &byte, 1) < 0 && errno == EINTR) {}
+    }
+};
+
+struct TokenizeServer::Request {
+    std::shared_ptr<Connection> conn;
+    Op op;
+    std::string payload;
+    Clock::time_point arrival;
+    Status status = Status::Ok;
+    std::string response;
+};
+
+struct TokenizeServer::State {
+    int listen_fd = -1;
+    int wake[2] = {-1, -1};  // wakes the accept loop: to stop, or to reap a closed connection
+    std::atomic<bool> stopping{false};
+    BoundedQueue<std::unique_ptr<Request>> queue{4096};
+    ThreadPool pool;
+    std::thread acceptor;
+    std::thread batcher;
+    std::mutex conn_mu;
+    std::vector<std::shared_ptr<Connection>> conns;
+    Clock::time_point started = Clock::now();
+    double batch_us = 0;  // moving average of batch encode time, batcher only
+
+    mutable std::mutex stats_mu;
+    ServerStats totals;
+    std::vector<float> latency_us;         // ring of the last kLatencyWindow requests
+    std::vector<Clock::time_point> done_at;
+    size_t ring_next = 0;
+
+    explicit State(size_t threads) : pool(threads) {}
+};
+
+std::string ServerStats::to_json() const {
+    std::ostringstream out;
+    out << "{\"requests\":" << requests << ",\"errors\":" << errors << ",\"batches\":" << batches
+        << ",\"mean_batch\":" << mean_batch() << ",\"connections\":" << connections
+        << ",\"uptime_s\":" << uptime_seconds << ",\"qps\":" << qps << ",\"p50_us\":" << p50_us
+        << ",\"p99_us\":" << p99_us << ",\"max_us\":" << max_us << "}";
+    return out.str();
+}
+
+TokenizeServer::TokenizeServer(std::shared_ptr<const Tokenizer> tokenizer, ServerOptions options)
+    : tokenizer(std::move(tokenizer)), opts(std::move(options)) {
+    if (!this->tokenizer) {
+        throw std::runtime_error("TokenizeServer needs a tokenizer");
+    }
+    opts.max_batch = std::max<size_t>(1, opts.max_batch);
+}
+
+TokenizeServer::~TokenizeServer() {
+    stop();
+}
+
+void TokenizeServer::start() {
+    if (state) {
+        throw std::runtime_error("TokenizeServer already started");
+    }
+    auto st = std::make_unique<State>(opts.threads);
+    if (!opts.unix_socket.empty()) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (opts.unix_socket.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Unix socket path too long: " + opts.unix_socket);
+        }
+        std::memcpy(addr.sun_path, opts.unix_socket.c_str(), opts.unix_socket.size() + 1);
+        st->listen_fd = prepare_socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+        ::unlink(opts.unix_socket.c_str());
+        if (st->listen_fd < 0 || ::bind(st->listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (st->listen_fd >= 0) ::close(st->listen_fd);
+            throw std::runtime_error("Failed to bind " + opts.unix_socket + ": " + std::strerror(errno));
+        }
+    } else {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(opts.port);
+        st->listen_fd = prepare_socket(::socket(AF_INET, SOCK_STREAM, 0));
+        int one = 1;
+        if (st->listen_fd >= 0) ::setsockopt(st->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (st->listen_fd < 0 || ::bind(st->listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (st->listen_fd >= 0) ::close(st->listen_fd);
+            throw std::runtime_error("Failed to bind 127.0.0.1:" + std::to_string(opts.port) + ": " + std::strerror(errno));
+        }
+        socklen_t len = sizeof(addr);
+        ::getsockname(st->listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+        bound_port = ntohs(addr.sin_port);
+    }
+    if (::listen(st->listen_fd, 128) != 0) {
+        ::close(st->listen_fd);
+        throw std::runtime_error(std::string("Failed to listen: ") + std::strerror(errno));
+    }
+    if (::pipe(st->wake) != 0) {
+        ::close(st->listen_fd);
+        throw std::runtime_error(std::string("Failed to create pipe: ") + std::strerror(errno));
+    }
+    ::fcntl(st->wake[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(st->wake[1], F_SETFD, FD_CLOEXEC);
+    ::fcntl(st->wake[1], F_SETFL, O_NONBLOCK);  // a full pipe wakes the loop all the same
+    st->latency_us.resize(kLatencyWindow);
+    st->done_at.resize(kLatencyWindow);
+    state = std::move(st);
+    state->acceptor = std::thread(&TokenizeServer::accept_loop, this);
+    state->batcher = std::thread(&TokenizeServer::batch_loop, this);
+}
+
+void TokenizeServer::stop() {
+    if (!state) return;
+    state->stopping = true;
+    char byte = 0;
+    while (::write(state->wake[1], &byte, 1) < 0 && errno == EINTR) {}
+    state->acceptor.join();
+    ::close(state->listen_fd);
+    if (!opts.unix_socket.empty()) ::unlink(opts.unix_socket.c_str());
+
+    // Readers may be blocked on the socket, on a full queue or on their
+    // in-flight limit, and writers on the socket or on an empty outbox.
+    for (auto& conn : state->conns) conn->close();
+    state->queue.close();
+    for (auto& conn : state->conns) {
+        conn->reader.join();
+        conn->writer.join();
+    }
+    state->batcher.join();
+    ::close(state->wake[0]);  // connection threads write to it until they return
+    ::close(state->wake[1]);
+    state.reset();
+}
+
+void TokenizeServer::reap_connections() {
+    std::lock_guard<std::mutex> lock(state->conn_mu);
+    auto& conns = state->conns;
+    for (auto it = conns.begin(); it != conns.end();) {
+        if ((*it)->running == 0) {
+            (*it)->reader.join();
+            (*it)->writer.join();
+            it = conns.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void TokenizeServer::accept_loop() {
+    pollfd fds[2] = {{state->listen_fd, POLLIN, 0}, {state->wake[0], POLLIN, 0}};
+    while (!state->stopping) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) {
+            char bytes[64];
+            if (state->stopping || ::read(state->wake[0], bytes, sizeof(bytes)) <= 0) break;
+            reap_connections();
+        }
+        if (!(fds[0].revents & POLLIN)) continue;
+        int fd = prepare_socket(::accept(state->listen_fd, nullptr, nullptr));
+        if (fd < 0) {
+            if (state->stopping) break;
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) continue;
+            break;
+        }
+        if (opts.unix_socket.empty()) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        auto conn = std::make_shared<Connection>(fd);
+        std::lock_guard<std::mutex> lock(state->conn_mu);
+        conn->reader = std::thread(&TokenizeServer::read_loop, this, conn);
+        conn->writer = std::thread(&TokenizeServer::write_loop, this, conn);
+        state->conns.push_back(std::move(conn));
+        std::lock_guard<std::mutex> stats_lock(state->stats_mu);
+        state->totals.connections++;
+    }
+}
+
+void TokenizeServer::read_loop(std::shared_ptr<Connection> conn) {
+    uint8_t head;
+    std::string payload;
+    while (read_frame(conn->fd, head, payload) && conn->admit()) {
+        auto request = std::make_unique<Request>();
+        request->conn = conn;
+        request->op = static_cast<Op>(head);
+        request->payload = std::move(payload);
+        request->arrival = Clock::now();
+        if (!state->queue.push(std::move(request))) break;
+    }
+    conn->stop_reading();
+    conn->thread_done(state->wake[1]);
+}
+
+void TokenizeServer::write_loop(std::shared_ptr<Connection> conn) {
+    std::string frame;
+    while (conn->next(frame)) {
+        if (!write_all(conn->fd, frame.data(), frame.size())) {
+            conn->close();  // the client is gone; its reader stops too
+            break;
+        }
+        conn->sent();
+    }
+    conn->thread_done(state->wake[1]);
+}
+
+void TokenizeServer::batch_loop() {
+    const auto window = std::chrono::microseconds(opts.batch_window_us);
+    const auto slo = std::chrono::microseconds(opts.slo_us);
+    std::vector<std::unique_ptr<Request>> batch;
+    std::unique_ptr<Request> request;
+
+    while (state->queue.pop(request)) {
+        batch.clear();
+        batch.push_back(std::move(request));
+        // Hold the batch open for the window, or, in SLO mode, only as long
+        // as the oldest request can wait and still be answered in time.
+        Clock::time_point deadline = batch.front()->arrival + window;
+        if (opts.slo_us > 0) {
+            auto budget = slo - std::chrono::microseconds(static_cast<int64_t>(state->batch_us));
+            deadline = std::min(deadline, batch.front()->arrival + budget);
+        }
+        while (batch.size() < opts.max_batch && state->queue.pop_until(request, deadline)) {
+            batch.push_back(std::move(request));
+        }
+
+        const Clock::time_point begin = Clock::now();
+        state->pool.parallel_for(batch.size(), 1, [&](size_t first, size_t last) {
+            std::vector<uint32_t> ids;
+            for (size_t i = first; i < last; ++i) {
+                Request& r = *batch[i];
+                try {
+                    switch (r.op) {
+                        case Op::Encode:
+                            ids.clear();
+                            tokenizer->encode(r.payload, ids);
+                            r.response.assign(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(uint32_t));
+                            break;
+                        case Op::Decode:
+                            if (r.payload.size() % sizeof(uint32_t) != 0) {
+                                throw std::runtime_error("decode: payload is not a whole number of uint32 ids");
+                            }
+                            ids.resize(r.payload.size() / sizeof(uint32_t));
+                            std::memcpy(ids.data(), r.payload.data(), r.payload.size());
+                            r.response = tokenizer->decode(ids);
+                            break;
+                        case Op::Stats:
+                            r.response = stats().to_json();
+                            break;
+                        default:
+                            throw std::runtime_error("unknown op " + std::to_string(static_cast<int>(r.op)));
+                    }
+                    if (r.response.size() + 1 > server_protocol::kMaxFrame) {
+                        throw std::runtime_error("response of " + std::to_string(r.response.size()) +
+                                                 " bytes exceeds the frame limit");
+                    }
+                } catch (const std::exception& e) {
+                    r.status = Status::Error;
+                    r.response = e.what();
+                }
+            }
+        });
+        const double batch_us = micros(Clock::now() - begin);
+        state->batch_us = state->batch_us == 0 ? batch_us : 0.9 * state->batch_us + 0.1 * batch_us;
+
+        // Count the batch before answering it, so a client that has its
+        // response also sees it in the stats.
+        const Clock::time_point now = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(state->stats_mu);
+            state->totals.requests += batch.size();
+            state->totals.batches++;
+            for (const auto& r : batch) {
+                state->totals.errors += r->status != Status::Ok;
+                state->latency_us[state->ring_next % kLatencyWindow] = static_cast<float>(micros(now - r->arrival));
+                state->done_at[state->ring_next % kLatencyWindow] = now;
+                state->ring_next++;
+            }
+        }
+        for (const auto& r : batch) {
+            r->conn->reply(make_frame(static_cast<uint8_t>(r->status), r->response));
+        }
+    }
+}
+
+ServerStats TokenizeServer::stats() const {
+    ServerStats s;
+    if (!state) return s;
+    std::vector<float> recent;
+    Clock::time_point oldest, newest;
+    {
+        std::lock_guard<std::mutex> lock(state->stats_mu);
+        s = state->totals;
+        const size_t n = std::min(state->ring_next, kLatencyWindow);
+        recent.assign(state->latency_us.begin(), state->latency_us.begin() + n);
+        if (n > 0) {
+            newest = state->done_at[(state->ring_next - 1) % kLatencyWindow];
+            oldest = state->done_at[(state->ring_next - n) % kLatencyWindow];
+        }
+    }
+    s.uptime_seconds = std::chrono::duration<double>(Clock::now() - state->started).count();
+    if (recent.empty()) return s;
+
+    auto percentile = [&](double p) {
+        auto nth = recent.begin() + static_cast<size_t>(p * (recent.size() - 1));
+        std::nth_element(recent.begin(), nth, recent.end());
+        return static_cast<double>(*nth);
+    };
+    s.p50_us = percentile(0.5);
+    s.p99_us = percentile(0.99);
+    s.max_us = *std::max_element(recent.begin(), recent.end());
+    const double span = std::chrono::duration<double>(newest - oldest).count();
+    s.qps = span > 0 && recent.size() > 1 ? (recent.size() - 1) / span
+                                          : s.requests / std::max(s.uptime_seconds, 1e-9);
+    return s;
+}
+
+TokenizeClient TokenizeClient::connect_unix(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Unix socket path too long: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = prepare_socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Failed to connect to " + path + ": " + std::strerror(errno));
+    }
+    return TokenizeClient(fd);
+}
+
+TokenizeClient TokenizeClient::connect_tcp(uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    int fd = prepare_socket(::socket(AF_INET, SOCK_STREAM, 0));
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("Failed to connect to 127.0.0.1:" + std::to_string(port) + ": " + std::strerror(errno));
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return TokenizeClient(fd);
+}
+
+TokenizeClient::~TokenizeClient() {
+    if (fd >= 0) ::close(fd);
+}
+
+TokenizeClient::TokenizeClient(TokenizeClient&& other) noexcept : fd(std::exchange(other.fd, -1)) {}
+
+TokenizeClient& TokenizeClient::operator=(TokenizeClient&& other) noexcept {
+    if (this != &other) {
+        if (fd >= 0) ::close(fd);
+        fd = std::exchange(other.fd, -1);
+    }
+    return *this;
+}
+
+void TokenizeClient::send(Op op, std::string_view payload) {
+    if (payload.size() + 1 > server_protocol::kMaxFrame) {
+        throw std::runtime_error("Request too large");
+    }
+    if (!send_frame(fd, static_cast<uint8_t>(op), payload)) {
+        throw std::runtime_error(std::string("Failed to send request: ") + std::strerror(errno));
+    }
+}
+
+std::string TokenizeClient::receive() {
+    uint8_t status;
+    std::string payload;
+    if (!read_frame(fd, status, payload)) {
+        throw std::runtime_error("Connection to the tokenize server closed");
+    }
+    if (static_cast<Status>(status) != Status::Ok) {
+        throw std::runtime_error("Tokenize server error: " + payload);
+    }
+    return payload;
+}
+
+std::vector<uint32_t> TokenizeClient::encode(std::string_view text) {
+    send(Op::Encode, text);
+    std::string payload = receive();
+    std::vector<uint32_t> ids(payload.size() / sizeof(uint32_t));
+    std::memcpy(ids.data(), payload.data(), ids.size() * sizeof(uint32_t));
+    return ids;
+}
+
+std::string TokenizeClient::decode(std::span<const uint32_t> ids) {
+    send(Op::Decode, std::string_view(reinterpret_cast<const char*>(ids.data()), ids.size_bytes()));
+    return receive();
+}
+
+std::string TokenizeClient::stats_json() {
+    send(Op::Stats, {});
+    return receive();
+}
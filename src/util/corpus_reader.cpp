@@ -0,0 +1,98 @@
+/*
+ * CorpusReader Implementation
+ * Block-at-a-time file reader; blocks are split by the pre-tokenizer
+ */
+#include "corpus_reader.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CorpusReader::CorpusReader(const std::string& path, size_t block_size, PreTokenizer mode)
+    : block_size(block_size == 0 ? kDefaultBlockSize : block_size), mode(mode) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open training file: " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        size = static_cast<uint64_t>(st.st_size);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+}
+
+CorpusReader::~CorpusReader() {
+    if (fd >= 0) ::close(fd);
+}
+
+size_t CorpusReader::fill() {
+    // Move the unfinished word of the last block to the front.
+    if (carry > 0 && pending > 0) {
+        std::memmove(buffer.data(), buffer.data() + pending, carry);
+    }
+    pending = 0;
+    if (buffer.size() < carry + block_size) {
+        buffer.resize(carry + block_size);
+    }
+
+    size_t filled = carry;
+    while (filled < carry + block_size) {
+        ssize_t got = ::read(fd, buffer.data() + filled, carry + block_size - filled);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("Failed to read training file: ") + std::strerror(errno));
+        }
+        if (got == 0) {
+            at_eof = true;
+            break;
+        }
+        filled += static_cast<size_t>(got);
+    }
+    consumed += filled - carry;
+    return filled;
+}
+
+bool CorpusReader::next(std::vector<std::string_view>& words) {
+    words.clear();
+    while (words.empty()) {
+        if (at_eof) return false;
+
+        size_t word_start = carry;
+        size_t filled = fill();
+        size_t tail = pretokenize_block(buffer.data(), word_start, filled, mode, at_eof, words);
+        pending = tail;
+        carry = filled - tail;
+    }
+    return true;
+}
+
+bool CorpusReader::next_chunk(std::vector<char>& chunk) {
+    while (!at_eof) {
+        size_t filled = fill();
+        size_t cut = filled;
+        if (!at_eof) {
+            while (cut > 0 && !is_space_byte(buffer[cut - 1])) --cut;
+        }
+        if (cut == 0) {
+            // No whitespace yet: the whole block is one unfinished word.
+            carry = filled;
+            continue;
+        }
+        chunk.assign(buffer.data(), buffer.data() + cut);
+        pending = cut;
+        carry = filled - cut;
+        return true;
+    }
+    return false;
+}
+
+size_t peak_rss_bytes() {
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // Linux reports KiB
+}
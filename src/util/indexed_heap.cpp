@@ -1,147 +1,127 @@
 /*
  * IndexedHeap Implementation
- * A max heap with O(1) priority updates using node pointers
+ * A d-ary max heap with O(log n) priority updates using node pointers
  * Nodes track their own heap position for efficient updates
- * THIS WAS VIBECODED. 
  */
 #include "indexed_heap.hpp"
-#include <algorithm>
 #include <stdexcept>
 
-void IndexedHeap::bubbleUp(int idx) {
+template <int Arity>
+void DaryIndexedHeap<Arity>::siftUp(size_t idx) {
+    HeapNode* node = heap[idx];
     while (idx > 0) {
-        int parent = (idx - 1) / 2;
-        if (heap[idx]->priority > heap[parent]->priority) {
-            swapNodes(idx, parent);
-            idx = parent;
-        } else {
-            break;
-        }
+        size_t parent = (idx - 1) / Arity;
+        if (!before(node, heap[parent])) break;
+        place(heap[parent], idx);
+        idx = parent;
     }
+    place(node, idx);
 }
 
-void IndexedHeap::bubbleDown(int idx) {
-    int n = heap.size();
+template <int Arity>
+void DaryIndexedHeap<Arity>::siftDown(size_t idx) {
+    HeapNode* node = heap[idx];
+    const size_t n = heap.size();
     while (true) {
-        int largest = idx;
-        int left = 2 * idx + 1;
-        int right = 2 * idx + 2;
-
-        if (left < n && heap[left]->priority > heap[largest]->priority) {
-            largest = left;
-        }
-        if (right < n && heap[right]->priority > heap[largest]->priority) {
-            largest = right;
-        }
-
-        if (largest != idx) {
-            swapNodes(idx, largest);
-            idx = largest;
-        } else {
-            break;
+        size_t first = idx * Arity + 1;
+        if (first >= n) break;
+        size_t last = first + Arity < n ? first + Arity : n;
+        size_t best = first;
+        for (size_t child = first + 1; child < last; ++child) {
+            if (before(heap[child], heap[best])) best = child;
         }
+        if (!before(heap[best], node)) break;
+        place(heap[best], idx);
+        idx = best;
     }
+    place(node, idx);
 }
 
-void IndexedHeap::swapNodes(int i, int j) {
-    nodeToIndex[heap[i]] = j;
-    nodeToIndex[heap[j]] = i;
-    std::swap(heap[i], heap[j]);
-}
-
-void IndexedHeap::push(HeapNode* node) {
-    if (nodeToIndex.find(node) != nodeToIndex.end()) {
+template <int Arity>
+void DaryIndexedHeap<Arity>::push(HeapNode* node) {
+    if (node->heap_index >= 0) {
         // Node is already in the heap, just update its position
         updatePriority(node, node->priority);
         return;
     }
-    nodeToIndex[node] = heap.size();
     heap.push_back(node);
-    bubbleUp(heap.size() - 1);
+    siftUp(heap.size() - 1);
 }
 
-void IndexedHeap::updatePriority(HeapNode* node, int newPriority) {
-    auto it = nodeToIndex.find(node);
-    if (it == nodeToIndex.end()) {
+template <int Arity>
+void DaryIndexedHeap<Arity>::updatePriority(HeapNode* node, int newPriority) {
+    if (node->heap_index < 0) {
         return;
     }
 
-    int idx = it->second;
     int oldPriority = node->priority;
     node->priority = newPriority;
 
     if (newPriority > oldPriority) {
-        bubbleUp(idx);
+        siftUp(node->heap_index);
     } else if (newPriority < oldPriority) {
-        bubbleDown(idx);
+        siftDown(node->heap_index);
     }
     // If equal, no need to move
 }
 
-HeapNode* IndexedHeap::top() const {
+template <int Arity>
+HeapNode* DaryIndexedHeap<Arity>::top() const {
     if (heap.empty()) {
         throw std::runtime_error("Heap is empty");
     }
     return heap[0];
 }
 
-HeapNode* IndexedHeap::pop() {
+template <int Arity>
+HeapNode* DaryIndexedHeap<Arity>::pop() {
     if (heap.empty()) {
         throw std::runtime_error("Heap is empty");
     }
 
     HeapNode* result = heap[0];
-    nodeToIndex.erase(result);  // Remove from index map
-
-    if (heap.size() > 1) {
-        heap[0] = heap.back();
-        nodeToIndex[heap[0]] = 0;
-        heap.pop_back();
-        bubbleDown(0);
-    } else {
-        heap.pop_back();
+    result->heap_index = -1;
+    HeapNode* last = heap.back();
+    heap.pop_back();
+    if (!heap.empty()) {
+        place(last, 0);
+        siftDown(0);
     }
-
     return result;
 }
 
-void IndexedHeap::remove(HeapNode* node) {
-    auto it = nodeToIndex.find(node);
-    if (it == nodeToIndex.end()) {
+template <int Arity>
+void DaryIndexedHeap<Arity>::remove(HeapNode* node) {
+    if (node->heap_index < 0) {
         return;  // Not in heap
     }
 
-    int idx = it->second;
-    nodeToIndex.erase(it);
-
-    if (idx == heap.size() - 1) {
+    size_t idx = node->heap_index;
+    node->heap_index = -1;
+    HeapNode* last = heap.back();
+    heap.pop_back();
+    if (idx == heap.size()) {
         // Last element, just remove it
-        heap.pop_back();
         return;
     }
 
     // Replace with last element and fix heap property
-    heap[idx] = heap.back();
-    nodeToIndex[heap[idx]] = idx;
-    heap.pop_back();
-
+    place(last, idx);
     // Could need to go up or down
-    if (idx > 0 && heap[idx]->priority > heap[(idx - 1) / 2]->priority) {
-        bubbleUp(idx);
+    if (idx > 0 && before(last, heap[(idx - 1) / Arity])) {
+        siftUp(idx);
     } else {
-        bubbleDown(idx);
+        siftDown(idx);
     }
 }
 
-bool IndexedHeap::empty() const {
-    return heap.empty();
-}
-
-size_t IndexedHeap::size() const {
-    return heap.size();
+template <int Arity>
+void DaryIndexedHeap<Arity>::clear() {
+    for (HeapNode* node : heap) {
+        node->heap_index = -1;
+    }
+    heap.clear();
 }
 
-void IndexedHeap::clear() {
-    heap.clear();
-    nodeToIndex.clear();
-}
\ No newline at end of file
+template class DaryIndexedHeap<2>;
+template class DaryIndexedHeap<4>;
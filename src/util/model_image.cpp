@@ -0,0 +1,454 @@
+/*
+ * ModelImage Implementation
+ * Builds, validates, maps and serializes the flat BPE model layout
+ */
+#include "model_image.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(std::endian::native == std::endian::little,
+              "binary model files are little-endian");
+
+struct ModelImage::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t vocab_size;
+    uint32_t num_merges;
+    uint32_t pair_table_size;
+    uint32_t token_table_size;
+    uint32_t pretokenizer;  // PreTokenizer the model was trained with
+    uint64_t blob_size;
+    uint64_t offsets_off;
+    uint64_t blob_off;
+    uint64_t merges_off;
+    uint64_t pair_table_off;
+    uint64_t token_table_off;
+    uint64_t byte_ids_off;
+    uint64_t checksum;
+};
+
+namespace {
+    constexpr char kMagic[8] = {'B', 'P', 'E', 'M', 'O', 'D', 'E', 'L'};
+
+    size_t align8(size_t n) {
+        return (n + 7) & ~size_t(7);
+    }
+
+    uint32_t table_size_for(size_t n) {
+        return std::bit_ceil(std::max<size_t>(8, 2 * n));
+    }
+
+    uint64_t hash_pair(int left, int right) {
+        uint64_t key = (uint64_t(uint32_t(left)) << 32) | uint32_t(right);
+        key *= 0x9E3779B97F4A7C15ull;
+        return key ^ (key >> 29);
+    }
+
+    uint64_t hash_bytes(std::string_view s) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (unsigned char c : s) {
+            h = (h ^ c) * 0x100000001b3ull;
+        }
+        return h;
+    }
+
+    // Word-at-a-time FNV variant over the body. Sections are 8-byte aligned
+    // and padded, so the body length is a multiple of 8.
+    uint64_t checksum(const uint8_t* data, size_t n) {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i + 8 <= n; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            h = (h ^ word) * 0x100000001b3ull;
+            h ^= h >> 32;
+        }
+        return h;
+    }
+
+    bool section_fits(uint64_t off, uint64_t len, size_t file_size) {
+        return off % 8 == 0 && off <= file_size && len <= file_size - off;
+    }
+}
+
+ModelImage::~ModelImage() {
+    release();
+}
+
+ModelImage::ModelImage(ModelImage&& other) noexcept {
+    *this = std::move(other);
+}
+
+ModelImage& ModelImage::operator=(ModelImage&& other) noexcept {
+    if (this == &other) return *this;
+    release();
+    owned = std::move(other.owned);
+    mapped = other.mapped;
+    if (other.data != nullptr) {
+        bind(other.data, other.size);
+    }
+    other.data = nullptr;
+    other.size = 0;
+    other.mapped = false;
+    other.header = nullptr;
+    return *this;
+}
+
+void ModelImage::release() {
+    if (mapped && data != nullptr) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+    owned.clear();
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    header = nullptr;
+}
+
+void ModelImage::bind(const uint8_t* bytes, size_t n_bytes) {
+    data = bytes;
+    size = n_bytes;
+    header = reinterpret_cast<const Header*>(bytes);
+    offsets = reinterpret_cast<const uint32_t*>(bytes + header->offsets_off);
+    blob = reinterpret_cast<const char*>(bytes + header->blob_off);
+    merges = reinterpret_cast<const Merge*>(bytes + header->merges_off);
+    pair_table = reinterpret_cast<const PairSlot*>(bytes + header->pair_table_off);
+    token_table = reinterpret_cast<const int32_t*>(bytes + header->token_table_off);
+    byte_ids = reinterpret_cast<const int32_t*>(bytes + header->byte_ids_off);
+}
+
+ModelImage ModelImage::build(const std::vector<std::string>& tokens,
+                             const std::vector<std::pair<int, int>>& merge_list,
+                             PreTokenizer pretokenizer) {
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.pretokenizer = static_cast<uint32_t>(pretokenizer);
+    h.vocab_size = tokens.size();
+    h.num_merges = merge_list.size();
+    h.pair_table_size = table_size_for(merge_list.size());
+    h.token_table_size = table_size_for(tokens.size());
+    for (const auto& token : tokens) {
+        h.blob_size += token.size();
+    }
+
+    size_t pos = align8(sizeof(Header));
+    h.offsets_off = pos;
+    pos = align8(pos + (size_t(h.vocab_size) + 1) * sizeof(uint32_t));
+    h.blob_off = pos;
+    pos = align8(pos + h.blob_size);
+    h.merges_off = pos;
+    pos = align8(pos + size_t(h.num_merges) * sizeof(Merge));
+    h.pair_table_off = pos;
+    pos = align8(pos + size_t(h.pair_table_size) * sizeof(PairSlot));
+    h.token_table_off = pos;
+    pos = align8(pos + size_t(h.token_table_size) * sizeof(int32_t));
+    h.byte_ids_off = pos;
+    pos = align8(pos + 256 * sizeof(int32_t));
+
+    ModelImage image;
+    image.owned.assign(pos / 8, 0);
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(image.owned.data());
+    std::memcpy(bytes, &h, sizeof(Header));
+
+    auto* offsets = reinterpret_cast<uint32_t*>(bytes + h.offsets_off);
+    char* blob = reinterpret_cast<char*>(bytes + h.blob_off);
+    auto* merges = reinterpret_cast<Merge*>(bytes + h.merges_off);
+    auto* pair_table = reinterpret_cast<PairSlot*>(bytes + h.pair_table_off);
+    auto* token_table = reinterpret_cast<int32_t*>(bytes + h.token_table_off);
+    auto* byte_ids = reinterpret_cast<int32_t*>(bytes + h.byte_ids_off);
+
+    uint32_t blob_pos = 0;
+    for (size_t id = 0; id < tokens.size(); ++id) {
+        offsets[id] = blob_pos;
+        std::memcpy(blob + blob_pos, tokens[id].data(), tokens[id].size());
+        blob_pos += tokens[id].size();
+    }
+    offsets[tokens.size()] = blob_pos;
+
+    std::fill(token_table, token_table + h.token_table_size, -1);
+    std::fill(byte_ids, byte_ids + 256, -1);
+    image.bind(bytes, pos);
+
+    // Later ids overwrite earlier ones, so duplicated strings resolve to the
+    // most recently learned id.
+    const uint32_t token_mask = h.token_table_size - 1;
+    for (size_t id = 0; id < tokens.size(); ++id) {
+        const std::string& token = tokens[id];
+        if (token.empty()) continue;
+        uint32_t slot = hash_bytes(token) & token_mask;
+        while (token_table[slot] != -1 && image.token(token_table[slot]) != token) {
+            slot = (slot + 1) & token_mask;
+        }
+        token_table[slot] = id;
+        if (token.size() == 1) {
+            byte_ids[static_cast<unsigned char>(token[0])] = id;
+        }
+    }
+
+    // A merge only fires if its concatenation is in the vocab. Equal pairs
+    // are chained in merge order; the pair table points at the first.
+    std::fill(pair_table, pair_table + h.pair_table_size, PairSlot{-1, -1, -1});
+    std::unordered_map<uint64_t, int> last_rank;
+    const uint32_t pair_mask = h.pair_table_size - 1;
+    std::string concat;
+    for (size_t r = 0; r < merge_list.size(); ++r) {
+        auto [left, right] = merge_list[r];
+        concat.assign(image.token(left));
+        concat.append(image.token(right));
+        merges[r] = {left, right, image.token_id(concat), -1};
+        if (merges[r].merged == -1) continue;
+
+        uint64_t key = (uint64_t(uint32_t(left)) << 32) | uint32_t(right);
+        auto it = last_rank.find(key);
+        if (it != last_rank.end()) {
+            merges[it->second].next_rank = r;
+            it->second = r;
+            continue;
+        }
+        last_rank[key] = r;
+        uint32_t slot = hash_pair(left, right) & pair_mask;
+        while (pair_table[slot].rank != -1) {
+            slot = (slot + 1) & pair_mask;
+        }
+        pair_table[slot] = {left, right, static_cast<int32_t>(r)};
+    }
+
+    reinterpret_cast<Header*>(bytes)->checksum =
+        checksum(bytes + sizeof(Header), pos - sizeof(Header));
+    return image;
+}
+
+ModelImage ModelImage::load_text(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open model file: " + path);
+    }
+
+    std::string line;
+    std::getline(in, line);
+    if (line.substr(0, 11) != "VOCAB_SIZE ") {
+        throw std::runtime_error("Invalid model file format: expected VOCAB_SIZE");
+    }
+    std::getline(in, line);
+    if (line != "VOCAB") {
+        throw std::runtime_error("Invalid model file format: expected VOCAB");
+    }
+
+    std::vector<std::string> tokens;
+    std::unordered_map<std::string, int> token_to_id;
+    PreTokenizer pretokenizer = PreTokenizer::Whitespace;
+    while (std::getline(in, line) && line != "MERGES") {
+        size_t tab_pos = line.find('\t');
+        if (tab_pos == std::string::npos) {
+            if (line == "PRETOKENIZER char_class") {
+                pretokenizer = PreTokenizer::CharClass;
+            }
+            if (line.starts_with("BYTES ")) {
+                int base = std::stoi(line.substr(6));
+                if (base < 0) throw std::runtime_error("Invalid model file format: bad BYTES line");
+                if (base + 256 > static_cast<int>(tokens.size())) tokens.resize(base + 256);
+                for (int b = 0; b < 256; ++b) {
+                    tokens[base + b] = std::string(1, static_cast<char>(b));
+                    token_to_id[tokens[base + b]] = base + b;
+                }
+            }
+            continue;
+        }
+        std::string token = line.substr(0, tab_pos);
+        int id = std::stoi(line.substr(tab_pos + 1));
+        if (id >= static_cast<int>(tokens.size())) tokens.resize(id + 1);
+        tokens[id] = token;
+        token_to_id[token] = id;
+    }
+
+    std::vector<std::pair<int, int>> merge_list;
+    while (std::getline(in, line)) {
+        size_t space_pos = line.find(' ');
+        if (space_pos == std::string::npos) continue;
+        auto first = token_to_id.find(line.substr(0, space_pos));
+        auto second = token_to_id.find(line.substr(space_pos + 1));
+        if (first != token_to_id.end() && second != token_to_id.end()) {
+            merge_list.emplace_back(first->second, second->second);
+        }
+    }
+    return build(tokens, merge_list, pretokenizer);
+}
+
+bool ModelImage::is_binary_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kMagic)] = {};
+    in.read(magic, sizeof(magic));
+    return in.gcount() == sizeof(magic) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+ModelImage ModelImage::map_file(const std::string& path, bool verify_checksum) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open model file: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(Header))) {
+        close(fd);
+        throw std::runtime_error("Invalid binary model file: " + path);
+    }
+    size_t file_size = st.st_size;
+    void* addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Failed to map model file: " + path);
+    }
+
+    ModelImage image;
+    image.mapped = true;
+    image.data = static_cast<const uint8_t*>(addr);
+    image.size = file_size;
+
+    auto fail = [&](const std::string& why) {
+        throw std::runtime_error("Invalid binary model file " + path + ": " + why);
+    };
+
+    const Header* h = static_cast<const Header*>(addr);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0) fail("bad magic");
+    if (h->version != kVersion) fail("unsupported version " + std::to_string(h->version));
+    if (h->pretokenizer > static_cast<uint32_t>(PreTokenizer::CharClass)) fail("unknown pre-tokenizer");
+    if (!std::has_single_bit(h->pair_table_size) || !std::has_single_bit(h->token_table_size)) {
+        fail("bad table size");
+    }
+    if (!section_fits(h->offsets_off, (uint64_t(h->vocab_size) + 1) * sizeof(uint32_t), file_size) ||
+        !section_fits(h->blob_off, h->blob_size, file_size) ||
+        !section_fits(h->merges_off, uint64_t(h->num_merges) * sizeof(Merge), file_size) ||
+        !section_fits(h->pair_table_off, uint64_t(h->pair_table_size) * sizeof(PairSlot), file_size) ||
+        !section_fits(h->token_table_off, uint64_t(h->token_table_size) * sizeof(int32_t), file_size) ||
+        !section_fits(h->byte_ids_off, 256 * sizeof(int32_t), file_size)) {
+        fail("truncated");
+    }
+    image.bind(image.data, file_size);
+    if (verify_checksum && checksum(image.data + sizeof(Header), file_size - sizeof(Header)) != h->checksum) {
+        fail("checksum mismatch");
+    }
+
+    // Bounds-check every stored index so lookups never leave the mapping.
+    const int32_t vocab = h->vocab_size;
+    const int32_t n_merges = h->num_merges;
+    for (int32_t id = 0; id < vocab; ++id) {
+        if (image.offsets[id] > image.offsets[id + 1]) fail("bad offsets");
+    }
+    if (image.offsets[vocab] != h->blob_size) fail("bad offsets");
+    for (int32_t r = 0; r < n_merges; ++r) {
+        const Merge& m = image.merges[r];
+        if (m.left < 0 || m.left >= vocab || m.right < 0 || m.right >= vocab ||
+            m.merged < -1 || m.merged >= vocab ||
+            (m.next_rank != -1 && (m.next_rank <= r || m.next_rank >= n_merges))) {
+            fail("bad merge");
+        }
+    }
+    // Lookups probe until an empty slot, so each table needs one.
+    uint32_t empty_slots = 0;
+    for (uint32_t i = 0; i < h->pair_table_size; ++i) {
+        if (image.pair_table[i].rank < -1 || image.pair_table[i].rank >= n_merges) fail("bad pair table");
+        empty_slots += image.pair_table[i].rank == -1;
+    }
+    if (empty_slots == 0) fail("pair table full");
+    empty_slots = 0;
+    for (uint32_t i = 0; i < h->token_table_size; ++i) {
+        if (image.token_table[i] < -1 || image.token_table[i] >= vocab) fail("bad token table");
+        empty_slots += image.token_table[i] == -1;
+    }
+    if (empty_slots == 0) fail("token table full");
+    for (int b = 0; b < 256; ++b) {
+        if (image.byte_ids[b] < -1 || image.byte_ids[b] >= vocab) fail("bad byte ids");
+    }
+    return image;
+}
+
+void ModelImage::write_binary(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + path);
+    }
+    out.write(reinterpret_cast<const char*>(data), size);
+}
+
+void ModelImage::write_text(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + path);
+    }
+    // A full byte alphabet at consecutive ids is written as one BYTES line:
+    // it includes whitespace bytes, which the line format cannot hold.
+    int byte_base = byte_ids[0];
+    for (int b = 1; b < 256 && byte_base != -1; ++b) {
+        if (byte_ids[b] != byte_base + b) byte_base = -1;
+    }
+
+    out << "VOCAB_SIZE " << vocab_size() << "\n";
+    out << "VOCAB\n";
+    if (pretokenizer() == PreTokenizer::CharClass) {
+        out << "PRETOKENIZER char_class\n";
+    }
+    for (int id = 0; id < vocab_size(); ++id) {
+        if (id == byte_base) {
+            out << "BYTES " << byte_base << "\n";
+            id += 255;
+            continue;
+        }
+        std::string_view tok = token(id);
+        if (tok.empty() || token_id(tok) != id) continue;
+        out << tok << "\t" << id << "\n";
+    }
+    out << "MERGES\n";
+    for (size_t r = 0; r < num_merges(); ++r) {
+        out << token(merges[r].left) << " " << token(merges[r].right) << "\n";
+    }
+}
+
+PreTokenizer ModelImage::pretokenizer() const {
+    return header ? static_cast<PreTokenizer>(header->pretokenizer) : PreTokenizer::Whitespace;
+}
+
+int ModelImage::vocab_size() const {
+    return header ? header->vocab_size : 0;
+}
+
+size_t ModelImage::num_merges() const {
+    return header ? header->num_merges : 0;
+}
+
+std::string_view ModelImage::token(int id) const {
+    if (id < 0 || id >= vocab_size()) return {};
+    return std::string_view(blob + offsets[id], offsets[id + 1] - offsets[id]);
+}
+
+int ModelImage::token_id(std::string_view tok) const {
+    if (header == nullptr || tok.empty()) return -1;
+    const uint32_t mask = header->token_table_size - 1;
+    uint32_t slot = hash_bytes(tok) & mask;
+    while (token_table[slot] != -1) {
+        if (token(token_table[slot]) == tok) return token_table[slot];
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+int ModelImage::find_pair(int left, int right) const {
+    if (header == nullptr) return -1;
+    const uint32_t mask = header->pair_table_size - 1;
+    uint32_t slot = hash_pair(left, right) & mask;
+    while (pair_table[slot].rank != -1) {
+        if (pair_table[slot].left == left && pair_table[slot].right == right) {
+            return pair_table[slot].rank;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
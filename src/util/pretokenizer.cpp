@@ -0,0 +1,211 @@
+/*
+ * Pre-tokenizer Implementation
+ * Classifies 64 bytes at a time into whitespace/digit/letter bitmasks and
+ * walks the bits where the class changes
+ */
+#include "pretokenizer.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PRETOKENIZER_AVX2 1
+#endif
+
+namespace {
+
+    // Bit i of each mask describes p[i]. Bytes in none of the three are
+    // "other" (punctuation, symbols, control bytes).
+    struct ClassMasks {
+        uint64_t space;
+        uint64_t digit;
+        uint64_t letter;
+    };
+
+    inline bool is_digit(unsigned char c) {
+        return static_cast<unsigned char>(c - '0') <= 9;
+    }
+
+    inline bool is_letter(unsigned char c) {
+        return static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a' || c >= 0x80;
+    }
+
+    // The first `len` (at most 64) bytes; `classes` = false fills only `space`.
+    ClassMasks classify_scalar(const char* p, size_t len, bool classes) {
+        ClassMasks m{0, 0, 0};
+        for (size_t i = 0; i < len; ++i) {
+            unsigned char c = static_cast<unsigned char>(p[i]);
+            m.space |= static_cast<uint64_t>(is_space_byte(c)) << i;
+            if (classes) {
+                m.digit |= static_cast<uint64_t>(is_digit(c)) << i;
+                m.letter |= static_cast<uint64_t>(is_letter(c)) << i;
+            }
+        }
+        return m;
+    }
+
+    struct ScalarClassifier {
+        template <bool classes>
+        static ClassMasks classify(const char* p) {
+            return classify_scalar(p, 64, classes);
+        }
+    };
+
+#if defined(__SSE2__)
+    struct Sse2Classifier {
+        template <bool classes>
+        static ClassMasks classify(const char* p) {
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i ctrl_span = _mm_set1_epi8('\r' - '\t');
+            const __m128i zero = _mm_set1_epi8('0');
+            const __m128i digit_span = _mm_set1_epi8(9);
+            const __m128i case_bit = _mm_set1_epi8(0x20);
+            const __m128i lower_a = _mm_set1_epi8('a');
+            const __m128i letter_span = _mm_set1_epi8('z' - 'a');
+            ClassMasks m{0, 0, 0};
+            for (int k = 0; k < 4; ++k) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * k));
+                // x in [lo, lo + span] <=> (x - lo) as unsigned is at most span
+                __m128i d = _mm_sub_epi8(v, tab);
+                __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(d, ctrl_span), d);
+                __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, space), ctrl);
+                m.space |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hit))) << (16 * k);
+                if constexpr (!classes) continue;
+                d = _mm_sub_epi8(v, zero);
+                hit = _mm_cmpeq_epi8(_mm_min_epu8(d, digit_span), d);
+                m.digit |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hit))) << (16 * k);
+                d = _mm_sub_epi8(_mm_or_si128(v, case_bit), lower_a);
+                hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(d, letter_span), d), v);  // v: high bit set for >= 0x80
+                m.letter |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hit))) << (16 * k);
+            }
+            return m;
+        }
+    };
+#endif
+
+#if defined(PRETOKENIZER_AVX2)
+    struct Avx2Classifier {
+        template <bool classes>
+        __attribute__((target("avx2")))
+        static ClassMasks classify(const char* p) {
+            const __m256i space = _mm256_set1_epi8(' ');
+            const __m256i tab = _mm256_set1_epi8('\t');
+            const __m256i ctrl_span = _mm256_set1_epi8('\r' - '\t');
+            const __m256i zero = _mm256_set1_epi8('0');
+            const __m256i digit_span = _mm256_set1_epi8(9);
+            const __m256i case_bit = _mm256_set1_epi8(0x20);
+            const __m256i lower_a = _mm256_set1_epi8('a');
+            const __m256i letter_span = _mm256_set1_epi8('z' - 'a');
+            ClassMasks m{0, 0, 0};
+            for (int k = 0; k < 2; ++k) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * k));
+                __m256i d = _mm256_sub_epi8(v, tab);
+                __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(d, ctrl_span), d);
+                __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), ctrl);
+                m.space |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit))) << (32 * k);
+                if constexpr (!classes) continue;
+                d = _mm256_sub_epi8(v, zero);
+                hit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, digit_span), d);
+                m.digit |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit))) << (32 * k);
+                d = _mm256_sub_epi8(_mm256_or_si256(v, case_bit), lower_a);
+                hit = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(d, letter_span), d), v);
+                m.letter |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit))) << (32 * k);
+            }
+            return m;
+        }
+    };
+#endif
+
+    // Walk the class changes of p[begin, n). A run is the bytes from one
+    // change to the next; every run that is not whitespace is a piece.
+    template <typename Classifier, bool classes>
+    size_t split_runs(const char* p, size_t begin, size_t n, bool at_end,
+                      std::vector<std::string_view>& pieces) {
+        if constexpr (classes) begin = 0;
+
+        // Before p[0] sits whitespace, unless p[0, begin) is a word already begun.
+        bool in_space = begin == 0;
+        size_t start = 0;                      // start of the current run
+        size_t word_start = in_space ? n : 0;  // start of the current word
+        size_t word_piece = pieces.size();     // its first piece
+        uint64_t prev_space = in_space, prev_digit = 0, prev_letter = 0;
+
+        for (size_t i = begin; i < n; i += 64) {
+            size_t len = n - i < 64 ? n - i : 64;
+            ClassMasks m = len == 64 ? Classifier::template classify<classes>(p + i)
+                                     : classify_scalar(p + i, len, classes);
+            // A set bit marks a byte whose class differs from the byte before.
+            uint64_t edges = m.space ^ ((m.space << 1) | prev_space);
+            if constexpr (classes) {
+                edges |= m.digit ^ ((m.digit << 1) | prev_digit);
+                edges |= m.letter ^ ((m.letter << 1) | prev_letter);
+            }
+            if (len < 64) edges &= (uint64_t(1) << len) - 1;
+            prev_space = m.space >> 63;
+            prev_digit = m.digit >> 63;
+            prev_letter = m.letter >> 63;
+
+            while (edges) {
+                unsigned bit = __builtin_ctzll(edges);
+                edges &= edges - 1;
+                size_t at = i + bit;
+                bool space = (m.space >> bit) & 1;
+                if (!in_space) {
+                    pieces.emplace_back(p + start, at - start);
+                } else if (!space) {
+                    word_start = at;
+                    word_piece = pieces.size();
+                }
+                in_space = space;
+                start = at;
+            }
+        }
+
+        if (in_space) return n;
+        if (at_end) {
+            pieces.emplace_back(p + start, n - start);
+            return n;
+        }
+        pieces.resize(word_piece);
+        return word_start;
+    }
+
+    using SplitFn = size_t (*)(const char*, size_t, size_t, bool, std::vector<std::string_view>&);
+
+    struct Splitters {
+        SplitFn whitespace;
+        SplitFn char_class;
+    };
+
+    template <typename Classifier>
+    Splitters splitters() {
+        return {split_runs<Classifier, false>, split_runs<Classifier, true>};
+    }
+
+    Splitters pick_splitters() {
+#if defined(PRETOKENIZER_AVX2)
+        if (__builtin_cpu_supports("avx2")) return splitters<Avx2Classifier>();
+#endif
+#if defined(__SSE2__)
+        return splitters<Sse2Classifier>();
+#else
+        return splitters<ScalarClassifier>();
+#endif
+    }
+
+    SplitFn split(PreTokenizer mode) {
+        static const Splitters fns = pick_splitters();
+        return mode == PreTokenizer::CharClass ? fns.char_class : fns.whitespace;
+    }
+}
+
+size_t pretokenize_block(const char* p, size_t begin, size_t n, PreTokenizer mode, bool at_end,
+                         std::vector<std::string_view>& pieces) {
+    return split(mode)(p, begin, n, at_end, pieces);
+}
+
+void pretokenize(std::string_view text, PreTokenizer mode, std::vector<std::string_view>& pieces) {
+    split(mode)(text.data(), 0, text.size(), true, pieces);
+}
@@ -0,0 +1,121 @@
+/*
+ * SpecialTokenMatcher Implementation
+ * Trie construction, failure links folded into a dense transition table and
+ * the leftmost-longest scan
+ */
+#include "special_tokens.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+SpecialTokenMatcher::SpecialTokenMatcher(const std::vector<std::string>& patterns) {
+    // Trie first: delta holds child edges only, -1 where there is none.
+    delta.assign(256, -1);
+    longest.assign(1, -1);
+    depth.assign(1, 0);
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        const std::string& pattern = patterns[p];
+        if (pattern.empty()) {
+            throw std::runtime_error("Special tokens must not be empty");
+        }
+        starts[static_cast<unsigned char>(pattern[0])] = true;
+        int32_t state = 0;
+        for (char ch : pattern) {
+            const unsigned char c = static_cast<unsigned char>(ch);
+            if (delta[state * 256 + c] < 0) {
+                delta[state * 256 + c] = static_cast<int32_t>(depth.size());
+                delta.resize(delta.size() + 256, -1);
+                longest.push_back(-1);
+                depth.push_back(depth[state] + 1);
+            }
+            state = delta[state * 256 + c];
+        }
+        if (longest[state] < 0) longest[state] = static_cast<int32_t>(p);
+        lengths.push_back(static_cast<uint32_t>(pattern.size()));
+        max_len = std::max<size_t>(max_len, pattern.size());
+    }
+
+    int n_starts = 0;
+    for (int c = 0; c < 256; ++c) {
+        if (starts[c]) {
+            ++n_starts;
+            only_start = c;
+        }
+    }
+    if (n_starts != 1) only_start = -1;
+
+    // Breadth first, so a state's failure target is complete before the state
+    // itself: missing edges take the failure target's transition, and a state
+    // spelling no pattern inherits the longest pattern ending at its target.
+    std::vector<int32_t> fail(depth.size(), 0);
+    std::vector<int32_t> order;
+    order.reserve(depth.size());
+    for (int c = 0; c < 256; ++c) {
+        int32_t& next = delta[c];
+        if (next < 0) {
+            next = 0;
+        } else {
+            order.push_back(next);
+        }
+    }
+    for (size_t k = 0; k < order.size(); ++k) {
+        const int32_t state = order[k];
+        if (longest[state] < 0) longest[state] = longest[fail[state]];
+        for (int c = 0; c < 256; ++c) {
+            int32_t& next = delta[state * 256 + c];
+            const int32_t fallback = delta[fail[state] * 256 + c];
+            if (next < 0) {
+                next = fallback;
+            } else {
+                fail[next] = fallback;
+                order.push_back(next);
+            }
+        }
+    }
+}
+
+bool SpecialTokenMatcher::find(std::string_view text, size_t from, Match& match) const {
+    if (lengths.empty()) return false;
+    const size_t n = text.size();
+    bool found = false;
+    int32_t state = 0;
+    size_t i = from;
+    while (i < n) {
+        if (state == 0) {
+            // Skip to the next byte that can start a match
+            if (only_start >= 0) {
+                const void* hit = std::memchr(text.data() + i, only_start, n - i);
+                if (hit == nullptr) break;
+                i = static_cast<const char*>(hit) - text.data();
+            } else {
+                while (i < n && !starts[static_cast<unsigned char>(text[i])]) ++i;
+                if (i == n) break;
+            }
+        }
+        state = delta[state * 256 + static_cast<unsigned char>(text[i])];
+        ++i;
+        const int32_t p = longest[state];
+        if (p >= 0) {
+            const size_t begin = i - lengths[p];
+            if (!found || begin < match.begin || (begin == match.begin && i > match.end)) {
+                match = {begin, i, static_cast<uint32_t>(p)};
+                found = true;
+            }
+        }
+        // A match still in progress starts at i - depth; once that is past
+        // the best match's start nothing can beat it.
+        if (found && i - depth[state] > match.begin) return true;
+    }
+    return found;
+}
+
+size_t SpecialTokenMatcher::open_suffix(std::string_view text) const {
+    if (lengths.empty()) return 0;
+    // No state spells more than max_len bytes, so the last max_len decide it
+    int32_t state = 0;
+    for (size_t i = text.size() > max_len ? text.size() - max_len : 0; i < text.size(); ++i) {
+        state = delta[state * 256 + static_cast<unsigned char>(text[i])];
+    }
+    return depth[state];
+}
@@ -0,0 +1,132 @@
+/*
+ * ThreadPool Implementation
+ * Per-worker deques with stealing; parallel_for blocks until its chunks finish
+ */
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+struct ThreadPool::Job {
+    const std::function<void(size_t, size_t)>* fn;
+    std::atomic<size_t> remaining{0};  // written under mu
+    std::mutex mu;
+    std::condition_variable done;
+    std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mu);
+        stopping = true;
+    }
+    sleep_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool ThreadPool::pop_local(size_t self, Task& task) {
+    Queue& q = *queues[self];
+    std::lock_guard<std::mutex> lock(q.mu);
+    if (q.head == q.tasks.size()) return false;
+    task = q.tasks.back();
+    q.tasks.pop_back();
+    if (q.head == q.tasks.size()) {
+        q.tasks.clear();
+        q.head = 0;
+    }
+    queued--;
+    return true;
+}
+
+bool ThreadPool::steal(size_t self, Task& task) {
+    const size_t n = queues.size();
+    for (size_t k = 1; k <= n; ++k) {
+        Queue& q = *queues[(self + k) % n];
+        std::lock_guard<std::mutex> lock(q.mu);
+        if (q.head == q.tasks.size()) continue;
+        task = q.tasks[q.head++];
+        if (q.head == q.tasks.size()) {
+            q.tasks.clear();
+            q.head = 0;
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(const Task& task) {
+    Job& job = *task.job;
+    std::exception_ptr error;
+    try {
+        (*job.fn)(task.begin, task.end);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // Decrement under the lock: once the waiter sees zero it destroys the job.
+    std::lock_guard<std::mutex> lock(job.mu);
+    if (error && !job.error) job.error = error;
+    if (--job.remaining == 0) job.done.notify_all();
+}
+
+void ThreadPool::worker_loop(size_t self) {
+    while (true) {
+        Task task;
+        if (pop_local(self, task) || steal(self, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mu);
+        sleep_cv.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, size_t grain,
+                              const std::function<void(size_t, size_t)>& fn) {
+    if (n == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    const size_t n_chunks = (n + grain - 1) / grain;
+
+    Job job;
+    job.fn = &fn;
+    job.remaining = n_chunks;
+
+    // Deal contiguous runs of chunks to each worker so neighbours start on
+    // the same thread; stealing evens out the rest.
+    const size_t n_queues = queues.size();
+    for (size_t w = 0; w < n_queues; ++w) {
+        size_t first = n_chunks * w / n_queues;
+        size_t last = n_chunks * (w + 1) / n_queues;
+        if (first == last) continue;
+        Queue& q = *queues[w];
+        std::lock_guard<std::mutex> lock(q.mu);
+        // Pushed in reverse so the owner's back-pops walk forward
+        for (size_t c = last; c-- > first;) {
+            q.tasks.push_back({&job, c * grain, std::min(n, (c + 1) * grain)});
+        }
+        queued += last - first;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mu);
+    }
+    sleep_cv.notify_all();
+
+    std::unique_lock<std::mutex> lock(job.mu);
+    job.done.wait(lock, [&job] { return job.remaining == 0; });
+    if (job.error) std::rethrow_exception(job.error);
+}
@@ -0,0 +1,144 @@
+/*
+ * TokenShardWriter Implementation
+ * Packed .bin writing, shard rollover at document ends and the .idx format
+ */
+#include "token_shards.hpp"
+
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+static_assert(std::endian::native == std::endian::little, "shards are written in native byte order");
+
+namespace {
+    constexpr char kIndexMagic[8] = {'T', 'O', 'K', 'I', 'D', 'X', '1', '\0'};
+}
+
+TokenShardWriter::TokenShardWriter(const std::string& dir, TokenWidth width, uint64_t shard_tokens, std::string prefix)
+    : dir(dir), prefix(std::move(prefix)), width(width), shard_tokens(shard_tokens) {
+    std::filesystem::create_directories(dir);
+}
+
+TokenShardWriter::~TokenShardWriter() = default;
+
+std::string TokenShardWriter::shard_path(size_t index) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "_%05zu", index);
+    return (std::filesystem::path(dir) / (prefix + name)).string();
+}
+
+void TokenShardWriter::open_shard() {
+    const std::string path = shard_path(shard_count) + ".bin";
+    bin.open(path, std::ios::binary | std::ios::trunc);
+    if (!bin.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + path);
+    }
+    offsets.clear();
+    tokens_in_shard = 0;
+}
+
+void TokenShardWriter::close_shard() {
+    bin.close();
+    if (!bin) {
+        throw std::runtime_error("Failed to write shard: " + shard_path(shard_count) + ".bin");
+    }
+    offsets.push_back(tokens_in_shard);
+
+    IndexHeader header{};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kVersion;
+    header.token_bytes = static_cast<uint32_t>(width);
+    header.num_docs = offsets.size() - 1;
+    header.num_tokens = tokens_in_shard;
+    const std::string path = shard_path(shard_count) + ".idx";
+    std::ofstream idx(path, std::ios::binary | std::ios::trunc);
+    idx.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    idx.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    if (!idx) {
+        throw std::runtime_error("Failed to write shard index: " + path);
+    }
+    ++shard_count;
+}
+
+void TokenShardWriter::begin_document() {
+    if (!bin.is_open()) open_shard();
+    offsets.push_back(tokens_in_shard);
+    in_document = true;
+}
+
+void TokenShardWriter::write(std::span<const uint32_t> ids) {
+    if (ids.empty()) return;
+    if (!in_document) begin_document();
+    if (width == TokenWidth::U32) {
+        bin.write(reinterpret_cast<const char*>(ids.data()), ids.size_bytes());
+    } else {
+        packed.resize(ids.size() * sizeof(uint16_t));
+        uint16_t* out = reinterpret_cast<uint16_t*>(packed.data());
+        uint32_t high = 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            high |= ids[i];
+            out[i] = static_cast<uint16_t>(ids[i]);
+        }
+        if (high > UINT16_MAX) {
+            throw std::runtime_error("Token id does not fit in uint16 shards; use uint32");
+        }
+        bin.write(packed.data(), packed.size());
+    }
+    tokens_in_shard += ids.size();
+    total_tokens += ids.size();
+}
+
+void TokenShardWriter::end_document() {
+    if (!in_document) begin_document();
+    in_document = false;
+    ++total_docs;
+    if (tokens_in_shard >= shard_tokens) close_shard();
+}
+
+void TokenShardWriter::finish() {
+    if (in_document) end_document();
+    if (bin.is_open()) close_shard();
+}
+
+TokenShard TokenShard::read(const std::string& path) {
+    TokenShard shard;
+    std::ifstream idx(path + ".idx", std::ios::binary);
+    if (!idx.is_open()) {
+        throw std::runtime_error("Failed to open shard index: " + path + ".idx");
+    }
+    TokenShardWriter::IndexHeader header;
+    idx.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!idx || std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+        header.version != TokenShardWriter::kVersion || (header.token_bytes != 2 && header.token_bytes != 4)) {
+        throw std::runtime_error("Not a token shard index: " + path + ".idx");
+    }
+    shard.width = static_cast<TokenWidth>(header.token_bytes);
+    shard.doc_offsets.resize(header.num_docs + 1);
+    idx.read(reinterpret_cast<char*>(shard.doc_offsets.data()), shard.doc_offsets.size() * sizeof(uint64_t));
+    if (!idx || shard.doc_offsets.back() != header.num_tokens) {
+        throw std::runtime_error("Truncated token shard index: " + path + ".idx");
+    }
+
+    std::ifstream bin(path + ".bin", std::ios::binary);
+    if (!bin.is_open()) {
+        throw std::runtime_error("Failed to open shard: " + path + ".bin");
+    }
+    std::vector<char> bytes(header.num_tokens * header.token_bytes);
+    bin.read(bytes.data(), bytes.size());
+    if (static_cast<size_t>(bin.gcount()) != bytes.size() || bin.peek() != std::ifstream::traits_type::eof()) {
+        throw std::runtime_error("Shard size does not match its index: " + path + ".bin");
+    }
+    shard.tokens.resize(header.num_tokens);
+    for (size_t i = 0; i < shard.tokens.size(); ++i) {
+        if (header.token_bytes == 2) {
+            uint16_t v;
+            std::memcpy(&v, bytes.data() + 2 * i, 2);
+            shard.tokens[i] = v;
+        } else {
+            std::memcpy(&shard.tokens[i], bytes.data() + 4 * i, 4);
+        }
+    }
+    return shard;
+}
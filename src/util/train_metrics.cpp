@@ -0,0 +1,88 @@
+/*
+ * TrainMetrics Implementation
+ * Histogram percentiles, the summary printout and the JSON dump
+ */
+#include "train_metrics.hpp"
+
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+namespace {
+    constexpr double kMiB = 1024.0 * 1024.0;
+
+    void histogram_json(std::ostream& out, const char* name, const Histogram& h) {
+        out << "\"" << name << "\":{\"count\":" << h.count << ",\"mean\":" << h.mean()
+            << ",\"p50\":" << h.percentile(0.5) << ",\"p90\":" << h.percentile(0.9)
+            << ",\"p99\":" << h.percentile(0.99) << ",\"max\":" << h.max << ",\"buckets\":[";
+        // Trailing empty buckets are left out; bucket i holds values below 2^i.
+        int last = Histogram::kBuckets - 1;
+        while (last > 0 && h.buckets[last] == 0) --last;
+        for (int i = 0; i <= last; ++i) {
+            out << (i ? "," : "") << h.buckets[i];
+        }
+        out << "]}";
+    }
+}
+
+uint64_t Histogram::percentile(double p) const {
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(p * count + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t bound = i == 0 ? 0 : (i >= 64 ? UINT64_MAX : (uint64_t(1) << i) - 1);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+void TrainMetrics::print(std::ostream& out) const {
+    std::ostream::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "\n=== Performance Profile ===\n";
+    out << std::fixed << std::setprecision(3);
+    out << "preprocess:     " << preprocess_seconds << "s ("
+        << (preprocess_seconds > 0 ? corpus_bytes / kMiB / preprocess_seconds : 0.0) << " MiB/s)\n";
+    out << "count_pairs:    " << count_pairs_seconds << "s (" << initial_pairs << " pairs)\n";
+    out << "merges:         " << merge_seconds << "s (" << merges << " merges)\n";
+    if (merge_ns.count > 0) {
+        out << "merge latency:  mean " << merge_ns.mean() / 1000 << "us, p50 <" << merge_ns.percentile(0.5) / 1000.0
+            << "us, p99 <" << merge_ns.percentile(0.99) / 1000.0 << "us, max " << merge_ns.max / 1000.0 << "us\n";
+        out << "sites/merge:    mean " << sites_per_merge.mean() << ", max " << sites_per_merge.max << "\n";
+    }
+    if (checkpoint_seconds > 0) {
+        out << "checkpoints:    " << checkpoint_seconds << "s\n";
+    }
+    out << "total:          " << total_seconds << "s\n";
+    out << "peak RSS:       " << peak_rss_bytes / kMiB << " MiB\n";
+    out << "===========================\n\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+std::string TrainMetrics::to_json() const {
+    std::ostringstream out;
+    out << std::setprecision(9);
+    out << "{\"phases\":{\"preprocess_s\":" << preprocess_seconds << ",\"count_pairs_s\":" << count_pairs_seconds
+        << ",\"merge_s\":" << merge_seconds << ",\"checkpoint_s\":" << checkpoint_seconds << ",\"total_s\":" << total_seconds << "}"
+        << ",\"corpus_bytes\":" << corpus_bytes << ",\"corpus_words\":" << corpus_words
+        << ",\"unique_words\":" << unique_words << ",\"initial_pairs\":" << initial_pairs
+        << ",\"merges\":" << merges << ",\"peak_rss_bytes\":" << peak_rss_bytes << ",";
+    histogram_json(out, "merge_ns", merge_ns);
+    out << ",";
+    histogram_json(out, "sites_per_merge", sites_per_merge);
+    out << ",";
+    histogram_json(out, "count_updates_per_merge", count_updates_per_merge);
+    out << ",\"queue_samples\":[";
+    for (size_t i = 0; i < queue_samples.size(); ++i) {
+        const Sample& s = queue_samples[i];
+        out << (i ? "," : "") << "{\"merge\":" << s.merge << ",\"elapsed_s\":" << s.elapsed_seconds
+            << ",\"queue_size\":" << s.queue_size << "}";
+    }
+    out << "]}";
+    return out.str();
+}
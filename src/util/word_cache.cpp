@@ -0,0 +1,174 @@
+/*
+ * WordCache Implementation
+ * Sharded CLOCK cache of word -> token ids with a byte budget
+ */
+#include "word_cache.hpp"
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+    // Rough cost of a slot and its index entry beyond the key and id bytes.
+    constexpr size_t kEntryOverhead = 64;
+
+    size_t entry_bytes(std::string_view word, size_t n_ids) {
+        return word.size() + n_ids * sizeof(int) + kEntryOverhead;
+    }
+
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const {
+            return std::hash<std::string_view>{}(s);
+        }
+    };
+}
+
+struct WordCache::Shard {
+    struct Slot {
+        std::string key;
+        std::vector<int> ids;
+        bool referenced = false;
+        bool used = false;
+    };
+
+    std::mutex mu;
+    std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>> index;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    size_t hand = 0;
+    size_t bytes = 0;
+    size_t budget = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+
+    // Advance the clock hand until an unreferenced entry is found and drop it.
+    void evict_one() {
+        while (true) {
+            Slot& slot = slots[hand];
+            uint32_t idx = hand;
+            hand = (hand + 1) % slots.size();
+            if (!slot.used) continue;
+            if (slot.referenced) {
+                slot.referenced = false;
+                continue;
+            }
+            bytes -= entry_bytes(slot.key, slot.ids.size());
+            index.erase(slot.key);
+            slot.key = std::string();
+            slot.ids = std::vector<int>();
+            slot.used = false;
+            free_slots.push_back(idx);
+            evictions++;
+            return;
+        }
+    }
+
+    void shrink_to(size_t limit) {
+        while (bytes > limit) {
+            evict_one();
+        }
+    }
+
+    void reset() {
+        index.clear();
+        slots.clear();
+        free_slots.clear();
+        hand = 0;
+        bytes = 0;
+    }
+};
+
+WordCache::WordCache(size_t budget, size_t num_shards) : budget_bytes(budget) {
+    if (num_shards == 0) num_shards = 1;
+    for (size_t i = 0; i < num_shards; ++i) {
+        shards.push_back(std::make_unique<Shard>());
+        shards.back()->budget = budget / num_shards;
+    }
+}
+
+WordCache::~WordCache() = default;
+
+WordCache::Shard& WordCache::shard_for(std::string_view word) {
+    return *shards[std::hash<std::string_view>{}(word) % shards.size()];
+}
+
+bool WordCache::lookup(std::string_view word, std::vector<int>& ids) {
+    Shard& shard = shard_for(word);
+    std::lock_guard<std::mutex> lock(shard.mu);
+    auto it = shard.index.find(word);
+    if (it == shard.index.end()) {
+        shard.misses++;
+        return false;
+    }
+    Shard::Slot& slot = shard.slots[it->second];
+    slot.referenced = true;
+    ids.assign(slot.ids.begin(), slot.ids.end());
+    shard.hits++;
+    return true;
+}
+
+void WordCache::insert(std::string_view word, const std::vector<int>& ids) {
+    Shard& shard = shard_for(word);
+    size_t size = entry_bytes(word, ids.size());
+    std::lock_guard<std::mutex> lock(shard.mu);
+    if (size > shard.budget) return;
+    // Another thread may have encoded the same word concurrently.
+    if (shard.index.find(word) != shard.index.end()) return;
+
+    shard.shrink_to(shard.budget - size);
+
+    uint32_t idx;
+    if (!shard.free_slots.empty()) {
+        idx = shard.free_slots.back();
+        shard.free_slots.pop_back();
+    } else {
+        idx = shard.slots.size();
+        shard.slots.emplace_back();
+    }
+    Shard::Slot& slot = shard.slots[idx];
+    slot.key.assign(word);
+    slot.ids = ids;
+    slot.referenced = false;
+    slot.used = true;
+    shard.index.emplace(slot.key, idx);
+    shard.bytes += size;
+}
+
+void WordCache::set_budget(size_t budget) {
+    budget_bytes = budget;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mu);
+        shard->budget = budget / shards.size();
+        if (shard->budget == 0) {
+            shard->reset();
+        } else {
+            shard->shrink_to(shard->budget);
+        }
+    }
+}
+
+size_t WordCache::budget() const {
+    return budget_bytes;
+}
+
+void WordCache::clear() {
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mu);
+        shard->reset();
+    }
+}
+
+WordCacheStats WordCache::stats() const {
+    WordCacheStats total;
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mu);
+        total.hits += shard->hits;
+        total.misses += shard->misses;
+        total.evictions += shard->evictions;
+        total.entries += shard->index.size();
+        total.bytes += shard->bytes;
+    }
+    return total;
+}
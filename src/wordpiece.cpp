@@ -0,0 +1,306 @@
+/*
+ * WordPiece Implementation
+ * Double-array trie with LinMaxMatch failure links, the encoder, vocab I/O
+ * and training on top of the BPE trainer
+ */
+#include "wordpiece.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+    // Pointer trie the double array is laid out from
+    struct BuildNode {
+        std::vector<std::pair<unsigned char, int>> children;
+        int token = -1;
+    };
+
+    int child_or_add(std::vector<BuildNode>& nodes, int node, unsigned char c) {
+        for (const auto& [label, child] : nodes[node].children) {
+            if (label == c) return child;
+        }
+        int child = static_cast<int>(nodes.size());
+        nodes[node].children.emplace_back(c, child);
+        nodes.emplace_back();
+        return child;
+    }
+}
+
+WordPiece::WordPiece(std::vector<std::string> tokens, WordPieceOptions options)
+    : vocab(std::move(tokens)), opts(std::move(options)) {
+    if (opts.continuation_prefix.empty()) {
+        throw std::runtime_error("WordPiece needs a non-empty continuation prefix");
+    }
+    build_trie();
+    unk = token_id(opts.unk_token);
+    if (unk < 0) {
+        throw std::runtime_error("WordPiece vocab has no unk token: " + opts.unk_token);
+    }
+}
+
+void WordPiece::build_trie() {
+    std::vector<BuildNode> nodes(1);
+    auto insert = [&](std::string_view s) {
+        int node = 0;
+        for (char c : s) node = child_or_add(nodes, node, static_cast<unsigned char>(c));
+        return node;
+    };
+    const int prefix_node = insert(opts.continuation_prefix);
+    for (size_t id = 0; id < vocab.size(); ++id) {
+        int node = insert(vocab[id]);
+        if (nodes[node].token < 0) nodes[node].token = static_cast<int>(id);
+    }
+
+    // Lay the states out breadth first. Each state's children go at the
+    // first base where all of their cells are free.
+    std::vector<int32_t> state_of(nodes.size());
+    std::vector<int> order = {0};
+    order.reserve(nodes.size());
+    cells.assign(256, Cell());
+    cells[0].check = -2;  // the root is nobody's child
+    size_t first_free = 1;
+    for (size_t k = 0; k < order.size(); ++k) {
+        BuildNode& node = nodes[order[k]];
+        if (node.children.empty()) continue;
+        std::sort(node.children.begin(), node.children.end());
+        const unsigned char lowest = node.children.front().first;
+        size_t base = std::max<size_t>(1, first_free > lowest ? first_free - lowest : 1);
+        while (true) {
+            if (cells.size() < base + 256) cells.resize(base + 256);
+            bool fits = true;
+            for (const auto& [label, child] : node.children) {
+                if (cells[base + label].check != -1) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) break;
+            ++base;
+        }
+        const int32_t state = state_of[order[k]];
+        cells[state].base = static_cast<int32_t>(base);
+        for (const auto& [label, child] : node.children) {
+            cells[base + label].check = state;
+            state_of[child] = static_cast<int32_t>(base + label);
+            order.push_back(child);
+        }
+        while (first_free < cells.size() && cells[first_free].check != -1) ++first_free;
+    }
+    while (!cells.empty() && cells.back().check == -1) cells.pop_back();
+
+    links.assign(cells.size(), Link());
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        links[state_of[n]].token = nodes[n].token;
+    }
+    suffix_root = state_of[prefix_node];
+
+    // Failure links (LinMaxMatch). Following the link of a state emits its
+    // pops: the greedy tokens of its string up to where the link's string, a
+    // continuation, begins. A state spelling a token pops just that token and
+    // falls to the continuation root. Neither root has a link; the prefix
+    // state keeps none even if the prefix is a token. A link's string, less
+    // the prefix, is shorter than the state's own, so visiting both subtrees
+    // breadth first from the two roots sees every link target first.
+    std::vector<std::vector<int32_t>> pending(cells.size());
+    pops.clear();
+    order = {0, prefix_node};
+    for (size_t k = 0; k < order.size(); ++k) {
+        const int n = order[k];
+        for (const auto& [c, child] : nodes[n].children) {
+            if (child != prefix_node) order.push_back(child);
+        }
+    }
+    for (int n : order) {
+        const int32_t u = state_of[n];
+        Link& lu = links[u];
+        lu.pops_begin = static_cast<uint32_t>(pops.size());
+        pops.insert(pops.end(), pending[u].begin(), pending[u].end());
+        lu.pops_end = static_cast<uint32_t>(pops.size());
+        std::vector<int32_t>().swap(pending[u]);
+
+        for (const auto& [c, child] : nodes[n].children) {
+            const int32_t v = state_of[child];
+            if (v == suffix_root) continue;
+            if (links[v].token >= 0) {
+                links[v].fail = suffix_root;
+                pending[v] = {links[v].token};
+                continue;
+            }
+            std::vector<int32_t> emitted(pops.begin() + lu.pops_begin, pops.begin() + lu.pops_end);
+            int32_t z = lu.fail;
+            while (z >= 0 && next(z, c) < 0) {
+                emitted.insert(emitted.end(), pops.begin() + links[z].pops_begin, pops.begin() + links[z].pops_end);
+                z = links[z].fail;
+            }
+            if (z >= 0) {
+                links[v].fail = next(z, c);
+                pending[v] = std::move(emitted);
+            }
+        }
+    }
+}
+
+int WordPiece::token_id(std::string_view token) const {
+    if (cells.empty()) return -1;
+    int32_t state = 0;
+    for (char c : token) {
+        state = next(state, static_cast<unsigned char>(c));
+        if (state < 0) return -1;
+    }
+    return links[state].token;
+}
+
+void WordPiece::encode_word(std::string_view word, std::vector<uint32_t>& ids) const {
+    if (word.size() > opts.max_word_bytes) {
+        ids.push_back(unk);
+        return;
+    }
+    // A word spelling the prefix would run through the continuation root,
+    // which has no failure link; match those the direct way.
+    if (word.starts_with(opts.continuation_prefix)) {
+        encode_word_probing(word, ids);
+        return;
+    }
+    const size_t mark = ids.size();
+    auto emit = [&](int32_t state) {
+        for (uint32_t p = links[state].pops_begin; p < links[state].pops_end; ++p) ids.push_back(pops[p]);
+    };
+    int32_t u = 0;
+    for (char ch : word) {
+        const unsigned char c = static_cast<unsigned char>(ch);
+        int32_t v;
+        while ((v = next(u, c)) < 0) {
+            if (links[u].fail < 0) {
+                ids.resize(mark);
+                ids.push_back(unk);
+                return;
+            }
+            emit(u);
+            u = links[u].fail;
+        }
+        u = v;
+    }
+    // End of word: emit what is pending until only the continuation root is left
+    while (u != suffix_root) {
+        if (links[u].fail < 0) {
+            ids.resize(mark);
+            ids.push_back(unk);
+            return;
+        }
+        emit(u);
+        u = links[u].fail;
+    }
+}
+
+void WordPiece::encode_word_probing(std::string_view word, std::vector<uint32_t>& ids) const {
+    const size_t mark = ids.size();
+    size_t start = 0;
+    while (start < word.size()) {
+        int32_t state = start == 0 ? 0 : suffix_root;
+        int best = -1;
+        size_t best_end = start;
+        for (size_t i = start; i < word.size(); ++i) {
+            state = next(state, static_cast<unsigned char>(word[i]));
+            if (state < 0) break;
+            if (links[state].token >= 0) {
+                best = links[state].token;
+                best_end = i + 1;
+            }
+        }
+        if (best < 0) {
+            ids.resize(mark);
+            ids.push_back(unk);
+            return;
+        }
+        ids.push_back(best);
+        start = best_end;
+    }
+}
+
+void WordPiece::encode(std::string_view text, std::vector<uint32_t>& ids) const {
+    if (cells.empty()) {
+        throw std::runtime_error("WordPiece has no vocab");
+    }
+    thread_local std::vector<std::string_view> words;
+    words.clear();
+    pretokenize(text, opts.pretokenizer, words);
+    for (std::string_view word : words) {
+        encode_word(word, ids);
+    }
+}
+
+std::vector<uint32_t> WordPiece::encode(std::string_view text) const {
+    std::vector<uint32_t> ids;
+    encode(text, ids);
+    return ids;
+}
+
+std::vector<std::string> WordPiece::tokenize(std::string_view text) const {
+    std::vector<std::string> tokens;
+    for (uint32_t id : encode(text)) {
+        tokens.push_back(vocab[id]);
+    }
+    return tokens;
+}
+
+std::string WordPiece::decode(std::span<const uint32_t> ids) const {
+    std::string text;
+    for (uint32_t id : ids) {
+        const std::string& tok = vocab.at(id);
+        if (tok.starts_with(opts.continuation_prefix) && !text.empty()) {
+            text.append(tok, opts.continuation_prefix.size());
+        } else {
+            if (!text.empty()) text.push_back(' ');
+            text += tok;
+        }
+    }
+    return text;
+}
+
+WordPiece WordPiece::load(const std::string& vocab_file, WordPieceOptions options) {
+    std::ifstream in(vocab_file, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open vocab file: " + vocab_file);
+    }
+    std::vector<std::string> tokens;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        tokens.push_back(std::move(line));
+    }
+    return WordPiece(std::move(tokens), std::move(options));
+}
+
+void WordPiece::save(const std::string& vocab_file) const {
+    std::ofstream out(vocab_file, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + vocab_file);
+    }
+    for (const std::string& tok : vocab) {
+        out << tok << '\n';
+    }
+}
+
+WordPiece train_wordpiece(const std::string& raw_data, size_t vocab_size,
+                          const TrainOptions& train_options, WordPieceOptions options) {
+    // The BPE vocab adds EOW and EOS, which WordPiece does not use
+    const size_t n_special = options.special_tokens.size();
+    TrainOptions bpe_options = train_options;
+    bpe_options.pretokenizer = options.pretokenizer;
+    bpe_options.continuation_prefix = options.continuation_prefix;
+    Trainer trainer;
+    Tokenizer bpe = trainer.train(raw_data, vocab_size > n_special ? vocab_size - n_special + 2 : 2, bpe_options);
+
+    // Merges can spell the same token twice ("ab" + "##c", "a" + "##bc"); keep the first
+    std::vector<std::string> tokens = options.special_tokens;
+    std::unordered_set<std::string> seen(tokens.begin(), tokens.end());
+    for (int id = 0; id < bpe.vocab_size(); ++id) {
+        std::string tok(bpe.model().token(id));
+        if (tok == EOW || tok == EOS) continue;
+        if (seen.insert(tok).second) tokens.push_back(std::move(tok));
+    }
+    return WordPiece(std::move(tokens), std::move(options));
+}
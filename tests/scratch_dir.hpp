@@ -0,0 +1,43 @@
+#ifndef SCRATCH_DIR_HPP
+#define SCRATCH_DIR_HPP
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+/*
+ * Runs the current test in its own empty directory under the system temp
+ * dir, named after the test, and removes it afterwards. Tests write fixed
+ * file names such as bpe_model.txt, so this is what lets `ctest -j` run them
+ * side by side. Declare it as the first member of a fixture.
+ */
+class ScratchDir {
+public:
+    ScratchDir() {
+        const auto* info = ::testing::UnitTest::GetInstance()->current_test_info();
+        path = std::filesystem::temp_directory_path() /
+               (std::string(info->test_suite_name()) + "." + info->name() + "." + std::to_string(::getpid()));
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+        previous = std::filesystem::current_path();
+        std::filesystem::current_path(path);
+    }
+
+    ~ScratchDir() {
+        std::error_code ec;
+        std::filesystem::current_path(previous, ec);
+        std::filesystem::remove_all(path, ec);
+    }
+
+    ScratchDir(const ScratchDir&) = delete;
+    ScratchDir& operator=(const ScratchDir&) = delete;
+
+private:
+    std::filesystem::path path;
+    std::filesystem::path previous;
+};
+
+#endif // SCRATCH_DIR_HPP
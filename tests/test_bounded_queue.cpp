@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "bounded_queue.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Test fixture for BoundedQueue tests
+class BoundedQueueTest : public ::testing::Test {
+protected:
+    BoundedQueue<int> queue{4};
+};
+
+// Test 1: Items pass through in order and producers never run ahead of the capacity
+TEST_F(BoundedQueueTest, OrderAndCapacity) {
+    std::atomic<size_t> max_size{0};
+    std::thread producer([&] {
+        for (int i = 0; i < 10000; ++i) {
+            ASSERT_TRUE(queue.push(i));
+            size_t size = queue.size();
+            if (size > max_size) max_size = size;
+        }
+        queue.close();
+    });
+    int item;
+    int expected = 0;
+    while (queue.pop(item)) {
+        ASSERT_EQ(item, expected++);
+    }
+    producer.join();
+    EXPECT_EQ(expected, 10000);
+    EXPECT_LE(max_size.load(), 4u);
+}
+
+// Test 2: close() wakes blocked producers and consumers; queued items still drain
+TEST_F(BoundedQueueTest, CloseWakesWaiters) {
+    for (int i = 0; i < 4; ++i) queue.push(i);
+    std::thread blocked_producer([&] { EXPECT_FALSE(queue.push(99)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.close();
+    blocked_producer.join();
+
+    int item;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.pop(item));
+        EXPECT_EQ(item, i);
+    }
+    EXPECT_FALSE(queue.pop(item));
+
+    BoundedQueue<int> empty(2);
+    std::thread blocked_consumer([&] {
+        int x;
+        EXPECT_FALSE(empty.pop(x));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    empty.close();
+    blocked_consumer.join();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -1,13 +1,22 @@
 #include <gtest/gtest.h>
 #include "bpe.hpp"
+#include "../bench/reference_bpe.hpp"
+#include "scratch_dir.hpp"
+#include <algorithm>
+#include <cctype>
 #include <vector>
 #include <string>
 #include <fstream>
 #include <filesystem>
+#include <random>
+#include <sstream>
+#include <thread>
 
 // Test fixture for BPE tests
 class BPETest : public ::testing::Test {
 protected:
+    ScratchDir scratch;  // the test runs in its own directory
+
     void SetUp() override {
         // Create a small test corpus
         test_corpus_file = "test_corpus.txt";
@@ -269,6 +278,677 @@ TEST_F(BPETest, RepeatedTrainingConsistent) {
     }
 }
 
+// Test 16: Rank-driven encoder matches the original per-merge loop
+TEST_F(BPETest, MatchesReferenceEncoder) {
+    // Small alphabet so that the same string is built by several merge paths
+    std::string corpus_file = "reference_corpus.txt";
+    std::ofstream corpus(corpus_file);
+    unsigned state = 12345;
+    for (int line = 0; line < 200; ++line) {
+        for (int w = 0; w < 12; ++w) {
+            state = state * 1103515245 + 12345;
+            int len = 1 + (state >> 16) % 9;
+            for (int c = 0; c < len; ++c) {
+                state = state * 1103515245 + 12345;
+                corpus << "abcab."[(state >> 16) % 6];
+            }
+            corpus << ' ';
+        }
+        corpus << '\n';
+    }
+    corpus.close();
+
+    train(corpus_file, 150);
+    load_model("bpe_model.txt");
+    ReferenceBpe reference("bpe_model.txt");
+
+    std::ifstream in(corpus_file);
+    std::string line;
+    while (std::getline(in, line)) {
+        ASSERT_EQ(tokenize(line), reference.tokenize(line)) << line;
+    }
+    EXPECT_EQ(tokenize("aaaaaaa bbbbbb abababab cab.cab"),
+              reference.tokenize("aaaaaaa bbbbbb abababab cab.cab"));
+
+    std::filesystem::remove(corpus_file);
+}
+
+// Test 17: Encode cache serves repeated words without changing the output
+TEST_F(BPETest, EncodeCacheHits) {
+    train(test_corpus_file, 100);
+
+    set_encode_cache_budget(0);
+    std::vector<std::string> uncached = tokenize("the quick brown fox the lazy dog the");
+
+    set_encode_cache_budget(WordCache::kDefaultBudget);
+    WordCacheStats before = encode_cache_stats();
+    std::vector<std::string> cached = tokenize("the quick brown fox the lazy dog the");
+    WordCacheStats after = encode_cache_stats();
+
+    EXPECT_EQ(cached, uncached);
+    EXPECT_EQ(after.misses - before.misses, 6);
+    EXPECT_EQ(after.hits - before.hits, 2);
+}
+
+// Test 18: Binary model loads back to the same tokenizer
+TEST_F(BPETest, BinaryModelRoundTrip) {
+    train(test_corpus_file, 100);
+    std::vector<std::string> expected = tokenize("the quick brown fox jumps high");
+
+    save_model("bpe_model.bin", ModelFormat::Binary);
+    load_model("bpe_model.bin");
+    EXPECT_EQ(tokenize("the quick brown fox jumps high"), expected);
+
+    // Text written from a binary model is the same model again
+    save_model("bpe_model.txt");
+    load_model("bpe_model.txt");
+    EXPECT_EQ(tokenize("the quick brown fox jumps high"), expected);
+
+    std::filesystem::remove("bpe_model.bin");
+}
+
+// Test 19: One model shared by several encoding threads
+TEST_F(BPETest, SharedTokenizerAcrossThreads) {
+    Trainer trainer;
+    const Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+    tokenizer.set_cache_budget(1 << 16);
+    const std::string text = "the quick brown fox jumps over the lazy dog \xe2\x82\xac";
+    const std::vector<std::string> expected = tokenizer.tokenize(text);
+
+    std::vector<std::thread> threads;
+    std::vector<int> mismatches(8, 0);
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 200; ++i) {
+                if (tokenizer.tokenize(text) != expected) mismatches[t]++;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    for (int count : mismatches) EXPECT_EQ(count, 0);
+}
+
+// Test 20: Unknown characters do not change the model
+TEST_F(BPETest, UnknownCharactersLeaveModelUnchanged) {
+    Trainer trainer;
+    Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+    int vocab_before = tokenizer.vocab_size();
+
+    std::vector<std::string> tokens = tokenizer.tokenize("zebra@");
+    EXPECT_EQ(tokenizer.vocab_size(), vocab_before);
+    std::string joined;
+    for (const auto& token : tokens) joined += token;
+    EXPECT_EQ(joined, "zebra@</w>");
+}
+
+// Test 21: Two models live side by side
+TEST_F(BPETest, IndependentModels) {
+    std::string other_file = "other_corpus.txt";
+    std::ofstream(other_file) << "zzzz zzzz zzzz yyyy yyyy\n";
+
+    Trainer first_trainer, second_trainer;
+    Tokenizer first = first_trainer.train(test_corpus_file, 100);
+    Tokenizer second = second_trainer.train(other_file, 20);
+
+    EXPECT_NE(first.vocab_size(), second.vocab_size());
+    EXPECT_LT(second.tokenize("zzzz").size(), 5);
+    EXPECT_EQ(first.tokenize("zzzz").size(), 5);
+
+    std::filesystem::remove(other_file);
+}
+
+// Test 22: Batch encoding matches per-document encoding, in order
+TEST_F(BPETest, EncodeBatchPreservesOrder) {
+    Trainer trainer;
+    const Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+
+    std::vector<std::string> storage;
+    for (int i = 0; i < 300; ++i) {
+        storage.push_back(i % 3 == 0 ? "the quick brown fox " + std::to_string(i)
+                                     : "lazy dog jumps " + std::to_string(i * 7));
+    }
+    std::vector<std::string_view> docs(storage.begin(), storage.end());
+
+    ThreadPool pool(3);
+    auto batch = tokenizer.encode_batch(docs, pool, 5);
+    auto single_threaded = tokenizer.encode_batch(docs, 1, 1000);
+    ASSERT_EQ(batch.size(), docs.size());
+    EXPECT_EQ(batch, single_threaded);
+    for (size_t i = 0; i < docs.size(); ++i) {
+        ASSERT_EQ(batch[i].size(), tokenizer.tokenize(docs[i]).size());
+    }
+}
+
+// Test 23: Ids from encode() name the same tokens as tokenize()
+TEST_F(BPETest, EncodeMatchesTokenize) {
+    Trainer trainer;
+    const Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+    const std::string text = "the quick brown fox jumps over the lazy dog";
+
+    std::vector<uint32_t> ids = tokenizer.encode(text);
+    std::vector<std::string> tokens = tokenizer.tokenize(text);
+    ASSERT_EQ(ids.size(), tokens.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        EXPECT_EQ(tokenizer.model().token(ids[i]), tokens[i]);
+    }
+}
+
+// Test 24: Offsets map every token back to its bytes in the input
+TEST_F(BPETest, EncodeOffsets) {
+    Trainer trainer;
+    const Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+    tokenizer.set_cache_budget(1 << 16);
+    const std::string text = "  the quick\tbrown foxy@ ";
+
+    for (int pass = 0; pass < 2; ++pass) {  // second pass is served from the cache
+        std::vector<uint32_t> ids;
+        std::vector<TokenSpan> offsets;
+        tokenizer.encode(text, ids, &offsets);
+        ASSERT_EQ(ids.size(), offsets.size());
+
+        std::string rebuilt;
+        size_t last_end = 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            ASSERT_LE(offsets[i].begin, offsets[i].end);
+            ASSERT_GE(offsets[i].begin, last_end);
+            std::string covered = text.substr(offsets[i].begin, offsets[i].end - offsets[i].begin);
+            if (ids[i] < static_cast<uint32_t>(tokenizer.vocab_size())) {
+                std::string token(tokenizer.model().token(ids[i]));
+                EXPECT_EQ(token.substr(0, covered.size()), covered);
+            }
+            rebuilt += covered;
+            last_end = offsets[i].end;
+        }
+        EXPECT_EQ(rebuilt, "thequickbrownfoxy@");
+        EXPECT_EQ(offsets.back().end, text.size() - 1);
+    }
+}
+
+// Test 25: Encoding into a caller-provided buffer
+TEST_F(BPETest, EncodeIntoBuffer) {
+    Trainer trainer;
+    const Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+    const std::string text = "the quick brown fox";
+    std::vector<uint32_t> expected = tokenizer.encode(text);
+
+    std::vector<uint32_t> buffer(64, 0);
+    std::vector<TokenSpan> spans(64);
+    size_t n = tokenizer.encode(text, std::span(buffer), std::span(spans));
+    ASSERT_EQ(n, expected.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), buffer.begin()));
+
+    // Too small: reports the full count and fills what fits
+    std::vector<uint32_t> small(2, 0);
+    EXPECT_EQ(tokenizer.encode(text, std::span(small)), expected.size());
+    EXPECT_EQ(small[0], expected[0]);
+    EXPECT_EQ(small[1], expected[1]);
+}
+
+// Test 26: Decoding restores the words, separated by single spaces
+TEST_F(BPETest, DecodeRoundTrip) {
+    Trainer trainer;
+    const Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+
+    EXPECT_EQ(tokenizer.decode(tokenizer.encode("the quick  brown\tfox\n")), "the quick brown fox");
+    EXPECT_EQ(tokenizer.decode(tokenizer.encode("zebra@ \xe2\x82\xac")), "zebra@ \xe2\x82\xac");
+    EXPECT_EQ(tokenizer.decode(std::vector<uint32_t>{}), "");
+
+    std::vector<uint32_t> bad = {static_cast<uint32_t>(tokenizer.vocab_size() + 256)};
+    EXPECT_THROW(tokenizer.decode(bad), std::out_of_range);
+}
+
+// Test 27: Streaming decode matches a one-shot decode
+TEST_F(BPETest, DecodeStreaming) {
+    Trainer trainer;
+    const Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+    std::vector<uint32_t> ids = tokenizer.encode("the lazy dog jumps over the quick fox");
+
+    std::string streamed;
+    for (uint32_t id : ids) {
+        tokenizer.decode_append(std::span(&id, 1), streamed);
+    }
+    EXPECT_EQ(streamed, tokenizer.decode(ids) + " ");
+}
+
+// Test 28: Batched decode
+TEST_F(BPETest, DecodeBatch) {
+    Trainer trainer;
+    const Tokenizer tokenizer = trainer.train(test_corpus_file, 100);
+    std::vector<std::vector<uint32_t>> docs = {
+        tokenizer.encode("the fox"), tokenizer.encode(""), tokenizer.encode("a dog")};
+
+    std::vector<std::string> texts = tokenizer.decode_batch(docs);
+    ASSERT_EQ(texts.size(), 3);
+    EXPECT_EQ(texts[0], "the fox");
+    EXPECT_EQ(texts[1], "");
+    EXPECT_EQ(texts[2], "a dog");
+}
+
+// Test 29: Training over distinct words gives the same merges as one pass per occurrence
+TEST_F(BPETest, DedupMatchesPerOccurrence) {
+    std::string other_file = "repetitive_corpus.txt";
+    {
+        std::ofstream corpus(other_file);
+        for (int i = 0; i < 40; ++i) {
+            corpus << "aaaa aaa banana bananas the quick brown fox\n";
+            if (i % 3 == 0) corpus << "aaaaaaa nana ban the thee\n";
+            if (i % 7 == 0) corpus << "brown brownie fox foxes quick\n";
+        }
+    }
+
+    Trainer trainer;
+    Tokenizer dedup = trainer.train(other_file, 80, TrainOptions{.dedup_words = true});
+    Tokenizer plain = trainer.train(other_file, 80, TrainOptions{.dedup_words = false});
+
+    ASSERT_EQ(dedup.vocab_size(), plain.vocab_size());
+    ASSERT_EQ(dedup.model().num_merges(), plain.model().num_merges());
+    for (size_t rank = 0; rank < dedup.model().num_merges(); ++rank) {
+        EXPECT_EQ(dedup.model().merge(rank).left, plain.model().merge(rank).left);
+        EXPECT_EQ(dedup.model().merge(rank).right, plain.model().merge(rank).right);
+    }
+    for (int id = 0; id < dedup.vocab_size(); ++id) {
+        EXPECT_EQ(dedup.model().token(id), plain.model().token(id));
+    }
+
+    std::filesystem::remove(other_file);
+}
+
+// Test 30: Parallel word and pair counting does not depend on the thread count
+TEST_F(BPETest, ThreadCountDoesNotChangeModel) {
+    // Larger than two reader blocks, so counting is spread over several chunks
+    std::string big_file = "big_corpus.txt";
+    {
+        std::ofstream corpus(big_file);
+        std::mt19937 rng(42);
+        std::vector<std::string> words;
+        for (int i = 0; i < 500; ++i) {
+            std::string word;
+            for (int j = 0; j < 2 + i % 9; ++j) word += static_cast<char>('a' + rng() % 12);
+            words.push_back(word);
+        }
+        std::uniform_int_distribution<size_t> pick(0, words.size() - 1);
+        for (int i = 0; i < 1500000; ++i) {
+            corpus << words[std::min(pick(rng), pick(rng))] << (i % 13 == 0 ? '\n' : ' ');
+        }
+    }
+
+    Trainer trainer;
+    Tokenizer single = trainer.train(big_file, 300, TrainOptions{.num_threads = 1});
+    Tokenizer multi = trainer.train(big_file, 300, TrainOptions{.num_threads = 3});
+
+    ASSERT_EQ(single.model().num_merges(), multi.model().num_merges());
+    for (size_t rank = 0; rank < single.model().num_merges(); ++rank) {
+        EXPECT_EQ(single.model().merge(rank).left, multi.model().merge(rank).left);
+        EXPECT_EQ(single.model().merge(rank).right, multi.model().merge(rank).right);
+    }
+    for (int id = 0; id < single.vocab_size(); ++id) {
+        EXPECT_EQ(single.model().token(id), multi.model().token(id));
+    }
+
+    std::filesystem::remove(big_file);
+}
+
+// Test 31: The lazy merge queue picks the same merges as the indexed heap
+TEST_F(BPETest, LazyQueueMatchesIndexed) {
+    Trainer trainer;
+    for (bool dedup : {true, false}) {
+        Tokenizer indexed = trainer.train(test_corpus_file, 120,
+                                          TrainOptions{.dedup_words = dedup, .queue = MergeQueue::Indexed});
+        Tokenizer lazy = trainer.train(test_corpus_file, 120,
+                                       TrainOptions{.dedup_words = dedup, .queue = MergeQueue::Lazy});
+
+        ASSERT_EQ(indexed.model().num_merges(), lazy.model().num_merges());
+        for (size_t rank = 0; rank < indexed.model().num_merges(); ++rank) {
+            EXPECT_EQ(indexed.model().merge(rank).left, lazy.model().merge(rank).left);
+            EXPECT_EQ(indexed.model().merge(rank).right, lazy.model().merge(rank).right);
+        }
+        EXPECT_EQ(indexed.encode("the quick brown fox"), lazy.encode("the quick brown fox"));
+    }
+}
+
+// Test 32: Word order does not change the model or its saved bytes
+TEST_F(BPETest, ShuffledCorpusGivesSameModelFile) {
+    std::vector<std::string> lines = {
+        "zebra apple apple banana\n", "banana band bandana\n", "apple zebra zoo\n",
+        "ban ban ban anna\n", "nab bab abba\n", "zoo zebra band\n"};
+    auto read_file = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    auto train_on = [&](const std::vector<std::string>& order, const std::string& stem) {
+        {
+            std::ofstream corpus(stem + ".txt");
+            for (int i = 0; i < 5; ++i) {
+                for (const auto& line : order) corpus << line;
+            }
+        }
+        Trainer trainer;
+        Tokenizer tokenizer = trainer.train(stem + ".txt", 60);
+        tokenizer.save(stem + ".model", ModelFormat::Text);
+        tokenizer.save(stem + ".bin", ModelFormat::Binary);
+        std::pair<std::string, std::string> files{read_file(stem + ".model"), read_file(stem + ".bin")};
+        for (const char* ext : {".txt", ".model", ".bin"}) std::filesystem::remove(stem + ext);
+        return files;
+    };
+
+    auto original = train_on(lines, "ordered");
+    std::vector<std::string> shuffled(lines.rbegin(), lines.rend());
+    std::rotate(shuffled.begin(), shuffled.begin() + 2, shuffled.end());
+    auto reordered = train_on(shuffled, "shuffled");
+
+    EXPECT_EQ(original.first, reordered.first);
+    EXPECT_EQ(original.second, reordered.second);
+    // Base tokens follow byte order after the two special tokens
+    EXPECT_NE(original.first.find("a\t2\nb\t3\n"), std::string::npos);
+}
+
+// Test 33: A byte-level model covers every byte and learns the same merges
+TEST_F(BPETest, ByteLevelVocabulary) {
+    Trainer trainer;
+    Tokenizer plain = trainer.train(test_corpus_file, 45);
+    Tokenizer bytes = trainer.train(test_corpus_file, 258 + plain.model().num_merges(),
+                                    TrainOptions{.byte_level = true});
+
+    for (int b = 0; b < 256; ++b) {
+        EXPECT_EQ(bytes.model().byte_id(static_cast<unsigned char>(b)), 2 + b);
+    }
+    ASSERT_EQ(plain.vocab_size(), 45);
+    ASSERT_EQ(plain.model().num_merges(), bytes.model().num_merges());
+    for (size_t rank = 0; rank < plain.model().num_merges(); ++rank) {
+        EXPECT_EQ(plain.model().token(plain.model().merge(rank).merged),
+                  bytes.model().token(bytes.model().merge(rank).merged));
+    }
+
+    // Unseen bytes, including multi-byte UTF-8, stay inside the vocab and round-trip
+    std::string text = "the quick na\xc3\xafve fox \xe2\x82\xac\x01 jumps";
+    std::vector<uint32_t> ids = bytes.encode(text);
+    for (uint32_t id : ids) {
+        EXPECT_LT(id, static_cast<uint32_t>(bytes.vocab_size()));
+    }
+    EXPECT_EQ(bytes.decode(ids), text);
+    EXPECT_EQ(bytes.tokenize("the"), plain.tokenize("the"));
+
+    // Both formats keep the whitespace and control bytes of the alphabet
+    for (ModelFormat format : {ModelFormat::Text, ModelFormat::Binary}) {
+        bytes.save("byte_model", format);
+        Tokenizer loaded = Tokenizer::load("byte_model");
+        EXPECT_EQ(loaded.vocab_size(), bytes.vocab_size());
+        EXPECT_EQ(loaded.model().byte_id('\n'), 2 + '\n');
+        EXPECT_EQ(loaded.encode(text), ids);
+        std::filesystem::remove("byte_model");
+    }
+}
+
+// Test 34: A CharClass model never merges across letters, digits and punctuation
+TEST_F(BPETest, CharClassPreTokenizer) {
+    std::string other_file = "punctuated_corpus.txt";
+    {
+        std::ofstream corpus(other_file);
+        for (int i = 0; i < 30; ++i) {
+            corpus << "it's 2024, the fox's den (est. 1999) holds 42% of foxes.\n";
+        }
+    }
+    Trainer trainer;
+    Tokenizer tokenizer = trainer.train(other_file, 80, TrainOptions{.pretokenizer = PreTokenizer::CharClass});
+    EXPECT_EQ(tokenizer.model().pretokenizer(), PreTokenizer::CharClass);
+
+    auto byte_class = [](unsigned char c) {
+        return std::isdigit(c) ? 1 : std::isalpha(c) ? 2 : 3;
+    };
+    for (int id = 0; id < tokenizer.vocab_size(); ++id) {
+        std::string_view tok = tokenizer.model().token(id);
+        if (tok == EOW || tok == EOS) continue;
+        for (char c : tok) {
+            EXPECT_EQ(byte_class(c), byte_class(tok[0])) << tok;
+        }
+    }
+
+    // EOW only follows whole words, so decoding gives the text back
+    std::string text = "the fox's den holds 42% (est. 2024)";
+    EXPECT_EQ(tokenizer.decode(tokenizer.encode(text)), text);
+    std::vector<std::string> tokens = tokenizer.tokenize("fox's");
+    EXPECT_EQ(tokens.back(), EOW);
+    EXPECT_EQ(std::count(tokens.begin(), tokens.end(), EOW), 1);
+
+    for (ModelFormat format : {ModelFormat::Text, ModelFormat::Binary}) {
+        tokenizer.save("class_model", format);
+        Tokenizer loaded = Tokenizer::load("class_model");
+        EXPECT_EQ(loaded.model().pretokenizer(), PreTokenizer::CharClass);
+        EXPECT_EQ(loaded.encode(text), tokenizer.encode(text));
+        std::filesystem::remove("class_model");
+    }
+    std::filesystem::remove(other_file);
+}
+
+// Test 35: Progress callbacks, a silent log and the collected metrics
+TEST_F(BPETest, TrainingProgressAndMetrics) {
+    std::vector<TrainProgress> reports;
+    std::ostringstream log;
+    TrainOptions options{.log = &log, .progress_interval = 10, .collect_metrics = true};
+    options.on_progress = [&](const TrainProgress& progress) { reports.push_back(progress); };
+    Trainer trainer;
+    Tokenizer tokenizer = trainer.train(test_corpus_file, 100, options);
+    const size_t merges = tokenizer.model().num_merges();
+
+    // One report per 10 merges, then a final one
+    ASSERT_EQ(reports.size(), merges / 10 + 1);
+    for (size_t i = 0; i + 1 < reports.size(); ++i) {
+        EXPECT_EQ(reports[i].merges, 10 * (i + 1));
+        EXPECT_FALSE(reports[i].done);
+        EXPECT_EQ(reports[i].last_token, tokenizer.model().token(reports[i].vocab_size - 1));
+        EXPECT_GT(reports[i].last_count, 0);
+    }
+    EXPECT_TRUE(reports.back().done);
+    EXPECT_EQ(reports.back().merges, merges);
+    EXPECT_EQ(reports.back().vocab_size, tokenizer.vocab_size());
+    EXPECT_NE(log.str().find("Merge 10/"), std::string::npos);
+
+    const TrainMetrics& metrics = trainer.metrics();
+    EXPECT_EQ(metrics.merges, merges);
+    EXPECT_EQ(metrics.corpus_words, 24u);
+    EXPECT_EQ(metrics.merge_ns.count, merges);
+    EXPECT_EQ(metrics.sites_per_merge.count, merges);
+    EXPECT_EQ(metrics.sites_per_merge.buckets[0], 0u);  // every merge visits a site
+    EXPECT_EQ(metrics.queue_samples.size(), reports.size());
+    EXPECT_GE(metrics.total_seconds, metrics.merge_seconds);
+    std::string json = metrics.to_json();
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_NE(json.find("\"merges\":" + std::to_string(merges)), std::string::npos);
+
+    // Without collect_metrics nothing is recorded per merge; a null log is silent
+    std::ostringstream sink;
+    std::streambuf* saved = std::cout.rdbuf(sink.rdbuf());
+    Trainer quiet;
+    Tokenizer same = quiet.train(test_corpus_file, 100, TrainOptions{.log = nullptr});
+    std::cout.rdbuf(saved);
+    EXPECT_TRUE(sink.str().empty());
+    EXPECT_EQ(same.encode("the lazy fox"), tokenizer.encode("the lazy fox"));
+    EXPECT_EQ(quiet.metrics().merges, merges);
+    EXPECT_EQ(quiet.metrics().merge_ns.count, 0u);
+    EXPECT_TRUE(quiet.metrics().queue_samples.empty());
+}
+
+// Test 36: A run cut short and resumed from its checkpoint gives the same model
+TEST_F(BPETest, ResumeFromCheckpoint) {
+    const std::string checkpoint = "train.ckpt";
+    auto same_file = [](const std::string& a, const std::string& b) {
+        std::ifstream in_a(a, std::ios::binary), in_b(b, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in_a), std::istreambuf_iterator<char>()) ==
+               std::string(std::istreambuf_iterator<char>(in_b), std::istreambuf_iterator<char>());
+    };
+    Trainer trainer;
+    trainer.train(test_corpus_file, 100, TrainOptions{.log = nullptr}).save("full_model.txt");
+
+    // Crash after merge 25; the last checkpoint was written at merge 20
+    TrainOptions options{.log = nullptr, .progress_interval = 5,
+                         .checkpoint_path = checkpoint, .checkpoint_interval = 10};
+    options.on_progress = [](const TrainProgress& progress) {
+        if (progress.merges == 25) throw std::runtime_error("simulated crash");
+    };
+    EXPECT_THROW(trainer.train(test_corpus_file, 100, options), std::runtime_error);
+    ASSERT_TRUE(std::filesystem::exists(checkpoint));
+
+    for (MergeQueue queue : {MergeQueue::Indexed, MergeQueue::Lazy}) {
+        Tokenizer resumed = trainer.train("unused.txt", 100,
+                                          TrainOptions{.queue = queue, .log = nullptr, .resume_from = checkpoint});
+        resumed.save("resumed_model.txt");
+        EXPECT_TRUE(same_file("full_model.txt", "resumed_model.txt"));
+    }
+
+    // A finished run's checkpoint extends the model to a larger vocab
+    Tokenizer small = trainer.train(test_corpus_file, 60, TrainOptions{.log = nullptr, .checkpoint_path = checkpoint});
+    EXPECT_EQ(small.vocab_size(), 60);
+    trainer.train("unused.txt", 100, TrainOptions{.log = nullptr, .resume_from = checkpoint}).save("resumed_model.txt");
+    EXPECT_TRUE(same_file("full_model.txt", "resumed_model.txt"));
+
+    EXPECT_THROW(trainer.train("unused.txt", 100, TrainOptions{.byte_level = true, .log = nullptr, .resume_from = checkpoint}),
+                 std::runtime_error);
+    EXPECT_THROW(trainer.train("unused.txt", 100,
+                               TrainOptions{.continuation_prefix = "##", .log = nullptr, .resume_from = checkpoint}),
+                 std::runtime_error);
+    {
+        std::fstream file(checkpoint, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(200);
+        file.put('\x7f');
+    }
+    EXPECT_THROW(trainer.train("unused.txt", 100, TrainOptions{.log = nullptr, .resume_from = checkpoint}),
+                 std::runtime_error);
+
+    // The continuation prefix is part of the checkpoint
+    TrainOptions prefixed{.continuation_prefix = "##", .log = nullptr};
+    trainer.train(test_corpus_file, 100, prefixed).save("full_model.txt");
+    prefixed.checkpoint_path = checkpoint;
+    trainer.train(test_corpus_file, 60, prefixed);
+    prefixed.checkpoint_path.clear();
+    prefixed.resume_from = checkpoint;
+    trainer.train("unused.txt", 100, prefixed).save("resumed_model.txt");
+    EXPECT_TRUE(same_file("full_model.txt", "resumed_model.txt"));
+    EXPECT_THROW(trainer.train("unused.txt", 100, TrainOptions{.log = nullptr, .resume_from = checkpoint}),
+                 std::runtime_error);
+
+    // Periodic checkpoints count as checkpoint time, not also as merge time
+    trainer.train(test_corpus_file, 100, TrainOptions{.log = nullptr, .checkpoint_path = checkpoint,
+                                                      .checkpoint_interval = 1});
+    EXPECT_GT(trainer.metrics().checkpoint_seconds, 0.0);
+    EXPECT_LE(trainer.metrics().merge_seconds + trainer.metrics().checkpoint_seconds,
+              trainer.metrics().total_seconds);
+
+    for (const char* name : {"train.ckpt", "full_model.txt", "resumed_model.txt"}) {
+        std::filesystem::remove(name);
+    }
+}
+
+// Test 37: Continuing a smaller model gives the same model as a fresh run
+TEST_F(BPETest, TrainContinueMatchesFreshRun) {
+    auto read_file = [](const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    for (PreTokenizer mode : {PreTokenizer::Whitespace, PreTokenizer::CharClass}) {
+        TrainOptions options{.pretokenizer = mode, .log = nullptr};
+        Trainer trainer;
+        trainer.train(test_corpus_file, 100, options).save("fresh_model.txt");
+        trainer.train(test_corpus_file, 40, options).save("small_model.txt");
+
+        // Through the text format, as a model saved by an earlier run would be
+        Tokenizer small = Tokenizer::load("small_model.txt");
+        trainer.train_continue(small, test_corpus_file, 100, options).save("continued_model.txt");
+        EXPECT_EQ(read_file("fresh_model.txt"), read_file("continued_model.txt"));
+
+        TrainOptions plain = options;
+        plain.dedup_words = false;
+        trainer.train_continue(small, test_corpus_file, 100, plain).save("continued_model.txt");
+        EXPECT_EQ(read_file("fresh_model.txt"), read_file("continued_model.txt"));
+    }
+
+    // Bytes the model has no token for cannot be continued over
+    std::string other_file = "other_corpus.txt";
+    std::ofstream(other_file) << "the quick brown fox, 42 times\n";
+    Trainer trainer;
+    EXPECT_THROW(trainer.train_continue(Tokenizer::load("small_model.txt"), other_file, 100, TrainOptions{.log = nullptr}),
+                 std::runtime_error);
+    for (const char* name : {"fresh_model.txt", "small_model.txt", "continued_model.txt", "other_corpus.txt"}) {
+        std::filesystem::remove(name);
+    }
+}
+
+// Test 38: Special tokens become single ids, per call, and decode back
+TEST_F(BPETest, SpecialTokens) {
+    Trainer trainer;
+    Tokenizer tokenizer = trainer.train(test_corpus_file, 60, TrainOptions{.log = nullptr});
+    const uint32_t eos = tokenizer.model().token_id(EOS);
+    EXPECT_EQ(tokenizer.special_token_id(EOS), static_cast<int>(eos));
+
+    // EOS is registered by default and acts as a word boundary
+    std::string text = "the fox<|endoftext|>the dog";
+    std::vector<uint32_t> ids = tokenizer.encode(text);
+    std::vector<uint32_t> expected = tokenizer.encode("the fox");
+    expected.push_back(eos);
+    std::vector<uint32_t> tail = tokenizer.encode("the dog");
+    expected.insert(expected.end(), tail.begin(), tail.end());
+    EXPECT_EQ(ids, expected);
+    EXPECT_EQ(tokenizer.decode(ids), "the fox <|endoftext|>the dog");
+
+    // Added tokens get ids past the raw bytes; their spans cover the marker
+    const uint32_t first = tokenizer.vocab_size() + 256;
+    EXPECT_EQ(tokenizer.add_special_tokens({"<|im_start|>", "<|im_end|>", EOS}),
+              (std::vector<uint32_t>{first, first + 1, eos}));
+    EXPECT_EQ(tokenizer.add_special_tokens({"<|im_end|>"}), (std::vector<uint32_t>{first + 1}));
+    text = "<|im_start|>the fox<|im_end|>";
+    std::vector<TokenSpan> offsets;
+    ids.clear();
+    tokenizer.encode(text, ids, &offsets);
+    EXPECT_EQ(ids.front(), first);
+    EXPECT_EQ(ids.back(), first + 1);
+    EXPECT_EQ(offsets.front(), (TokenSpan{0, 12}));
+    EXPECT_EQ(offsets.back(), (TokenSpan{19, 29}));
+    EXPECT_EQ(tokenizer.tokenize(text).front(), "<|im_start|>");
+    EXPECT_EQ(tokenizer.decode(ids), "<|im_start|>the fox <|im_end|>");
+
+    // Per call: none, some, or reject the rest
+    SpecialTokenPolicy none{.mode = SpecialTokenPolicy::Mode::None};
+    ids = tokenizer.encode(text, none);
+    EXPECT_EQ(std::count(ids.begin(), ids.end(), first), 0);
+    EXPECT_EQ(tokenizer.decode(ids), text);
+    SpecialTokenPolicy listed{.mode = SpecialTokenPolicy::Mode::Listed, .allowed = {first + 1}};
+    ids = tokenizer.encode(text, listed);
+    EXPECT_NE(ids.front(), first);
+    EXPECT_EQ(ids.back(), first + 1);
+    listed.reject_disallowed = true;
+    EXPECT_THROW(tokenizer.encode(text, listed), std::runtime_error);
+    none.reject_disallowed = true;
+    EXPECT_THROW(tokenizer.encode(text, none), std::runtime_error);
+    EXPECT_NO_THROW(tokenizer.encode("the fox", none));
+}
+
+// Test 39: Special token text in the corpus is continued over as plain bytes,
+// merge for merge as a fresh run learns it
+TEST_F(BPETest, TrainContinueTreatsSpecialTokensAsText) {
+    std::string corpus_file = "eos_corpus.txt";
+    {
+        std::ofstream corpus(corpus_file);
+        for (int i = 0; i < 10; ++i) {
+            corpus << "the quick brown fox <|endoftext|> jumps over the lazy dog<|endoftext|>\n";
+        }
+    }
+    Trainer trainer;
+    Tokenizer fresh = trainer.train(corpus_file, 90, TrainOptions{.log = nullptr});
+    Tokenizer small = trainer.train(corpus_file, 50, TrainOptions{.log = nullptr});
+    ASSERT_NE(small.special_token_id(EOS), -1);
+    Tokenizer continued = trainer.train_continue(small, corpus_file, 90, TrainOptions{.log = nullptr});
+
+    const ModelImage& expected = fresh.model();
+    const ModelImage& actual = continued.model();
+    ASSERT_EQ(actual.num_merges(), expected.num_merges());
+    for (size_t r = 0; r < expected.num_merges(); ++r) {
+        EXPECT_EQ(actual.merge(r).left, expected.merge(r).left) << "merge " << r;
+        EXPECT_EQ(actual.merge(r).right, expected.merge(r).right) << "merge " << r;
+        EXPECT_EQ(actual.merge(r).merged, expected.merge(r).merged) << "merge " << r;
+    }
+    EXPECT_EQ(continued.encode("fox <|endoftext|>"), fresh.encode("fox <|endoftext|>"));
+    std::filesystem::remove(corpus_file);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include "corpus_reader.hpp"
+#include "scratch_dir.hpp"
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Test fixture for CorpusReader tests
+class CorpusReaderTest : public ::testing::Test {
+protected:
+    ScratchDir scratch;  // the test runs in its own directory
+
+    const std::string corpus_file = "test_corpus_reader.txt";
+
+    void write_corpus(const std::string& text) {
+        std::ofstream out(corpus_file, std::ios::binary);
+        out << text;
+    }
+
+    // Words as `istream >> string` sees them
+    static std::vector<std::string> reference_words(const std::string& text) {
+        std::istringstream in(text);
+        std::vector<std::string> words;
+        std::string word;
+        while (in >> word) words.push_back(word);
+        return words;
+    }
+
+    std::vector<std::string> read_all(size_t block_size, PreTokenizer mode = PreTokenizer::Whitespace) {
+        CorpusReader reader(corpus_file, block_size, mode);
+        std::vector<std::string> words;
+        std::vector<std::string_view> block;
+        while (reader.next(block)) {
+            EXPECT_FALSE(block.empty());
+            words.insert(words.end(), block.begin(), block.end());
+        }
+        EXPECT_EQ(reader.bytes_read(), reader.file_size());
+        return words;
+    }
+
+    // Pieces of the CharClass pre-tokenizer, one byte at a time
+    static std::vector<std::string> reference_pieces(const std::string& text) {
+        auto byte_class = [](unsigned char c) {
+            if (c == ' ' || (c >= '\t' && c <= '\r')) return 0;
+            if (c >= '0' && c <= '9') return 1;
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80) return 2;
+            return 3;
+        };
+        std::vector<std::string> pieces;
+        for (size_t i = 0; i < text.size();) {
+            size_t j = i + 1;
+            while (j < text.size() && byte_class(text[j]) == byte_class(text[i])) ++j;
+            if (byte_class(text[i]) != 0) pieces.push_back(text.substr(i, j - i));
+            i = j;
+        }
+        return pieces;
+    }
+
+    // Random text mixing every whitespace byte with bytes next to them
+    static std::string random_text(size_t n, unsigned seed) {
+        const std::string alphabet = " \t\n\v\f\r\x08\x0e\x1f!ab\x80\xff/09:@AZ[`z{'";
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+        std::string text;
+        for (size_t i = 0; i < n; ++i) text += alphabet[pick(rng)];
+        return text;
+    }
+};
+
+// Test 1: split_words matches istream word extraction
+TEST_F(CorpusReaderTest, SplitMatchesIstream) {
+    for (unsigned seed = 0; seed < 50; ++seed) {
+        std::string text = random_text(1 + seed * 37, seed);
+        std::vector<std::string_view> views;
+        split_words(text, views);
+        std::vector<std::string> words(views.begin(), views.end());
+        ASSERT_EQ(words, reference_words(text)) << "seed " << seed;
+    }
+}
+
+// Test 2: Words cut by block boundaries are carried over
+TEST_F(CorpusReaderTest, WordsSpanBlocks) {
+    std::string text = random_text(20000, 7);
+    write_corpus(text);
+    for (size_t block_size : {1, 3, 64, 100, 4096}) {
+        EXPECT_EQ(read_all(block_size), reference_words(text)) << "block " << block_size;
+    }
+}
+
+// Test 3: A word longer than the block is read whole
+TEST_F(CorpusReaderTest, WordLongerThanBlock) {
+    std::string long_word(1000, 'x');
+    write_corpus("a " + long_word + "\nb");
+    EXPECT_EQ(read_all(16), (std::vector<std::string>{"a", long_word, "b"}));
+}
+
+// Test 4: Empty and whitespace-only files have no words
+TEST_F(CorpusReaderTest, EmptyFile) {
+    write_corpus("");
+    EXPECT_TRUE(read_all(64).empty());
+    write_corpus(" \n\t\n  ");
+    EXPECT_TRUE(read_all(2).empty());
+}
+
+// Test 5: Missing file throws
+TEST_F(CorpusReaderTest, MissingFileThrows) {
+    EXPECT_THROW(CorpusReader("nonexistent_corpus.txt"), std::runtime_error);
+}
+
+// Test 6: CharClass pieces match a byte-at-a-time split, on any alignment
+TEST_F(CorpusReaderTest, CharClassMatchesReference) {
+    for (unsigned seed = 0; seed < 50; ++seed) {
+        std::string text = random_text(1 + seed * 41, seed);
+        std::vector<std::string_view> views;
+        pretokenize(text, PreTokenizer::CharClass, views);
+        std::vector<std::string> pieces(views.begin(), views.end());
+        ASSERT_EQ(pieces, reference_pieces(text)) << "seed " << seed;
+    }
+    std::vector<std::string_view> views;
+    std::string text = "it's 42%, na\xc3\xafve";
+    pretokenize(text, PreTokenizer::CharClass, views);
+    EXPECT_EQ(std::vector<std::string>(views.begin(), views.end()),
+              (std::vector<std::string>{"it", "'", "s", "42", "%,", "na\xc3\xafve"}));
+    EXPECT_FALSE(ends_word(views[0], text));
+    EXPECT_TRUE(ends_word(views[2], text));
+    EXPECT_TRUE(ends_word(views[5], text));
+}
+
+// Test 7: The reader splits CharClass pieces across block boundaries
+TEST_F(CorpusReaderTest, CharClassSpansBlocks) {
+    std::string text = random_text(20000, 11);
+    write_corpus(text);
+    for (size_t block_size : {1, 3, 64, 100, 4096}) {
+        EXPECT_EQ(read_all(block_size, PreTokenizer::CharClass), reference_pieces(text)) << "block " << block_size;
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
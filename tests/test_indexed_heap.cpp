@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include "indexed_heap.hpp"
+#include <random>
 #include <unordered_map>
+#include <vector>
 
 // Test fixture for IndexedHeap tests
 class IndexedHeapTest : public ::testing::Test {
@@ -220,6 +222,62 @@ TEST_F(IndexedHeapTest, PushDuplicate) {
     EXPECT_EQ(top->priority, 20);
 }
 
+// Test 10: Nodes know whether they are in the heap
+TEST_F(IndexedHeapTest, NodePositionTracked) {
+    for (int i = 0; i < 3; ++i) {
+        nodes[i] = HeapNode();
+        nodes[i].tok_ids = {i, i};
+        nodes[i].priority = i;
+        heap.push(&nodes[i]);
+        EXPECT_GE(nodes[i].heap_index, 0);
+    }
+    HeapNode* top = heap.pop();
+    EXPECT_EQ(top->heap_index, -1);
+    heap.updatePriority(top, 100);  // no longer in the heap
+    EXPECT_EQ(heap.top()->priority, 1);
+
+    heap.remove(&nodes[0]);
+    EXPECT_EQ(nodes[0].heap_index, -1);
+    heap.clear();
+    EXPECT_EQ(nodes[1].heap_index, -1);
+    EXPECT_TRUE(heap.empty());
+}
+
+// Test 11: Binary and 4-ary layouts pop the same order under random updates
+TEST_F(IndexedHeapTest, AritiesAgree) {
+    const int n = 2000;
+    std::vector<HeapNode> binary_nodes(n), quaternary_nodes(n);
+    DaryIndexedHeap<2> binary;
+    DaryIndexedHeap<4> quaternary;
+    std::mt19937 rng(7);
+    for (int i = 0; i < n; ++i) {
+        binary_nodes[i].tok_ids = quaternary_nodes[i].tok_ids = {i % 50, i};
+        binary_nodes[i].priority = quaternary_nodes[i].priority = rng() % 20;
+        binary.push(&binary_nodes[i]);
+        quaternary.push(&quaternary_nodes[i]);
+    }
+    for (int step = 0; step < 20000; ++step) {
+        int i = rng() % n;
+        int priority = rng() % 20;
+        if (step % 97 == 0) {
+            binary.remove(&binary_nodes[i]);
+            quaternary.remove(&quaternary_nodes[i]);
+        } else {
+            binary.updatePriority(&binary_nodes[i], priority);
+            quaternary.updatePriority(&quaternary_nodes[i], priority);
+        }
+    }
+    ASSERT_EQ(binary.size(), quaternary.size());
+    int last_priority = 1 << 30;
+    while (!binary.empty()) {
+        HeapNode* a = binary.pop();
+        HeapNode* b = quaternary.pop();
+        ASSERT_EQ(a->tok_ids, b->tok_ids);
+        ASSERT_LE(a->priority, last_priority);
+        last_priority = a->priority;
+    }
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "bpe.hpp"
+#include "model_image.hpp"
+#include "scratch_dir.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Test fixture for ModelImage tests
+class ModelImageTest : public ::testing::Test {
+protected:
+    ScratchDir scratch;  // the test runs in its own directory
+
+    void SetUp() override {
+        // a, b, c, ab, abc, plus an unused id and a duplicate "ab"
+        tokens = {"</w>", "a", "b", "c", "ab", "abc", "", "ab"};
+        merges = {{1, 2}, {7, 3}, {2, 3}, {1, 2}};
+    }
+
+    std::vector<std::string> tokens;
+    std::vector<std::pair<int, int>> merges;
+};
+
+// Test 1: Lookups on a built image
+TEST_F(ModelImageTest, BuildAndLookup) {
+    ModelImage image = ModelImage::build(tokens, merges);
+
+    EXPECT_EQ(image.vocab_size(), 8);
+    EXPECT_EQ(image.num_merges(), 4);
+    EXPECT_EQ(image.token(5), "abc");
+    EXPECT_EQ(image.token(6), "");
+    EXPECT_EQ(image.token_id("abc"), 5);
+    EXPECT_EQ(image.token_id("ab"), 7);  // latest id wins
+    EXPECT_EQ(image.token_id("zzz"), -1);
+    EXPECT_EQ(image.byte_id('b'), 2);
+    EXPECT_EQ(image.byte_id('z'), -1);
+}
+
+// Test 2: Pair table and merge chain
+TEST_F(ModelImageTest, PairTable) {
+    ModelImage image = ModelImage::build(tokens, merges);
+
+    EXPECT_EQ(image.find_pair(1, 2), 0);
+    EXPECT_EQ(image.merge(0).merged, 7);
+    EXPECT_EQ(image.merge(0).next_rank, 3);
+    EXPECT_EQ(image.find_pair(7, 3), 1);
+    EXPECT_EQ(image.merge(1).merged, 5);
+    // "bc" is not in the vocab, so that merge never fires
+    EXPECT_EQ(image.find_pair(2, 3), -1);
+    EXPECT_EQ(image.merge(2).merged, -1);
+    EXPECT_EQ(image.find_pair(3, 1), -1);
+}
+
+// Test 3: Binary round trip through mmap
+TEST_F(ModelImageTest, BinaryRoundTrip) {
+    ModelImage built = ModelImage::build(tokens, merges);
+    built.write_binary("model_test.bin");
+
+    ASSERT_TRUE(ModelImage::is_binary_file("model_test.bin"));
+    ModelImage mapped = ModelImage::map_file("model_test.bin");
+    EXPECT_EQ(mapped.size_bytes(), built.size_bytes());
+    for (int id = 0; id < built.vocab_size(); ++id) {
+        EXPECT_EQ(mapped.token(id), built.token(id));
+    }
+    EXPECT_EQ(mapped.find_pair(7, 3), 1);
+    EXPECT_EQ(mapped.token_id("abc"), 5);
+}
+
+// Test 4: Text round trip
+TEST_F(ModelImageTest, TextRoundTrip) {
+    ModelImage built = ModelImage::build(tokens, merges);
+    built.write_text("model_test.txt");
+    EXPECT_FALSE(ModelImage::is_binary_file("model_test.txt"));
+
+    ModelImage loaded = ModelImage::load_text("model_test.txt");
+    EXPECT_EQ(loaded.num_merges(), 4);
+    EXPECT_EQ(loaded.token_id("abc"), 5);
+    EXPECT_EQ(loaded.find_pair(7, 3), 1);
+}
+
+// Test 5: Corrupted binary files are rejected
+TEST_F(ModelImageTest, RejectsCorruption) {
+    ModelImage::build(tokens, merges).write_binary("model_test.bin");
+    {
+        std::fstream f("model_test.bin", std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(-3, std::ios::end);
+        f.put('\x7f');
+    }
+    EXPECT_THROW(ModelImage::map_file("model_test.bin"), std::runtime_error);
+
+    // An out-of-range merge id is caught even with the checksum skipped
+    ModelImage::build(tokens, merges).write_binary("model_test.bin");
+    {
+        std::fstream f("model_test.bin", std::ios::in | std::ios::out | std::ios::binary);
+        uint64_t merges_off;
+        f.seekg(56);  // Header::merges_off
+        f.read(reinterpret_cast<char*>(&merges_off), sizeof(merges_off));
+        const int32_t bad_id = 1 << 30;
+        f.seekp(merges_off);
+        f.write(reinterpret_cast<const char*>(&bad_id), sizeof(bad_id));
+    }
+    EXPECT_THROW(ModelImage::map_file("model_test.bin", false), std::runtime_error);
+    EXPECT_THROW(Tokenizer::load("model_test.bin"), std::runtime_error);
+
+    // So is a token table with no empty slot, where a failed lookup would
+    // never stop probing
+    ModelImage::build(tokens, merges).write_binary("model_test.bin");
+    {
+        std::fstream f("model_test.bin", std::ios::in | std::ios::out | std::ios::binary);
+        uint32_t table_size;
+        uint64_t table_off;
+        f.seekg(24);  // Header::token_table_size
+        f.read(reinterpret_cast<char*>(&table_size), sizeof(table_size));
+        f.seekg(72);  // Header::token_table_off
+        f.read(reinterpret_cast<char*>(&table_off), sizeof(table_off));
+        const std::vector<int32_t> full(table_size, 0);
+        f.seekp(table_off);
+        f.write(reinterpret_cast<const char*>(full.data()), full.size() * sizeof(int32_t));
+    }
+    EXPECT_THROW(ModelImage::map_file("model_test.bin", false), std::runtime_error);
+
+    std::ofstream("model_test.bin", std::ios::binary) << "BPEMODEL";
+    EXPECT_THROW(ModelImage::map_file("model_test.bin"), std::runtime_error);
+}
+
+// Test 6: Unsupported versions are rejected
+TEST_F(ModelImageTest, RejectsVersion) {
+    ModelImage::build(tokens, merges).write_binary("model_test.bin");
+    {
+        std::fstream f("model_test.bin", std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(8);
+        f.put('\x09');
+    }
+    EXPECT_THROW(ModelImage::map_file("model_test.bin"), std::runtime_error);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
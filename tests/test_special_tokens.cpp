@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "special_tokens.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+// Test fixture for SpecialTokenMatcher tests
+class SpecialTokenMatcherTest : public ::testing::Test {
+protected:
+    // All matches, found by scanning from the end of the previous one
+    static std::vector<SpecialTokenMatcher::Match> find_all(const SpecialTokenMatcher& matcher, std::string_view text) {
+        std::vector<SpecialTokenMatcher::Match> matches;
+        SpecialTokenMatcher::Match match;
+        size_t from = 0;
+        while (matcher.find(text, from, match)) {
+            matches.push_back(match);
+            from = match.end;
+        }
+        return matches;
+    }
+
+    // Leftmost-longest by trying every pattern at every position
+    static std::vector<SpecialTokenMatcher::Match> brute_force(const std::vector<std::string>& patterns,
+                                                               std::string_view text) {
+        std::vector<SpecialTokenMatcher::Match> matches;
+        size_t i = 0;
+        while (i < text.size()) {
+            int best = -1;
+            for (size_t p = 0; p < patterns.size(); ++p) {
+                if (text.substr(i).starts_with(patterns[p]) &&
+                    (best < 0 || patterns[p].size() > patterns[best].size())) {
+                    best = static_cast<int>(p);
+                }
+            }
+            if (best < 0) {
+                ++i;
+                continue;
+            }
+            matches.push_back({i, i + patterns[best].size(), static_cast<uint32_t>(best)});
+            i += patterns[best].size();
+        }
+        return matches;
+    }
+
+    static bool same(const std::vector<SpecialTokenMatcher::Match>& a, const std::vector<SpecialTokenMatcher::Match>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].begin != b[i].begin || a[i].end != b[i].end || a[i].pattern != b[i].pattern) return false;
+        }
+        return true;
+    }
+};
+
+// Test 1: Chat markers are found where they are, longest first at a shared start
+TEST_F(SpecialTokenMatcherTest, ChatMarkers) {
+    SpecialTokenMatcher matcher({"<|im_start|>", "<|im_end|>", "<|endoftext|>", "<|im"});
+    std::string text = "<|im_start|>user\nhi<|im_end|><|im<|endoftext|>";
+    auto matches = find_all(matcher, text);
+    ASSERT_EQ(matches.size(), 4u);
+    EXPECT_EQ(matches[0].begin, 0u);
+    EXPECT_EQ(matches[0].pattern, 0u);
+    EXPECT_EQ(text.substr(matches[1].begin, matches[1].end - matches[1].begin), "<|im_end|>");
+    EXPECT_EQ(matches[2].pattern, 3u);
+    EXPECT_EQ(matches[3].pattern, 2u);
+    EXPECT_EQ(matches[3].end, text.size());
+
+    SpecialTokenMatcher::Match match;
+    EXPECT_FALSE(matcher.find("no markers <| here", 0, match));
+    EXPECT_FALSE(SpecialTokenMatcher().find(text, 0, match));
+    EXPECT_THROW(SpecialTokenMatcher({"a", ""}), std::runtime_error);
+}
+
+// Test 2: Same matches as a brute-force scan for overlapping random patterns
+TEST_F(SpecialTokenMatcherTest, MatchesBruteForce) {
+    std::mt19937 rng(11);
+    auto random_string = [&](const std::string& alphabet, size_t max_len) {
+        std::string s;
+        for (size_t n = 1 + rng() % max_len; n > 0; --n) s += alphabet[rng() % alphabet.size()];
+        return s;
+    };
+    for (int round = 0; round < 200; ++round) {
+        // One alphabet gives a single start byte (the memchr path), the other many
+        const std::string alphabet = round % 2 ? "abc" : "<ab";
+        std::vector<std::string> patterns;
+        for (int i = 1 + rng() % 6; i > 0; --i) {
+            patterns.push_back(round % 2 ? random_string(alphabet, 5) : "<" + random_string(alphabet, 4));
+        }
+        SpecialTokenMatcher matcher(patterns);
+        for (int i = 0; i < 20; ++i) {
+            std::string text = random_string(alphabet, 60);
+            EXPECT_TRUE(same(find_all(matcher, text), brute_force(patterns, text)))
+                << "text " << text << " round " << round;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include "stream_encoder.hpp"
+#include "scratch_dir.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Test fixture for StreamEncoder tests
+class StreamEncoderTest : public ::testing::Test {
+protected:
+    ScratchDir scratch;  // the test runs in its own directory
+
+    void SetUp() override {
+        std::ofstream corpus(corpus_file);
+        for (int i = 0; i < 20; ++i) {
+            corpus << "the quick brown fox jumps over the lazy dog, it's 42% done\n";
+            corpus << "a quick brown animal jumps high over the lazy fox's den\n";
+        }
+    }
+
+    Tokenizer train_model(PreTokenizer mode) {
+        Trainer trainer;
+        Tokenizer tokenizer = trainer.train(corpus_file, 80, TrainOptions{.pretokenizer = mode, .log = nullptr});
+        tokenizer.add_special_tokens({"<|im_start|>user\n", "<|im_end|>", "<|im"});
+        return tokenizer;
+    }
+
+    // Words, odd whitespace, special tokens and long runs without spaces
+    static std::string random_text(std::mt19937& rng, size_t pieces) {
+        const std::vector<std::string> parts = {
+            "the", "quick", "fox's", "42%", "lazy", " ", "  ", "\n", "\t", "<|endoftext|>", "<|im_start|>user\n",
+            "<|im_end|>", "<|im", "<|", "jumpsjumpsjumpsjumpsjumps", "\xc3\xa9t\xc3\xa9"};
+        std::string text;
+        for (size_t i = 0; i < pieces; ++i) text += parts[rng() % parts.size()];
+        return text;
+    }
+
+    std::string corpus_file = "stream_corpus.txt";
+};
+
+// Test 1: Any chunking and block size gives the ids of encoding the whole text
+TEST_F(StreamEncoderTest, MatchesWholeTextEncode) {
+    std::mt19937 rng(5);
+    std::vector<SpecialTokenPolicy> policies = {
+        {},
+        {.mode = SpecialTokenPolicy::Mode::None},
+        {.mode = SpecialTokenPolicy::Mode::Listed, .allowed = {1}},
+    };
+    for (PreTokenizer mode : {PreTokenizer::Whitespace, PreTokenizer::CharClass}) {
+        Tokenizer tokenizer = train_model(mode);
+        for (int round = 0; round < 60; ++round) {
+            const std::string text = random_text(rng, 1 + rng() % 80);
+            const SpecialTokenPolicy& special = policies[round % policies.size()];
+            const size_t block = 1 + rng() % 64;
+            std::vector<uint32_t> streamed;
+            StreamEncoder encoder(tokenizer, [&](std::span<const uint32_t> ids) {
+                streamed.insert(streamed.end(), ids.begin(), ids.end());
+            }, special, block);
+            for (size_t at = 0; at < text.size();) {
+                size_t len = std::min<size_t>(rng() % 40, text.size() - at);
+                encoder.write(std::string_view(text).substr(at, len));
+                at += len;
+            }
+            encoder.finish();
+            EXPECT_EQ(streamed, tokenizer.encode(text, special)) << "round " << round << " block " << block;
+            EXPECT_EQ(encoder.tokens_emitted(), streamed.size());
+            EXPECT_EQ(encoder.bytes_written(), text.size());
+        }
+    }
+}
+
+// Test 2: istream, fd and callback input; tokens leave before the stream ends
+TEST_F(StreamEncoderTest, SourcesAndBoundedBuffer) {
+    Tokenizer tokenizer = train_model(PreTokenizer::Whitespace);
+    std::mt19937 rng(9);
+    const std::string text = random_text(rng, 5000);
+    const std::vector<uint32_t> expected = tokenizer.encode(text);
+    std::vector<uint32_t> streamed;
+    auto sink = [&](std::span<const uint32_t> ids) { streamed.insert(streamed.end(), ids.begin(), ids.end()); };
+
+    std::istringstream in(text);
+    EXPECT_EQ(encode_stream(tokenizer, in, sink, {}, 256), expected.size());
+    EXPECT_EQ(streamed, expected);
+
+    const std::string path = "stream_input.txt";
+    std::ofstream(path, std::ios::binary) << text;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    streamed.clear();
+    EXPECT_EQ(encode_stream(tokenizer, fd, sink, {}, 1000), expected.size());
+    ::close(fd);
+    std::filesystem::remove(path);
+    EXPECT_EQ(streamed, expected);
+
+    size_t at = 0;
+    streamed.clear();
+    encode_stream(tokenizer, [&](char* buffer, size_t capacity) {
+        size_t n = std::min({capacity, size_t(7), text.size() - at});
+        std::memcpy(buffer, text.data() + at, n);
+        at += n;
+        return n;
+    }, sink);
+    EXPECT_EQ(streamed, expected);
+
+    // Only the unfinished word is held back
+    streamed.clear();
+    StreamEncoder encoder(tokenizer, sink, {}, 64);
+    encoder.write("the quick brown fox jum");
+    EXPECT_EQ(streamed, tokenizer.encode("the quick brown fox "));
+    EXPECT_EQ(encoder.buffered(), 3u);
+    for (int i = 0; i < 10000; ++i) {
+        encoder.write("the lazy dog ");
+        EXPECT_LE(encoder.buffered(), 3u);
+    }
+    encoder.finish();
+    EXPECT_EQ(encoder.buffered(), 0u);
+
+    SpecialTokenPolicy reject{.mode = SpecialTokenPolicy::Mode::None, .reject_disallowed = true};
+    StreamEncoder strict(tokenizer, sink, reject);
+    EXPECT_THROW({
+        strict.write("the fox <|im_end|> ");
+        strict.finish();
+    }, std::runtime_error);
+}
+
+// Test 3: A run with no safe cut is not rescanned on every write and is
+// encoded in pieces once it passes max_pending
+TEST_F(StreamEncoderTest, LongRunWithoutCut) {
+    Tokenizer tokenizer = train_model(PreTokenizer::Whitespace);
+    std::vector<uint32_t> streamed;
+    auto sink = [&](std::span<const uint32_t> ids) { streamed.insert(streamed.end(), ids.begin(), ids.end()); };
+
+    // Below the limit nothing leaves until the word ends, and the ids match
+    // the whole-text encode
+    const std::string word(100000, 'o');
+    StreamEncoder exact(tokenizer, sink, {}, 64, word.size() + 1);
+    for (size_t at = 0; at < word.size(); at += 10) exact.write(std::string_view(word).substr(at, 10));
+    EXPECT_TRUE(streamed.empty());
+    EXPECT_EQ(exact.buffered(), word.size());
+    exact.write(" fox");
+    EXPECT_EQ(exact.buffered(), 3u);
+    exact.finish();
+    EXPECT_EQ(streamed, tokenizer.encode(word + " fox"));
+
+    // Past the limit the run leaves in pieces and the buffer stays bounded;
+    // a special token at the end of the buffer is not split
+    for (const SpecialTokenPolicy& special : {SpecialTokenPolicy{}, SpecialTokenPolicy{.mode = SpecialTokenPolicy::Mode::None}}) {
+        streamed.clear();
+        StreamEncoder bounded(tokenizer, sink, special, 64, 1024);
+        for (int i = 0; i < 100000; ++i) {
+            bounded.write("\xc3\xa9o");
+            ASSERT_LT(bounded.buffered(), 1024u + 64);
+        }
+        EXPECT_FALSE(streamed.empty());
+        bounded.write("<|im_end|>");
+        EXPECT_LT(bounded.buffered(), 1024u + 64);
+        bounded.finish();
+        EXPECT_EQ(bounded.bytes_written(), 300010u);
+        const bool has_end = std::find(streamed.begin(), streamed.end(),
+                                       static_cast<uint32_t>(tokenizer.special_token_id("<|im_end|>"))) != streamed.end();
+        EXPECT_EQ(has_end, special.mode == SpecialTokenPolicy::Mode::All);
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
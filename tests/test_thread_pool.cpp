@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "thread_pool.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+// Test fixture for ThreadPool tests
+class ThreadPoolTest : public ::testing::Test {
+protected:
+    ThreadPool pool{4};
+};
+
+// Test 1: Every index is visited exactly once
+TEST_F(ThreadPoolTest, VisitsEveryIndexOnce) {
+    std::vector<std::atomic<int>> hits(10007);
+    pool.parallel_for(hits.size(), 13, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) hits[i]++;
+    });
+    for (const auto& h : hits) {
+        ASSERT_EQ(h.load(), 1);
+    }
+}
+
+// Test 2: Chunks respect the grain size
+TEST_F(ThreadPoolTest, ChunksRespectGrain) {
+    std::atomic<size_t> chunks{0};
+    std::atomic<bool> too_big{false};
+    pool.parallel_for(100, 7, [&](size_t begin, size_t end) {
+        chunks++;
+        if (end - begin > 7) too_big = true;
+    });
+    EXPECT_EQ(chunks.load(), 15);
+    EXPECT_FALSE(too_big.load());
+}
+
+// Test 3: Empty range is a no-op
+TEST_F(ThreadPoolTest, EmptyRange) {
+    bool called = false;
+    pool.parallel_for(0, 8, [&](size_t, size_t) { called = true; });
+    EXPECT_FALSE(called);
+}
+
+// Test 4: Exceptions reach the caller after all chunks finish
+TEST_F(ThreadPoolTest, PropagatesExceptions) {
+    std::atomic<int> finished{0};
+    EXPECT_THROW({
+        pool.parallel_for(64, 1, [&](size_t begin, size_t) {
+            if (begin == 17) throw std::runtime_error("boom");
+            finished++;
+        });
+    }, std::runtime_error);
+    EXPECT_EQ(finished.load(), 63);
+
+    // Pool is still usable afterwards
+    std::atomic<int> count{0};
+    pool.parallel_for(10, 1, [&](size_t, size_t) { count++; });
+    EXPECT_EQ(count.load(), 10);
+}
+
+// Test 5: Uneven work is balanced by stealing
+TEST_F(ThreadPoolTest, UnevenWork) {
+    std::vector<long long> out(256, 0);
+    pool.parallel_for(out.size(), 1, [&](size_t begin, size_t) {
+        long long acc = 0;
+        long long iters = begin < 8 ? 200000 : 100;
+        for (long long k = 0; k < iters; ++k) acc += k % 7;
+        out[begin] = acc;
+    });
+    for (size_t i = 0; i < out.size(); ++i) {
+        EXPECT_GT(out[i], 0);
+    }
+}
+
+// Test 6: Concurrent callers share one pool
+TEST_F(ThreadPoolTest, ConcurrentCallers) {
+    std::atomic<long long> total{0};
+    std::vector<std::thread> callers;
+    for (int t = 0; t < 4; ++t) {
+        callers.emplace_back([&] {
+            pool.parallel_for(1000, 10, [&](size_t begin, size_t end) {
+                total += end - begin;
+            });
+        });
+    }
+    for (auto& caller : callers) caller.join();
+    EXPECT_EQ(total.load(), 4000);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include "bpe.hpp"
+#include "token_shards.hpp"
+#include "scratch_dir.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Test fixture for TokenShardWriter tests
+class TokenShardsTest : public ::testing::Test {
+protected:
+    ScratchDir scratch;  // the test runs in its own directory
+
+    std::string dir = "test_shards";
+};
+
+// Test 1: Documents roll over into new shards at document ends and read back intact
+TEST_F(TokenShardsTest, RolloverAndReadBack) {
+    for (TokenWidth width : {TokenWidth::U16, TokenWidth::U32}) {
+        std::filesystem::remove_all(dir);
+        std::vector<std::vector<uint32_t>> docs;
+        for (uint32_t d = 0; d < 10; ++d) {
+            std::vector<uint32_t> doc(3 + d * 7 % 11);
+            std::iota(doc.begin(), doc.end(), d * 1000);
+            docs.push_back(doc);
+        }
+        docs[4].clear();  // an empty document is kept
+
+        TokenShardWriter writer(dir, width, 20);
+        for (const auto& doc : docs) {
+            // Written in two pieces, as chunks of one document arrive
+            writer.write(std::span(doc).first(doc.size() / 2));
+            writer.write(std::span(doc).subspan(doc.size() / 2));
+            writer.end_document();
+        }
+        writer.finish();
+        EXPECT_EQ(writer.documents(), docs.size());
+        EXPECT_GT(writer.shards(), 1u);
+
+        std::vector<std::vector<uint32_t>> read_back;
+        uint64_t tokens = 0;
+        for (size_t s = 0; s < writer.shards(); ++s) {
+            TokenShard shard = TokenShard::read(writer.shard_path(s));
+            EXPECT_EQ(shard.width, width);
+            EXPECT_EQ(std::filesystem::file_size(writer.shard_path(s) + ".bin"),
+                      shard.tokens.size() * static_cast<size_t>(width));
+            // Only the last document of a shard may take it past the limit
+            EXPECT_LT(shard.doc_offsets[shard.num_docs() - 1], 20u);
+            for (size_t d = 0; d < shard.num_docs(); ++d) {
+                read_back.emplace_back(shard.tokens.begin() + shard.doc_offsets[d],
+                                       shard.tokens.begin() + shard.doc_offsets[d + 1]);
+            }
+            tokens += shard.tokens.size();
+        }
+        EXPECT_EQ(read_back, docs);
+        EXPECT_EQ(tokens, writer.tokens());
+    }
+}
+
+// Test 2: Ids too wide for u16 and damaged files are errors
+TEST_F(TokenShardsTest, Errors) {
+    TokenShardWriter writer(dir, TokenWidth::U16, 100);
+    std::vector<uint32_t> ids = {1, 2, 70000};
+    EXPECT_THROW(writer.write(ids), std::runtime_error);
+    ids.pop_back();
+    writer.write(ids);
+    writer.end_document();
+    writer.finish();
+
+    EXPECT_EQ(TokenShard::read(writer.shard_path(0)).tokens, ids);
+    std::ofstream(writer.shard_path(0) + ".bin", std::ios::app) << "x";
+    EXPECT_THROW(TokenShard::read(writer.shard_path(0)), std::runtime_error);
+    std::ofstream(writer.shard_path(0) + ".idx", std::ios::binary) << "garbage";
+    EXPECT_THROW(TokenShard::read(writer.shard_path(0)), std::runtime_error);
+    EXPECT_THROW(TokenShard::read(writer.shard_path(1)), std::runtime_error);
+}
+
+// Test 3: tokenize-corpus cuts files into chunks without changing the ids,
+// and cuts a word or line with no safe cut only past four chunks
+TEST_F(TokenShardsTest, CorpusCliChunking) {
+    {
+        std::ofstream corpus("corpus.txt");
+        for (int i = 0; i < 20; ++i) corpus << "the quick brown fox jumps over the lazy dog, it's 42% done\n";
+    }
+    Trainer trainer;
+    Tokenizer tokenizer = trainer.train("corpus.txt", 80, TrainOptions{.log = nullptr});
+    tokenizer.save("model.txt");
+    tokenizer.add_special_tokens({"<|im_end|>"});
+    const uint32_t eos = static_cast<uint32_t>(tokenizer.special_token_id(EOS));
+
+    std::mt19937 rng(3);
+    const std::vector<std::string> parts = {"the", "quick", "fox's", "42%", " ", "  ", "\n", "\n\n", "\t",
+                                            "<|im_end|>", "<|endoftext|>", "\xc3\xa9t\xc3\xa9"};
+    std::string text;
+    for (int i = 0; i < 3000; ++i) text += parts[rng() % parts.size()];
+    std::ofstream("input.txt", std::ios::binary) << text;
+
+    auto run = [&](const std::string& args) {
+        std::filesystem::remove_all(dir);
+        const std::string command = std::string(TOKENIZE_CORPUS) + " --model model.txt --out " + dir +
+                                    " --special '<|im_end|>' --threads 2 --quiet " + args + " > /dev/null";
+        EXPECT_EQ(std::system(command.c_str()), 0) << command;
+        std::vector<std::vector<uint32_t>> docs;
+        std::vector<std::filesystem::path> shards;
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            if (entry.path().extension() == ".idx") shards.push_back(std::filesystem::path(entry.path()).replace_extension());
+        }
+        std::sort(shards.begin(), shards.end());
+        for (const auto& path : shards) {
+            TokenShard shard = TokenShard::read(path.string());
+            for (size_t d = 0; d < shard.num_docs(); ++d) {
+                docs.emplace_back(shard.tokens.begin() + shard.doc_offsets[d],
+                                  shard.tokens.begin() + shard.doc_offsets[d + 1]);
+            }
+        }
+        return docs;
+    };
+
+    // One document per file, whatever the chunk size
+    for (const char* chunk : {"16", "64", "100000"}) {
+        EXPECT_EQ(run(std::string("--chunk-bytes ") + chunk + " input.txt"),
+                  std::vector<std::vector<uint32_t>>{tokenizer.encode(text)}) << chunk;
+    }
+
+    // One document per non-blank line, with chunks a quarter of the longest line
+    std::vector<std::vector<uint32_t>> lines;
+    size_t longest = 0;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line);) {
+        longest = std::max(longest, line.size());
+        if (line.find_first_not_of(" \t\v\f\r") == std::string::npos) continue;
+        lines.push_back(tokenizer.encode(line));
+        lines.back().push_back(eos);
+    }
+    EXPECT_EQ(run("--docs line --eos --chunk-bytes " + std::to_string(longest / 4 + 1) + " input.txt"), lines);
+
+    // A 5000-byte word is cut with 64-byte chunks, but loses no bytes; with
+    // --docs line its line is still one document
+    const std::string word = "fox" + std::string(5000, 'o') + "\xc3\xa9";
+    std::ofstream("long.txt", std::ios::binary) << "the " << word << " dog\nthe fox\n";
+    std::vector<std::vector<uint32_t>> docs = run("--chunk-bytes 64 long.txt");
+    ASSERT_EQ(docs.size(), 1u);
+    std::string decoded = tokenizer.decode(docs[0]);
+    std::erase(decoded, ' ');
+    EXPECT_EQ(decoded, "the" + word + "dog" + "thefox");
+
+    docs = run("--docs line --chunk-bytes 64 long.txt");
+    ASSERT_EQ(docs.size(), 2u);
+    decoded = tokenizer.decode(docs[0]);
+    std::erase(decoded, ' ');
+    EXPECT_EQ(decoded, "the" + word + "dog");
+    EXPECT_EQ(docs[1], tokenizer.encode("the fox"));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
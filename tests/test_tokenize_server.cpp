@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include "tokenize_server.hpp"
+#include "scratch_dir.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+// Test fixture for TokenizeServer tests
+class TokenizeServerTest : public ::testing::Test {
+protected:
+    ScratchDir scratch;  // the test runs in its own directory
+
+    void SetUp() override {
+        std::ofstream corpus(corpus_file);
+        for (int i = 0; i < 20; ++i) {
+            corpus << "the quick brown fox jumps over the lazy dog, it's 42% done\n";
+            corpus << "a quick brown animal jumps high over the lazy fox's den\n";
+        }
+        corpus.close();
+        Trainer trainer;
+        tokenizer = std::make_shared<const Tokenizer>(trainer.train(corpus_file, 80, TrainOptions{.log = nullptr}));
+    }
+
+    std::string socket_path() const {
+        return (std::filesystem::temp_directory_path() / ("test_server_" + std::to_string(::getpid()) + ".sock")).string();
+    }
+
+    const std::vector<std::string> texts = {
+        "the quick brown fox", "jumps over the lazy dog", "", "it's 42% done<|endoftext|>", "\xc3\xa9t\xc3\xa9 fox"};
+    std::string corpus_file = "server_corpus.txt";
+    std::shared_ptr<const Tokenizer> tokenizer;
+};
+
+// Test 1: Encode, decode and stats over a Unix socket agree with the Tokenizer,
+// also for concurrent clients pipelining requests
+TEST_F(TokenizeServerTest, UnixSocketMatchesTokenizer) {
+    TokenizeServer server(tokenizer, ServerOptions{.unix_socket = socket_path(), .threads = 2});
+    server.start();
+    EXPECT_EQ(server.port(), 0);
+
+    TokenizeClient client = TokenizeClient::connect_unix(socket_path());
+    for (const auto& text : texts) {
+        std::vector<uint32_t> ids = client.encode(text);
+        EXPECT_EQ(ids, tokenizer->encode(text)) << text;
+        EXPECT_EQ(client.decode(ids), tokenizer->decode(ids));
+    }
+
+    // An error answers only its own request; the connection stays usable
+    std::vector<uint32_t> bad = {0xFFFFFFF0u};
+    EXPECT_THROW(client.decode(bad), std::runtime_error);
+    client.send(server_protocol::Op(9), "x");
+    EXPECT_THROW(client.receive(), std::runtime_error);
+    EXPECT_EQ(client.encode("the fox"), tokenizer->encode("the fox"));
+
+    std::vector<std::thread> threads;
+    std::vector<int> mismatches(4, 0);
+    for (int c = 0; c < 4; ++c) {
+        threads.emplace_back([&, c] {
+            TokenizeClient own = TokenizeClient::connect_unix(socket_path());
+            for (int round = 0; round < 50; ++round) {
+                for (const auto& text : texts) own.send(server_protocol::Op::Encode, text);
+                for (const auto& text : texts) {
+                    std::string payload = own.receive();
+                    std::vector<uint32_t> ids(payload.size() / 4);
+                    std::memcpy(ids.data(), payload.data(), payload.size());
+                    mismatches[c] += ids != tokenizer->encode(text);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(mismatches, std::vector<int>(4, 0));
+
+    ServerStats stats = server.stats();
+    const size_t expected = 2 * texts.size() + 3 + 4 * 50 * texts.size();
+    EXPECT_EQ(stats.requests, expected);
+    EXPECT_EQ(stats.errors, 2u);
+    EXPECT_EQ(stats.connections, 5u);
+    EXPECT_GT(stats.qps, 0.0);
+    EXPECT_LE(stats.p50_us, stats.p99_us);
+    EXPECT_LE(stats.p99_us, stats.max_us);
+    std::string json = client.stats_json();
+    EXPECT_NE(json.find("\"requests\":" + std::to_string(expected)), std::string::npos) << json;
+
+    server.stop();
+    EXPECT_FALSE(std::filesystem::exists(socket_path()));
+    EXPECT_THROW(client.encode("the"), std::runtime_error);
+}
+
+// Test 2: TCP on a free port; the window groups concurrent requests into
+// batches, and SLO mode answers well before a long window would close
+TEST_F(TokenizeServerTest, BatchingAndSloOverTcp) {
+    {
+        TokenizeServer server(tokenizer, ServerOptions{.threads = 2, .batch_window_us = 20000});
+        server.start();
+        ASSERT_NE(server.port(), 0);
+        std::vector<std::thread> threads;
+        for (int c = 0; c < 4; ++c) {
+            threads.emplace_back([&] {
+                TokenizeClient client = TokenizeClient::connect_tcp(server.port());
+                for (int round = 0; round < 5; ++round) {
+                    for (const auto& text : texts) client.send(server_protocol::Op::Encode, text);
+                    for (size_t i = 0; i < texts.size(); ++i) client.receive();
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        ServerStats stats = server.stats();
+        EXPECT_EQ(stats.requests, 4u * 5 * texts.size());
+        EXPECT_LT(stats.batches, stats.requests / 2);
+        EXPECT_GT(stats.mean_batch(), 2.0);
+    }
+
+    // With a 2 s window, a lone request waits for the window in plain mode
+    // but is answered within the 2 ms SLO budget in SLO mode
+    TokenizeServer server(tokenizer, ServerOptions{.batch_window_us = 2'000'000, .slo_us = 2000});
+    server.start();
+    TokenizeClient client = TokenizeClient::connect_tcp(server.port());
+    for (int i = 0; i < 5; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(client.encode("the lazy dog"), tokenizer->encode("the lazy dog"));
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    }
+    EXPECT_EQ(server.stats().batches, 5u);
+}
+
+// Test 3: A client that never reads its responses does not hold up others
+TEST_F(TokenizeServerTest, SlowClientDoesNotStallOthers) {
+    TokenizeServer server(tokenizer, ServerOptions{.unix_socket = socket_path(), .threads = 2});
+    server.start();
+
+    // Pipeline large requests without reading until the server stops
+    // reading too; the sends then block until the server goes away
+    std::string text;
+    while (text.size() < (8u << 10)) text += "the quick brown fox jumps over the lazy dog ";
+    std::atomic<size_t> sent{0};
+    std::thread stalled([&] {
+        TokenizeClient client = TokenizeClient::connect_unix(socket_path());
+        try {
+            for (;;) {
+                client.send(server_protocol::Op::Encode, text);
+                sent++;
+            }
+        } catch (const std::runtime_error&) {
+        }
+    });
+    while (server.stats().requests < 256) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    TokenizeClient client = TokenizeClient::connect_unix(socket_path());
+    for (int i = 0; i < 20; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(client.encode("the lazy dog"), tokenizer->encode("the lazy dog"));
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    }
+    // The stalled client is no longer read from
+    const size_t before = sent;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(sent, before);
+
+    server.stop();
+    stalled.join();
+}
+
+// Test 4: A response too large for a frame is an error, not a broken connection
+TEST_F(TokenizeServerTest, OversizeResponseIsError) {
+    Trainer trainer;
+    Tokenizer long_tokens = trainer.train(corpus_file, 80, TrainOptions{.log = nullptr});
+    const uint32_t id = long_tokens.add_special_tokens({std::string(4096, 'x')})[0];
+    TokenizeServer server(std::make_shared<const Tokenizer>(std::move(long_tokens)),
+                          ServerOptions{.unix_socket = socket_path()});
+    server.start();
+    TokenizeClient client = TokenizeClient::connect_unix(socket_path());
+
+    // 20000 ids decode to about 80 MiB, past the 64 MiB frame limit
+    std::vector<uint32_t> ids(20000, id);
+    try {
+        client.decode(ids);
+        ADD_FAILURE() << "expected a server error";
+    } catch (const std::runtime_error& e) {
+        EXPECT_NE(std::string(e.what()).find("frame limit"), std::string::npos) << e.what();
+    }
+    ids.resize(100);
+    EXPECT_EQ(client.decode(ids).size(), 100u * 4096);
+    EXPECT_EQ(server.stats().errors, 1u);
+}
+
+// Test 5: A client that disconnects has its socket and threads released
+// without waiting for the next connection
+TEST_F(TokenizeServerTest, ClosedConnectionsAreReleased) {
+    if (!std::filesystem::exists("/proc/self/fd")) GTEST_SKIP() << "needs /proc";
+    auto count = [](const char* dir) {
+        return std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator());
+    };
+    TokenizeServer server(tokenizer, ServerOptions{.unix_socket = socket_path(), .threads = 1});
+    server.start();
+    const auto fds = count("/proc/self/fd");
+    const auto threads = count("/proc/self/task");
+    for (int c = 0; c < 20; ++c) {
+        TokenizeClient client = TokenizeClient::connect_unix(socket_path());
+        EXPECT_EQ(client.encode("the fox"), tokenizer->encode("the fox"));
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((count("/proc/self/fd") > fds || count("/proc/self/task") > threads) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(count("/proc/self/fd"), fds);
+    EXPECT_EQ(count("/proc/self/task"), threads);
+    EXPECT_EQ(server.stats().connections, 20u);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
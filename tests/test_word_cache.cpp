@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include "word_cache.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+// Test fixture for WordCache tests
+class WordCacheTest : public ::testing::Test {
+protected:
+    std::vector<int> ids;
+};
+
+// Test 1: Miss then hit
+TEST_F(WordCacheTest, MissThenHit) {
+    WordCache cache;
+    EXPECT_FALSE(cache.lookup("the", ids));
+
+    cache.insert("the", {4, 5, 6});
+    ASSERT_TRUE(cache.lookup("the", ids));
+    EXPECT_EQ(ids, (std::vector<int>{4, 5, 6}));
+
+    WordCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.entries, 1);
+    EXPECT_GT(stats.bytes, 0);
+}
+
+// Test 2: Memory stays within budget and evictions are counted
+TEST_F(WordCacheTest, StaysWithinBudget) {
+    const size_t budget = 4096;
+    WordCache cache(budget, 1);
+    for (int i = 0; i < 1000; ++i) {
+        cache.insert("word" + std::to_string(i), {i, i + 1});
+    }
+    WordCacheStats stats = cache.stats();
+    EXPECT_LE(stats.bytes, budget);
+    EXPECT_GT(stats.evictions, 0);
+    EXPECT_EQ(stats.entries + stats.evictions, 1000);
+}
+
+// Test 3: Referenced entries survive a CLOCK sweep
+TEST_F(WordCacheTest, ReferencedEntrySurvives) {
+    WordCache cache(1024, 1);
+    cache.insert("hot", {1});
+    for (int i = 0; i < 200; ++i) {
+        ASSERT_TRUE(cache.lookup("hot", ids));
+        cache.insert("cold" + std::to_string(i), {i});
+    }
+    EXPECT_TRUE(cache.lookup("hot", ids));
+}
+
+// Test 4: Zero budget disables caching
+TEST_F(WordCacheTest, ZeroBudgetDisables) {
+    WordCache cache(0);
+    cache.insert("the", {1, 2});
+    EXPECT_FALSE(cache.lookup("the", ids));
+
+    WordCache resized;
+    resized.insert("the", {1, 2});
+    resized.set_budget(0);
+    EXPECT_FALSE(resized.lookup("the", ids));
+    EXPECT_EQ(resized.stats().entries, 0);
+}
+
+// Test 5: Clear drops entries
+TEST_F(WordCacheTest, ClearDropsEntries) {
+    WordCache cache;
+    cache.insert("a", {1});
+    cache.clear();
+    EXPECT_FALSE(cache.lookup("a", ids));
+    EXPECT_EQ(cache.stats().bytes, 0);
+}
+
+// Test 6: Concurrent lookups and inserts
+TEST_F(WordCacheTest, ConcurrentAccess) {
+    WordCache cache(16 * 1024);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&cache, t] {
+            std::vector<int> out;
+            for (int i = 0; i < 2000; ++i) {
+                std::string word = "w" + std::to_string((i * 7 + t) % 300);
+                if (cache.lookup(word, out)) {
+                    ASSERT_EQ(out.size(), 1);
+                    ASSERT_EQ("w" + std::to_string(out[0]), word);
+                } else {
+                    cache.insert(word, {(i * 7 + t) % 300});
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    WordCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.hits + stats.misses, 16000);
+    EXPECT_LE(stats.bytes, 16 * 1024);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
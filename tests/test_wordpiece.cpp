@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "wordpiece.hpp"
+#include "../bench/reference_wordpiece.hpp"
+#include "scratch_dir.hpp"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Test fixture for WordPiece tests
+class WordPieceTest : public ::testing::Test {
+protected:
+    ScratchDir scratch;  // the test runs in its own directory
+
+    // The vocab of BERT's tokenization tests
+    std::vector<std::string> bert_vocab = {
+        "[UNK]", "[CLS]", "[SEP]", "want", "##want", "##ed", "wa", "un", "runn", "##ing"};
+};
+
+// Test 1: Greedy longest-match-first with continuation tokens
+TEST_F(WordPieceTest, BertExample) {
+    WordPiece wp(bert_vocab);
+    EXPECT_EQ(wp.tokenize("unwanted running"),
+              (std::vector<std::string>{"un", "##want", "##ed", "runn", "##ing"}));
+    EXPECT_EQ(wp.tokenize("unwantedX running"),
+              (std::vector<std::string>{"[UNK]", "runn", "##ing"}));
+    EXPECT_TRUE(wp.encode("").empty());
+    EXPECT_EQ(wp.decode(wp.encode("unwanted running")), "unwanted running");
+    EXPECT_EQ(wp.token_id("##ing"), 9);
+    EXPECT_EQ(wp.token_id("##in"), -1);
+    EXPECT_EQ(wp.unk_id(), 0);
+    EXPECT_THROW(WordPiece({"a", "##b"}), std::runtime_error);
+}
+
+// Test 2: Same tokens as the hash-probing reference on random vocabs and words
+TEST_F(WordPieceTest, MatchesReference) {
+    std::mt19937 rng(7);
+    const std::string alphabet = "abc#";
+    auto random_string = [&](size_t max_len) {
+        std::string s;
+        for (size_t n = 1 + rng() % max_len; n > 0; --n) s += alphabet[rng() % (rng() % 5 == 0 ? 4 : 3)];
+        return s;
+    };
+    for (int round = 0; round < 50; ++round) {
+        std::vector<std::string> vocab = {"[UNK]"};
+        for (int i = 0; i < 30; ++i) {
+            std::string tok = random_string(4);
+            vocab.push_back(rng() % 2 ? "##" + tok : tok);
+        }
+        WordPiece wp(vocab);
+        ReferenceWordPiece reference(vocab);
+        for (int i = 0; i < 200; ++i) {
+            std::string word = random_string(12);
+            std::vector<uint32_t> expected;
+            reference.encode_word(word, expected);
+            EXPECT_EQ(wp.encode(word), expected) << "word " << word << " round " << round;
+        }
+    }
+}
+
+// Test 3: Long words, the unk token and vocab files
+TEST_F(WordPieceTest, LongWordsAndVocabFile) {
+    WordPieceOptions options;
+    options.max_word_bytes = 8;
+    WordPiece wp(bert_vocab, options);
+    EXPECT_EQ(wp.tokenize("running runningrunning"),
+              (std::vector<std::string>{"runn", "##ing", "[UNK]"}));
+
+    wp.save("test_vocab.txt");
+    WordPiece loaded = WordPiece::load("test_vocab.txt", options);
+    EXPECT_EQ(loaded.vocab_size(), wp.vocab_size());
+    EXPECT_EQ(loaded.encode("unwanted running wa"), wp.encode("unwanted running wa"));
+    std::filesystem::remove("test_vocab.txt");
+    EXPECT_THROW(WordPiece::load("nonexistent_vocab.txt"), std::runtime_error);
+}
+
+// Test 4: A trained vocab starts with the special tokens and covers its corpus
+TEST_F(WordPieceTest, TrainedVocab) {
+    const std::string corpus_file = "wordpiece_corpus.txt";
+    const std::string text =
+        "the quick brown fox jumps over the lazy dog\n"
+        "the quick brown dog jumps over the lazy fox\n"
+        "a quick brown animal jumps high, then higher\n";
+    {
+        std::ofstream corpus(corpus_file);
+        for (int i = 0; i < 5; ++i) corpus << text;
+    }
+    WordPiece wp = train_wordpiece(corpus_file, 80, TrainOptions{.log = nullptr});
+    std::filesystem::remove(corpus_file);
+
+    EXPECT_LE(wp.vocab_size(), 80);
+    EXPECT_GT(wp.vocab_size(), 60);
+    EXPECT_EQ(wp.token(0), "[PAD]");
+    EXPECT_EQ(wp.token(1), "[UNK]");
+    EXPECT_EQ(wp.token(4), "[MASK]");
+    EXPECT_GE(wp.token_id("##x"), 0);  // 'x' only occurs inside words
+    EXPECT_LT(wp.token_id("x"), 0);
+
+    std::vector<uint32_t> ids = wp.encode(text);
+    EXPECT_LT(ids.size(), text.size() / 2);
+    for (uint32_t id : ids) EXPECT_NE(id, static_cast<uint32_t>(wp.unk_id()));
+    EXPECT_EQ(wp.decode(ids) + "\n",
+              "the quick brown fox jumps over the lazy dog the quick brown dog jumps over the lazy fox "
+              "a quick brown animal jumps high, then higher\n");
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}